@@ -12,6 +12,25 @@
 #include <SPI.h>
 #include <math.h>
 #include "sampler_engine.h"
+#include "sampler_commands.h"
+#include "sampler_granular.h"
+#include "sampler_profiler.h"
+#include "sampler_spectral.h"
+#include "sampler_analyzer.h"
+#include "sampler_meters.h"
+#include "sampler_fpu.h"
+#include "sampler_jobs.h"
+#include "sampler_tasks.h"
+#include "sampler_resample.h"
+#include "sampler_capture.h"
+#include "sampler_trace.h"
+#include "sampler_telemetry.h"
+#include "sampler_xrun.h"
+#include "sampler_stress.h"
+#include "sampler_automation.h"
+#include "sampler_declick.h"
+#include "sampler_eq.h"
+#include "sampler_dynamics.h"
 #include "sampler_hardware.h"
 
 
@@ -87,31 +106,104 @@ static const uint32_t kSampleRate = 48000;
 static const size_t kBufferLengthSamples = kBufferLengthSec * kSampleRate;
 
 // Buffers alineados a 32 bytes para optimización de caché (Cortex-M7)
-static float DSY_SDRAM_BSS buffer[kBufferLengthSamples] __attribute__((aligned(32)));
+static float DSY_SDRAM_BSS loop_buffer_a[kBufferLengthSamples] __attribute__((aligned(32)));
+static float DSY_SDRAM_BSS loop_buffer_b[kBufferLengthSamples] __attribute__((aligned(32)));
 static float DSY_SDRAM_BSS waveform_source_buffer[kBufferLengthSamples] __attribute__((aligned(32)));
 
-// Ring buffer de undo/redo - 3 niveles
+// Toma activa y arena de render: al terminar un render el audio callback las intercambia
+static float* volatile buffer = loop_buffer_a;
+static float* render_buffer = loop_buffer_b;
+volatile uint32_t buffer_swaps = 0;  // Lo incrementa el audio callback en cada intercambio
+volatile uint32_t takes_finished = 0;     // Tomas que el audio callback terminó (loop() las recorta)
+volatile uint32_t overdubs_finished = 0;  // Overdubs terminados (loop() prepara el undo siguiente)
+static uint32_t handled_takes = 0;
+static uint32_t handled_overdubs = 0;
+static bool take_expected = false;  // loop() armó una toma que todavía no recortó (un doble toque la descarta)
+
+// loop() publica los comandos de una lectura de controles (o de un fin de toma) como un
+// lote: si el audio callback llega en el medio no aplica ninguno y los aplica todos en el
+// bloque siguiente
+volatile bool command_batch_open = false;
+
+// Ring buffer de undo/redo - 3 niveles más el snapshot que se prepara en segundo plano
 static float DSY_SDRAM_BSS undo_buffer_0[kBufferLengthSamples] __attribute__((aligned(32)));
 static float DSY_SDRAM_BSS undo_buffer_1[kBufferLengthSamples] __attribute__((aligned(32)));
 static float DSY_SDRAM_BSS undo_buffer_2[kBufferLengthSamples] __attribute__((aligned(32)));
+static float DSY_SDRAM_BSS undo_buffer_3[kBufferLengthSamples] __attribute__((aligned(32)));
 
 // Array de punteros para pasar al looper
-static float* undo_buffers[3] = {undo_buffer_0, undo_buffer_1, undo_buffer_2};
+static float* undo_buffers[4] = {undo_buffer_0, undo_buffer_1, undo_buffer_2, undo_buffer_3};
+
+// Pico por tramo de la toma (los llena el looper al grabar)
+static const size_t kChunkStatsCount = kBufferLengthSamples / crearttech::OverdubLooper::STATS_CHUNK + 1;
+static crearttech::ChunkStats DSY_SDRAM_BSS take_chunk_stats[kChunkStatsCount];
+static uint32_t take_silent_bits[(kChunkStatsCount + 31) / 32];
 
 //====================================================================
 // --- OBJETOS DE AUDIO Y ESTADOS GLOBALES ---
 //====================================================================
 
 static crearttech::OverdubLooper looper;
+static crearttech::CommandQueue<crearttech::LooperCommand, 16> looper_commands;
+static crearttech::GranularEngine granular;
+static crearttech::Profiler profiler;
+static crearttech::SpectralFreeze spectral_freeze;
+bool freeze_enabled = false;
+static const float kCpuHz = 480000000.0f; // Cortex-M7 de la Daisy Seed
+volatile float granular_cycles_per_grain_sample = 0.0f;
 static daisysp::PitchShifter pitch_shifter;
-static daisysp::Svf* g_highpass_filter;
-static daisysp::Svf* g_lowpass_filter;
 static uint8_t DSY_SDRAM_BSS reverb_memory[sizeof(daisysp::ReverbSc)];
 static daisysp::ReverbSc* reverb_effect;
 static daisysp::DelayLine<float, 4800> delay_effect;
-
-enum LooperState { STOPPED, RECORDING, PLAYING, OVERDUB, PAUSED };
-LooperState looper_state = STOPPED;
+static crearttech::EqCoefficientTable eq_table;
+static crearttech::ThreeBandEq live_eq, bounce_eq;
+
+// Objetos con estado de la cadena de efectos: la del audio en vivo y la del bounce
+// son independientes, así el render no toca las colas que están sonando
+struct EffectChain {
+  crearttech::ThreeBandEq* eq;
+  daisysp::DelayLine<float, 4800>* delay;
+  daisysp::ReverbSc* reverb;
+};
+static EffectChain live_fx;
+static EffectChain bounce_fx;
+static uint8_t DSY_SDRAM_BSS bounce_reverb_memory[sizeof(daisysp::ReverbSc)];
+static uint8_t DSY_SDRAM_BSS bounce_delay_memory[sizeof(daisysp::DelayLine<float, 4800>)];
+
+enum LooperState { STOPPED, RECORDING, PLAYING, OVERDUB, PAUSED, ARMED };
+volatile LooperState looper_state = STOPPED;  // Solo lo cambia el audio callback (comandos de loop() o ARMED -> RECORDING)
+
+// --- GRABACIÓN POR UMBRAL ---
+const float REC_THRESHOLD = 0.02f;     // ~-34 dBFS: nivel de entrada que dispara la grabación
+const float REC_PREROLL_MS = 10.0f;    // Audio previo al cruce que se conserva en la toma
+const float TRIM_SILENCE_THRESHOLD = 0.003f;  // ~-50 dBFS: tramos más bajos se recortan al parar
+const float NORMALIZE_TARGET_PEAK = 0.89f;    // -1 dBFS tras normalizar
+volatile float take_gain = 1.0f;              // Normalización no destructiva de la toma
+
+// --- DINÁMICA DE ENTRADA (antes de grabar y del umbral) ---
+// Compresor 4:1 desde -18 dBFS con +6 dB de makeup y gate 1:4 debajo de -55 dBFS
+const crearttech::DynamicsSettings INPUT_DYNAMICS = {
+  -18.0f, 4.0f, 6.0f, 6.0f,  // Umbral, ratio, rodilla, makeup
+  -55.0f, 4.0f, 40.0f,       // Gate: umbral, ratio, atenuación máxima
+  150.0f                     // Relajación (ms); el ataque es instantáneo
+};
+static crearttech::InputDynamics input_dynamics;  // Solo desde el audio callback
+static bool input_dynamics_running = false;       // El bloque anterior pasó por la dinámica
+
+// --- BLOQUES EN SILENCIO ---
+const float EFFECTS_TAIL_THRESHOLD = 1e-4f;   // -80 dBFS a la salida de los efectos
+const uint32_t EFFECTS_TAIL_BLOCKS = 100;     // Salida quieta durante toda la línea de delay (100 ms)
+static bool effects_idle = false;
+volatile bool effects_printed = false;        // El loop ya tiene los efectos (bounce): sin efectos neutros se saltean
+static uint32_t effects_quiet_blocks = 0;
+volatile uint32_t silent_blocks_skipped = 0;
+volatile uint32_t ftz_missing_blocks = 0;     // Bloques en los que el callback corrió sin FZ (DEBUG)
+
+// --- XRUNS ---
+// Post-mortem de bloques fuera de plazo, en una sección que el arranque no inicializa:
+// sobrevive a un reset por software (XrunLog lo valida con un número mágico)
+const float XRUN_LATE_BLOCKS = 1.5f;          // Intervalo entre callbacks que cuenta como bloque perdido
+static crearttech::XrunLog<16> xrun_log __attribute__((section(".noinit")));
 
 enum GlobalMode { MODE_INICIO, MODE_EDICION, MODE_FX };
 GlobalMode current_mode = MODE_EDICION;
@@ -122,7 +214,12 @@ Knob2Mode knob2_mode = REVERB;
 enum Knob3Mode { TIME, DELAY, MIX };
 Knob3Mode knob3_mode = TIME;
 
-enum Enc1Mode { PITCH, HIGHPASS, LOWPASS };
+enum Enc1Mode { PITCH, EQ_LOW, EQ_MID, EQ_HIGH };  // ENC1 afina o ajusta una banda del EQ
+
+// Modo de reproducción (botón BACK): loop, ping-pong, one-shot o granular
+crearttech::PlaybackMode playback_mode = crearttech::PLAYBACK_LOOP;
+volatile bool granular_mode = false;
+static bool granular_playing = false;  // La nube que lee el audio callback (lo fija PLAYBACK_MODE)
 Enc1Mode enc1_mode = PITCH;
 static float g_current_pitch_ratio = 1.0f;
 static float g_playback_speed = 1.0f;
@@ -134,6 +231,7 @@ bool last_enc1_sw_state = HIGH, last_enc2_sw_state = HIGH, last_enc3_sw_state =
 bool last_fn_button_state = HIGH;
 
 const unsigned long DOUBLE_PRESS_TIME_MS = 500;
+const unsigned long LONG_PRESS_TIME_MS = 500;
 unsigned long lastPlayPressTime = 0;
 int playPressCount = 0;
 unsigned long last_rev_button_press_time = 0;
@@ -146,14 +244,35 @@ volatile int enc1_counter = 0, enc2_counter = 0, enc3_counter = 0;
 static int last_e1 = 0, last_e2 = 0, last_e3 = 0;
 volatile int enc4_counter = 0;
 volatile unsigned long last_isr_time_4 = 0;
+volatile unsigned long enc4_interval_us = 0;  // Tiempo entre los dos últimos pulsos del encoder 4
+volatile int enc4_direction = 0;
 static int last_e4 = 0;
 
 enum Enc4Mode {
     ENC4_MODE_START_POINT,
     ENC4_MODE_END_POINT,
     ENC4_MODE_MOVE,
+    ENC4_MODE_SCRUB,
+    ENC4_MODE_GRAIN_POSITION,
+    ENC4_MODE_GRAIN_SPRAY,
+    ENC4_MODE_GRAIN_SIZE,
+    ENC4_MODE_GRAIN_DENSITY,
     ENC4_MODE_GAIN 
 };
+
+// --- SCRUB (encoder 4) ---
+const float SCRUB_SAMPLES_PER_DETENT = 480.0f;     // 10 ms de audio por pulso
+const float SCRUB_SMOOTHING_HZ = 8.0f;             // Frecuencia del filtro críticamente amortiguado
+const unsigned long SCRUB_VELOCITY_TIMEOUT_US = 100000; // Sin pulsos en 100 ms = encoder quieto
+static float scrub_offset = 0.0f;
+static float scrub_sent_velocity = 0.0f;
+
+// --- GRANULAR (encoder 4 en modo granular) ---
+static float grain_position = 0.0f;   // 0.0 a 1.0 de la región
+static float grain_spray = 0.1f;      // 0.0 a 1.0
+static float grain_size_ms = 80.0f;
+static float grain_density = 20.0f;   // Granos por segundo
+static uint8_t grain_params_pending = 0;  // Bits de GrainParam por enviar al audio callback
 Enc4Mode enc4_mode = ENC4_MODE_GAIN;
 
 static float g_gain = 1.0f;
@@ -162,6 +281,17 @@ volatile int knob3_time_val = 50, knob3_feedback_val = 50, knob3_mix_val = 0;
 volatile float delay_time_samples = 0;
 volatile float delay_feedback = 0.0f;
 volatile float delay_mix = 0.0f;
+volatile int eq_knob_val[crearttech::EQ_BANDS] = {50, 50, 50};  // ENC1 en modo EQ (0..100, 50 = 0 dB)
+
+// --- AUTOMATIZACIÓN (FN largo: grabar las perillas durante el próximo ciclo) ---
+enum AutomationLaneId { LANE_EQ_LOW, LANE_EQ_MID, LANE_EQ_HIGH, LANE_DELAY_MIX, LANE_REVERB_MIX, LANE_GAIN, LANE_COUNT };
+enum AutomationStatus : uint8_t { AUTOMATION_OFF, AUTOMATION_PLAYING, AUTOMATION_ARMED, AUTOMATION_RECORDING };
+const size_t AUTOMATION_LANE_EVENTS = 4096;  // 16 KB por pista (un evento por cambio de valor)
+const float PARAM_SMOOTHING_MS = 20.0f;
+static uint32_t DSY_SDRAM_BSS automation_storage[2 * LANE_COUNT * AUTOMATION_LANE_EVENTS];
+static crearttech::Automation<LANE_COUNT> automation;  // Solo desde el audio callback
+static crearttech::ParamSmoother eq_smoothers[crearttech::EQ_BANDS], delay_mix_smoother, reverb_mix_smoother, gain_smoother;
+volatile uint8_t automation_status = AUTOMATION_OFF;  // Lo publica el audio callback
 
 bool reverse_mode = false;
 volatile size_t record_counter = 0;
@@ -170,6 +300,11 @@ volatile size_t play_position_samples = 0;
 volatile bool speaker_muted = false;
 bool has_undo_state = false;
 unsigned long play_button_press_time = 0;
+unsigned long enc1_press_time = 0;
+bool enc1_long_press_actioned = false;
+unsigned long fn_press_time = 0;
+bool fn_long_press_actioned = false;
+int applied_pitch_semitones = 0;  // Semitonos ya enviados al looper desde ENC1
 bool play_button_long_press_actioned = false;
 int original_pitch = 0;
 bool waveform_ready = false;
@@ -177,12 +312,31 @@ volatile bool waveform_display_needs_update = false;
 float waveform_scale = 1.0f;
 volatile size_t loop_start_sample = 0;
 volatile size_t loop_end_sample = 0;
-bool loop_edit_mode = false;
+
+// Vista principal (botón FN): forma de onda o analizador de espectro
+enum DisplayView { VIEW_WAVEFORM, VIEW_SPECTRUM, VIEW_XRUNS };  // VIEW_XRUNS solo en DEBUG
+DisplayView display_view = VIEW_WAVEFORM;
+bool display_view_changed = false;
 
 struct WaveformPixel { float min; float max; };
 const int DISPLAY_W = (SCREEN_WIDTH - 5 * 2);
 WaveformPixel displayWaveform[160];
 
+// Analizador: el audio callback solo copia bloques al anillo; la FFT corre en loop()
+static crearttech::SnapshotRing<4096> analyzer_ring;
+static crearttech::SpectrumAnalyzer<DISPLAY_W> analyzer;
+static float analyzer_input[crearttech::SpectrumAnalyzer<DISPLAY_W>::INPUT_SIZE];
+
+// Medidores: se calculan en el audio callback y se publican por seqlock
+static crearttech::LevelMeter input_meter;
+static crearttech::LevelMeter output_meter;
+static crearttech::ShortTermLoudness output_loudness;
+static crearttech::SeqlockSnapshot<crearttech::MeterReading> meter_snapshot;
+
+// Región del canvas pendiente de enviar a la pantalla
+struct DirtyRect { int16_t x0, y0, x1, y1; bool empty; };
+DirtyRect dirty_rect = {0, 0, 0, 0, true};
+
 struct Star { float x, y, z; float speed; };
 #define MAX_STARS 100
 Star stars[MAX_STARS];
@@ -203,10 +357,308 @@ const uint16_t C_STATE_REC = COLOR(0, 0, 255);
 const int STATUS_Y = 10;
 const int WAVEFORM_X = 5, WAVEFORM_Y = 25, WAVEFORM_W = 300, WAVEFORM_H = 45;
 const int KNOBS_Y = 85;
+const int METERS_Y = WAVEFORM_Y + WAVEFORM_H + 2, METER_H = 3;  // Barras IN y OUT bajo la forma de onda
+const unsigned long METER_PEAK_HOLD_MS = 1500;
+
+void generarOndaVisual_AbletonStyle(WaveformPixel* displayBuf, int displayLen, float* audioBuf, size_t audioLen,
+                                    int first_pixel, int last_pixel);
+
+//====================================================================
+// --- TRABAJOS EN SEGUNDO PLANO ---
+//====================================================================
+// loop() reparte el trabajo pesado en porciones en el tiempo libre entre tareas,
+// como máximo JOB_BUDGET_US por iteración
+const uint32_t JOB_BUDGET_US = 2000;
+static crearttech::JobScheduler<6> jobs;
+
+// Copia de la región al siguiente nivel de undo, lista antes de que empiece el overdub
+class UndoSnapshotJob : public crearttech::Job {
+public:
+  // La región enviada por loop(): el audio callback la aplica antes que el próximo overdub
+  bool Step(size_t max_samples) override {
+    return looper.PrepareUndoStep(loop_start_sample, loop_end_sample - loop_start_sample + 1, max_samples);
+  }
+  float GetProgress() const override { return looper.GetUndoPrepareProgress(); }
+};
+static UndoSnapshotJob undo_snapshot_job;
+
+// Reescaneo de la forma de onda en un búfer aparte; se publica al terminar
+class WaveformJob : public crearttech::Job {
+public:
+  void Restart(size_t length) { _length = length; _pixel = 0; }
+
+  bool Step(size_t max_samples) override {
+    size_t samples_per_pixel = _length / DISPLAY_W;
+    if (samples_per_pixel < 4) samples_per_pixel = 4;
+    int pixels = (int)(max_samples / samples_per_pixel);
+    if (pixels < 1) pixels = 1;
+    int last = (_pixel + pixels < DISPLAY_W) ? _pixel + pixels : DISPLAY_W;
+    generarOndaVisual_AbletonStyle(_staging, DISPLAY_W, waveform_source_buffer, _length, _pixel, last);
+    _pixel = last;
+    if (_pixel < DISPLAY_W) return false;
+
+    // El pico lo acumula el looper mientras graba: no hace falta recorrer la toma
+    float max_abs_val = looper.GetTakePeak();
+    if (max_abs_val < 1e-6f) max_abs_val = 1e-6f;
+    memcpy(displayWaveform, _staging, sizeof(_staging));
+    waveform_scale = ((WAVEFORM_H / 2.0f) / max_abs_val) * 0.7f;
+    waveform_ready = true;
+    return true;
+  }
+
+  float GetProgress() const override { return (float)_pixel / (float)DISPLAY_W; }
+
+private:
+  WaveformPixel _staging[DISPLAY_W];
+  size_t _length = 0;
+  int _pixel = 0;
+};
+static WaveformJob waveform_job;
+
+// Limpieza del búfer después del final de la toma
+class ClearJob : public crearttech::Job {
+public:
+  void Restart(float* buf, size_t start, size_t end) { _buf = buf; _start = _pos = start; _end = end; }
+
+  bool Step(size_t max_samples) override {
+    size_t n = _end - _pos;
+    if (n > max_samples) n = max_samples;
+    memset(_buf + _pos, 0, sizeof(float) * n);
+    _pos += n;
+    return _pos >= _end;
+  }
+
+  float GetProgress() const override { return (_end > _start) ? (float)(_pos - _start) / (float)(_end - _start) : 1.0f; }
+
+private:
+  float* _buf = nullptr;
+  size_t _start = 0, _pos = 0, _end = 0;
+};
+static ClearJob clear_job;
+
+// Copia al búfer de la forma de onda la parte del loop que cambió con un render, una vez
+// activado: un render cancelado nunca llega a la pantalla
+class WaveformCopyJob : public crearttech::Job {
+public:
+  void Restart(size_t start, size_t end) { _start = _pos = start; _end = end; }
+
+  bool Step(size_t max_samples) override {
+    size_t n = _end - _pos;
+    if (n > max_samples) n = max_samples;
+    memcpy(waveform_source_buffer + _pos, buffer + _pos, sizeof(float) * n);
+    _pos += n;
+    if (_pos < _end) return false;
+    waveform_display_needs_update = true;
+    return true;
+  }
+
+  float GetProgress() const override { return (_end > _start) ? (float)(_pos - _start) / (float)(_end - _start) : 1.0f; }
+
+private:
+  size_t _start = 0, _pos = 0, _end = 0;
+};
+static WaveformCopyJob waveform_copy_job;
+
+//====================================================================
+// --- TAREAS DEL LOOP PRINCIPAL ---
+//====================================================================
+// loop() solo despacha tareas periódicas: entre las liberadas corre primero la de
+// periodo más corto. Las entradas se leen a ritmo fijo; el dibujo se adapta a la carga.
+const uint32_t INPUT_PERIOD_US = 2000, INPUT_BUDGET_US = 500;
+const uint32_t DRAW_PERIOD_MIN_US = 30000, DRAW_PERIOD_MAX_US = 100000, DRAW_BUDGET_US = 15000;
+const uint32_t REPORT_PERIOD_US = 1000000, REPORT_BUDGET_US = 2000;
+const float DRAW_BACKOFF_CPU_LOAD = 0.85f;  // Con el audio por encima de esta carga se dibuja menos seguido
+static crearttech::TaskScheduler<5> tasks;
+static int input_task = -1, draw_task = -1, report_task = -1, telemetry_task = -1;
+
+uint32_t taskClock() { return micros(); }
+void scanInputsTask();
+void drawTask();
+#ifdef DEBUG
+void reportTask();
+#endif
+#if defined(CAPTURE_SESSION) || defined(TRACE)
+const uint32_t SERIAL_PERIOD_US = 100000, SERIAL_BUDGET_US = 2000;
+static int serial_task = -1;
+void serialCommandTask();
+#endif
+#ifdef TELEMETRY
+// Tramas de estado por segundo (se puede fijar al compilar)
+#ifndef TELEMETRY_RATE_HZ
+#define TELEMETRY_RATE_HZ 20
+#endif
+const uint32_t TELEMETRY_PERIOD_US = 1000000 / TELEMETRY_RATE_HZ, TELEMETRY_BUDGET_US = 300;
+void telemetryTask();
+#endif
 
 // Forward Declaration needed
 void updateRgbLed(LooperState state);
 
+//====================================================================
+// --- CAPTURA DE SESIÓN (CAPTURE_SESSION) ---
+//====================================================================
+// Desde el arranque se registra la entrada de audio y todo lo que loop() cambia en el
+// motor, sellado con el bloque de audio en que se aplicó. Las lecturas de controles usan
+// el bloque como reloj (1 bloque = 1 ms) y las decisiones por tiempo (pulsación larga,
+// doble pulsación, velocidad de scrub) quedan en el registro, así al repetir caen en el
+// mismo bloque. 'd' por Serial vuelca la sesión; una sesión enviada por Serial al
+// arrancar se repite bloque a bloque comparando el hash de la salida.
+enum CaptureAction : uint8_t { ACTION_RESET_SINGLE, ACTION_ENC1_LONG, ACTION_PLAY_LONG, ACTION_PLAY_SINGLE, ACTION_FN_LONG };
+
+#ifdef CAPTURE_SESSION
+const uint32_t CAPTURE_SECONDS = 60;
+const size_t kCaptureInputSamples = CAPTURE_SECONDS * kSampleRate;
+const size_t kCaptureUiEvents = 16384, kCaptureAudioEvents = 8192;
+const uint32_t CHECKSUM_BLOCKS = 1000;  // Un hash de la salida por segundo
+const uint32_t REPLAY_WAIT_MS = 3000;   // Espera de una sesión por Serial al arrancar
+static float DSY_SDRAM_BSS capture_input[kCaptureInputSamples];
+static crearttech::CaptureEvent DSY_SDRAM_BSS capture_ui_storage[kCaptureUiEvents];
+static crearttech::CaptureEvent DSY_SDRAM_BSS capture_audio_storage[kCaptureAudioEvents];
+static crearttech::EventLog ui_events;     // Productor: loop()
+static crearttech::EventLog audio_events;  // Productor: audio callback
+static crearttech::SampleLog input_log;    // Productor: audio callback
+volatile uint32_t session_block = 0;       // Bloques procesados desde el arranque
+volatile bool capture_stopped = false;     // Registro lleno o sesión ya volcada
+static bool session_replaying = false;
+static uint32_t session_output_hash = crearttech::OutputHash::SEED;
+static int session_logged_state = -1;
+static uint32_t block_command_hash = 0;  // Comandos de loop() aplicados en el bloque en curso (0: ninguno)
+
+// Botones: bit i = nivel de kControlPins[i], leído una vez por lectura de controles
+const uint32_t kControlPins[] = {ENC1_SW_PIN, ENC2_SW_PIN, ENC3_SW_PIN, ENC4_SW_PIN, FN_BUTTON_PIN, REC_BUTTON_PIN,
+                                 PLAY_BUTTON_PIN, STOP_BUTTON_PIN, RESET_BUTTON_PIN, REV_BUTTON_PIN, BACK_BUTTON_PIN};
+const size_t kControlCount = sizeof(kControlPins) / sizeof(kControlPins[0]);
+static uint32_t control_levels = 0;
+static size_t scan_first_event = 0;
+
+// Lo que la repetición inyecta en la próxima lectura de controles
+static uint32_t replay_action_mask = 0;
+static float replay_scrub_velocity = 0.0f;
+
+void logUiEvent(crearttech::CaptureEventType type, uint8_t id, uint32_t value) {
+  if (capture_stopped || session_replaying) return;
+  if (!ui_events.Append(session_block, type, id, value)) capture_stopped = true;
+}
+
+// Solo desde el audio callback (o desde setup antes de iniciar el audio)
+void logAudioEvent(crearttech::CaptureEventType type, uint8_t id, uint32_t value) {
+  if (capture_stopped || session_replaying) return;
+  if (!audio_events.Append(session_block, type, id, value)) capture_stopped = true;
+}
+
+// Al empezar una lectura de controles: botones y encoders que cambiaron desde la anterior
+void captureControls(int e1, int e2, int e3, int e4) {
+  scan_first_event = ui_events.Size();
+  if (session_replaying) return;  // control_levels y los contadores vienen de la sesión
+  uint32_t levels = 0;
+  for (size_t i = 0; i < kControlCount; i++) {
+    if (digitalRead(kControlPins[i]) != LOW) levels |= 1u << i;
+  }
+  static uint32_t logged_levels = UINT32_MAX;
+  if (levels != logged_levels) logUiEvent(crearttech::CaptureEventType::CONTROLS, 0, levels);
+  logged_levels = control_levels = levels;
+
+  static int logged[4] = {INT32_MIN, INT32_MIN, INT32_MIN, INT32_MIN};
+  const int counts[4] = {e1, e2, e3, e4};
+  for (uint8_t i = 0; i < 4; i++) {
+    if (counts[i] != logged[i]) logUiEvent(crearttech::CaptureEventType::ENCODER, i + 1, (uint32_t)counts[i]);
+    logged[i] = counts[i];
+  }
+}
+
+// Al terminar: si la lectura registró algo, la repetición la ejecuta en este bloque
+void endControlScan() {
+  if (ui_events.Size() != scan_first_event) logUiEvent(crearttech::CaptureEventType::SCAN, 0, 0);
+}
+
+bool readButton(uint32_t pin) {
+  for (size_t i = 0; i < kControlCount; i++) {
+    if (kControlPins[i] == pin) return (control_levels >> i) & 1u;
+  }
+  return digitalRead(pin);
+}
+
+// Hash de la salida, cambios de estado y checkpoints; cierra el bloque de la sesión
+void endSessionBlock(const float* out_left, const float* out_right, size_t size) {
+  session_output_hash = crearttech::OutputHash::Update(session_output_hash, out_left, size);
+  session_output_hash = crearttech::OutputHash::Update(session_output_hash, out_right, size);
+  if ((int)looper_state != session_logged_state) {
+    session_logged_state = (int)looper_state;
+    logAudioEvent(crearttech::CaptureEventType::STATE, 0, (uint32_t)looper_state);
+  }
+  if (block_command_hash != 0) logAudioEvent(crearttech::CaptureEventType::COMMANDS, 0, block_command_hash);
+  uint32_t block = session_block;
+  if (block % CHECKSUM_BLOCKS == CHECKSUM_BLOCKS - 1) logAudioEvent(crearttech::CaptureEventType::CHECKSUM, 0, session_output_hash);
+  session_block = block + 1;
+}
+#else
+inline bool readButton(uint32_t pin) { return digitalRead(pin); }
+#endif
+
+// Reloj de los controles en ms; en una sesión capturada es el número de bloque de audio
+unsigned long controlMillis() {
+  #ifdef CAPTURE_SESSION
+  return session_block * 1000UL / (kSampleRate / AUDIO_BLOCK_SAMPLES);
+  #else
+  return millis();
+  #endif
+}
+
+// Decisión que depende del tiempo transcurrido; al repetir una sesión sale del registro
+bool timedAction(CaptureAction action, bool elapsed) {
+  #ifdef CAPTURE_SESSION
+  if (session_replaying) return (replay_action_mask >> action) & 1u;
+  if (elapsed) logUiEvent(crearttech::CaptureEventType::ACTION, action, 0);
+  #endif
+  return elapsed;
+}
+
+// La velocidad de scrub sale del intervalo entre pulsos medido por la ISR
+float controlScrubVelocity(float velocity) {
+  #ifdef CAPTURE_SESSION
+  if (session_replaying) return replay_scrub_velocity;
+  static float logged = 0.0f;
+  if (velocity != logged) {
+    uint32_t bits; memcpy(&bits, &velocity, sizeof(bits));
+    logUiEvent(crearttech::CaptureEventType::SCRUB, 0, bits);
+    logged = velocity;
+  }
+  #endif
+  return velocity;
+}
+
+//====================================================================
+// --- TRAZAS (TRACE) ---
+//====================================================================
+// Compilando con TRACE, el audio callback, loop() y las ISR escriben en su propio anillo
+// (instante en us, punto, fase, argumento). 't' por Serial vuelca los tres anillos;
+// tools/trace_to_chrome.py los convierte a JSON de Chrome trace / Perfetto.
+// Sin TRACE los macros no generan código.
+enum TracePoint : uint8_t {
+  TRACE_CALLBACK, TRACE_LOOPER, TRACE_GRANULAR, TRACE_EFFECTS, TRACE_SPECTRAL, TRACE_DYNAMICS,  // Mismo orden que ProfileStage
+  TRACE_COMMANDS, TRACE_LOOPER_STATE, TRACE_INPUT_TASK, TRACE_DRAW_TASK, TRACE_JOBS,
+  TRACE_ENCODER_ISR, TRACE_JACK_ISR, TRACE_POINT_COUNT
+};
+
+#ifdef TRACE
+static const char kTracePointNames[TRACE_POINT_COUNT][crearttech::TRACE_NAME_LENGTH] = {
+  "callback", "looper", "granular", "effects", "spectral", "dynamics",
+  "commands", "looper_state", "input_task", "draw_task", "jobs",
+  "encoder_isr", "jack_isr"
+};
+static crearttech::TraceRing<16384> DSY_SDRAM_BSS audio_trace;  // Escritor: audio callback
+static crearttech::TraceRing<16384> DSY_SDRAM_BSS ui_trace;     // Escritor: loop()
+static crearttech::TraceRing<1024> DSY_SDRAM_BSS isr_trace;     // Escritor: ISR de encoders y jack (misma prioridad)
+
+#define TRACE_BEGIN(ring, point) ring.Write(micros(), (point), crearttech::TracePhase::BEGIN, 0)
+#define TRACE_END(ring, point) ring.Write(micros(), (point), crearttech::TracePhase::END, 0)
+#define TRACE_INSTANT(ring, point, arg) ring.Write(micros(), (point), crearttech::TracePhase::INSTANT, (uint16_t)(arg))
+#else
+#define TRACE_BEGIN(ring, point) ((void)0)
+#define TRACE_END(ring, point) ((void)0)
+#define TRACE_INSTANT(ring, point, arg) ((void)0)
+#endif
+
 //====================================================================
 // --- LÓGICA DE ENCODERS POR INTERRUPCIÓN (ISR) ---
 //====================================================================
@@ -215,6 +667,7 @@ volatile unsigned long last_isr_time_2 = 0;
 volatile unsigned long last_isr_time_3 = 0;
 
 void encoder1_isr() {
+  TRACE_INSTANT(isr_trace, TRACE_ENCODER_ISR, 1);
   if (micros() - last_isr_time_1 < 3000) return;
   last_isr_time_1 = micros();
   if (digitalRead(ENC1_DT_PIN) == digitalRead(ENC1_CLK_PIN)) {
@@ -225,6 +678,7 @@ void encoder1_isr() {
 }
 
 void encoder2_isr() {
+  TRACE_INSTANT(isr_trace, TRACE_ENCODER_ISR, 2);
   if (micros() - last_isr_time_2 < 3000) return;
   last_isr_time_2 = micros();
   if (digitalRead(ENC2_DT_PIN) == digitalRead(ENC2_CLK_PIN)) {
@@ -235,6 +689,7 @@ void encoder2_isr() {
 }
 
 void encoder3_isr() {
+  TRACE_INSTANT(isr_trace, TRACE_ENCODER_ISR, 3);
   if (micros() - last_isr_time_3 < 3000) return;
   last_isr_time_3 = micros();
   if (digitalRead(ENC3_DT_PIN) == digitalRead(ENC3_CLK_PIN)) {
@@ -245,22 +700,71 @@ void encoder3_isr() {
 }
 
 void encoder4_isr() {
-  if (micros() - last_isr_time_4 < 3000) return;
-  last_isr_time_4 = micros();
+  TRACE_INSTANT(isr_trace, TRACE_ENCODER_ISR, 4);
+  unsigned long now = micros();
+  if (now - last_isr_time_4 < 3000) return;
+  enc4_interval_us = now - last_isr_time_4;
+  last_isr_time_4 = now;
   if (digitalRead(ENC4_DT_PIN) == digitalRead(ENC4_CLK_PIN)) {
     enc4_counter++;
+    enc4_direction = 1;
   } else {
     enc4_counter--;
+    enc4_direction = -1;
   }
 }
 
+//====================================================================
+// --- DETECCIÓN DEL JACK POR INTERRUPCIÓN ---
+//====================================================================
+// La ISR del pin encola el instante de cada flanco. El audio callback espera a que el
+// pin quede quieto JACK_DEBOUNCE_US, confirma el nivel y cambia la fuente de monitoreo
+// con una rampa de un bloque.
+const uint32_t JACK_DEBOUNCE_US = 5000;
+static crearttech::CommandQueue<uint32_t, 8> jack_edges;  // Productor: jack_isr; consumidor: audio
+static bool jack_edge_pending = false;
+static uint32_t jack_first_edge_us = 0, jack_last_edge_us = 0;
+static float input_monitor_gain = 1.0f;  // Solo audio; 0 con el jack de línea conectado
+volatile uint32_t jack_switch_latency_us = 0;  // Primer flanco -> cambio de fuente (DEBUG)
+
+void jack_isr() {
+  TRACE_INSTANT(isr_trace, TRACE_JACK_ISR, 0);
+  // Con la cola llena se pierde el flanco, pero no el estado: el nivel se lee al confirmar
+  jack_edges.Push((uint32_t)micros());
+}
+
+// Solo desde el audio callback (hace de temporizador del antirrebote, un bloque = 1 ms)
+void applyJackEvents() {
+  uint32_t edge_us;
+  while (jack_edges.Pop(edge_us)) {
+    if (!jack_edge_pending) jack_first_edge_us = edge_us;
+    jack_edge_pending = true;
+    jack_last_edge_us = edge_us;
+  }
+  uint32_t now = (uint32_t)micros();
+  if (!jack_edge_pending || now - jack_last_edge_us < JACK_DEBOUNCE_US) return;
+  jack_edge_pending = false;
+
+  bool line_connected = (digitalRead(JACK_DETECT_PIN) != LOW);
+  if (line_connected != speaker_muted) {
+    speaker_muted = line_connected;
+    #ifdef CAPTURE_SESSION
+    logAudioEvent(crearttech::CaptureEventType::JACK, 0, line_connected ? 1u : 0u);
+    #endif
+    uint32_t latency = now - jack_first_edge_us;
+    if (latency > jack_switch_latency_us) jack_switch_latency_us = latency;
+  }
+}
 
-void generarOndaVisual_AbletonStyle(WaveformPixel* displayBuf, int displayLen, float* audioBuf, size_t audioLen) {
+// Calcula los píxeles [first_pixel, last_pixel) de la forma de onda (last_pixel < 0: hasta el final)
+void generarOndaVisual_AbletonStyle(WaveformPixel* displayBuf, int displayLen, float* audioBuf, size_t audioLen,
+                                    int first_pixel, int last_pixel) {
   if (audioLen == 0 || displayLen <= 0) return;
   int samples_per_pixel = (int)(audioLen / displayLen);
   if (samples_per_pixel < 4) samples_per_pixel = 4;
+  if (last_pixel < 0 || last_pixel > displayLen) last_pixel = displayLen;
 
-  for (int i = 0; i < displayLen; i++) {
+  for (int i = first_pixel; i < last_pixel; i++) {
     size_t chunk_start = (size_t)i * samples_per_pixel;
     size_t chunk_end = chunk_start + samples_per_pixel;
     if (chunk_start >= audioLen) {
@@ -361,11 +865,13 @@ void drawStatusPanel() {
     case PLAYING: state_text = "PLAY"; state_icon = "►"; state_color = COLOR(0, 255, 0); break;
     case OVERDUB: state_text = "OVERDUB"; state_icon = "+"; state_color = C_STATE_REC; break;
     case PAUSED: state_text = "PAUSE"; state_icon = "||"; state_color = COLOR(255, 0, 0); break;
+    case ARMED: state_text = "ARMED"; state_icon = "o"; state_color = C_STATE_REC; break;
     default: state_text = "STOP"; state_icon = "■"; state_color = C_ACCENT_ORANGE; break;
   }
   canvas->setCursor(10, STATUS_Y);
   switch (looper_state) {
     case RECORDING: canvas->fillCircle(10 + 6, STATUS_Y + 8, 6, state_color); break;
+    case ARMED: canvas->drawCircle(10 + 6, STATUS_Y + 8, 6, state_color); break;
     case PLAYING: canvas->fillTriangle(10, STATUS_Y + 2, 10, STATUS_Y + 14, 10 + 12, STATUS_Y + 8, state_color); break;
     case PAUSED: canvas->setTextSize(2); canvas->setTextColor(state_color); canvas->print(state_icon); break;
     case OVERDUB: canvas->setTextSize(2); canvas->setTextColor(state_color); canvas->print(state_icon); break;
@@ -375,6 +881,12 @@ void drawStatusPanel() {
   canvas->setCursor(30, STATUS_Y + 4);
   canvas->setTextColor(state_color);
   canvas->print(state_text);
+  // Automatización: suena (cian), armada (naranja) o grabando (rojo)
+  uint8_t aut = automation_status;
+  if (aut != AUTOMATION_OFF) {
+    canvas->setTextColor(aut == AUTOMATION_RECORDING ? C_STATE_REC : aut == AUTOMATION_ARMED ? C_ACCENT_ORANGE : C_ACCENT_CYAN);
+    canvas->print("  AUT");
+  }
 
   if (reverse_mode) {
     canvas->fillTriangle(SCREEN_WIDTH - 10, STATUS_Y + 2, SCREEN_WIDTH - 10, STATUS_Y + 14, SCREEN_WIDTH - 10 - 8, STATUS_Y + 8, C_ACCENT_MAGENTA);
@@ -384,6 +896,19 @@ void drawStatusPanel() {
     canvas->fillTriangle(SCREEN_WIDTH - 10 - 8 - 6, STATUS_Y + 2, SCREEN_WIDTH - 10 - 8 - 6, STATUS_Y + 14, SCREEN_WIDTH - 10 - 6, STATUS_Y + 8, C_ACCENT_CYAN);
   }
 
+  const char* playback_text = NULL;
+  if (granular_mode) playback_text = "GRAIN";
+  else if (playback_mode == crearttech::PLAYBACK_PINGPONG) playback_text = "<>";
+  else if (playback_mode == crearttech::PLAYBACK_ONESHOT) playback_text = looper.IsOneShotDone() ? "1SH." : "1SH";
+  if (playback_text != NULL) {
+    canvas->setFont(NULL); canvas->setTextSize(1); canvas->setTextColor(C_ACCENT_MAGENTA);
+    canvas->setCursor(10, SCREEN_HEIGHT - 15); canvas->print(playback_text);
+  }
+  if (freeze_enabled) {
+    canvas->setFont(NULL); canvas->setTextSize(1); canvas->setTextColor(C_ACCENT_CYAN);
+    canvas->setCursor(50, SCREEN_HEIGHT - 15); canvas->print("FRZ");
+  }
+
   if (speaker_muted) {
     canvas->setFont(NULL); canvas->setTextSize(1); canvas->setTextColor(COLOR(0, 255, 0)); // Verde
     canvas->setCursor(SCREEN_WIDTH - 35, SCREEN_HEIGHT - 15); canvas->print("LINE");
@@ -446,6 +971,110 @@ void drawWaveform() {
   }
 }
 
+void drawSpectrum() {
+  canvas->fillRect(WAVEFORM_X, WAVEFORM_Y, DISPLAY_W, WAVEFORM_H, C_BG);
+  int bottom = WAVEFORM_Y + WAVEFORM_H;
+  for (int x = 0; x < DISPLAY_W; x++) {
+    int height = (int)(analyzer.GetLevel(x) * (float)WAVEFORM_H);
+    if (height <= 0) continue;
+    uint16_t color = (height > WAVEFORM_H * 3 / 4) ? C_ACCENT_MAGENTA : C_ACCENT_CYAN;
+    canvas->drawFastVLine(WAVEFORM_X + x, bottom - height, height, color);
+  }
+}
+
+// Vista de depuración: los últimos xruns, en gris los de arranques anteriores
+void drawXruns() {
+  static const char* const kStateNames[] = {"STOP", "REC", "PLAY", "OVDB", "PAUS", "ARM"};
+  canvas->fillRect(WAVEFORM_X, WAVEFORM_Y, DISPLAY_W, WAVEFORM_H, C_BG);
+  canvas->setFont(NULL); canvas->setTextSize(1); canvas->setTextWrap(false);
+  canvas->setTextColor(C_ACCENT_MAGENTA);
+  canvas->setCursor(WAVEFORM_X, WAVEFORM_Y);
+  uint32_t total = xrun_log.GetTotal();
+  canvas->print("XRUNS "); canvas->print(total - xrun_log.GetPreviousBootsTotal());
+  canvas->print(" (antes "); canvas->print(xrun_log.GetPreviousBootsTotal()); canvas->print(")");
+
+  for (uint32_t row = 0; row < 4 && row < total; row++) {
+    crearttech::XrunRecord r;
+    if (!xrun_log.Read(total - 1 - row, r)) continue;
+    canvas->setTextColor(r.boot == xrun_log.GetBoots() ? C_TEXT_LIGHT : C_TEXT_DARK);
+    canvas->setCursor(WAVEFORM_X, WAVEFORM_Y + 9 + (int)row * 9);
+    canvas->print(r.kind == crearttech::XrunKind::OVERRUN ? "OVR " : "LATE ");
+    canvas->print(r.uptime_ms / 1000); canvas->print("s ");
+    canvas->print(r.looper_state < 6 ? kStateNames[r.looper_state] : "?"); canvas->print(" ");
+    canvas->print((int)(100.0f * (float)r.callback_cycles / profiler.GetBudgetCycles())); canvas->print("%");
+    if (r.flags & crearttech::XRUN_FLAG_GRANULAR) canvas->print(" G");
+    if (r.delay_mix > 0 || r.reverb_mix > 0) canvas->print(" FX");
+    if (r.eq_bands != 0) canvas->print(" EQ");
+  }
+}
+
+// Marca una región del canvas como modificada (se une con la región pendiente)
+void markDirty(int16_t x, int16_t y, int16_t w, int16_t h) {
+  if (dirty_rect.empty) {
+    dirty_rect = {x, y, (int16_t)(x + w), (int16_t)(y + h), false};
+    return;
+  }
+  if (x < dirty_rect.x0) dirty_rect.x0 = x;
+  if (y < dirty_rect.y0) dirty_rect.y0 = y;
+  if (x + w > dirty_rect.x1) dirty_rect.x1 = x + w;
+  if (y + h > dirty_rect.y1) dirty_rect.y1 = y + h;
+}
+
+// Envía a la pantalla solo la región modificada del canvas
+void flushDirty() {
+  if (dirty_rect.empty) return;
+  uint16_t* pixels = canvas->getBuffer();
+  int16_t w = dirty_rect.x1 - dirty_rect.x0;
+  int16_t h = dirty_rect.y1 - dirty_rect.y0;
+  tft.startWrite();
+  tft.setAddrWindow(dirty_rect.x0, dirty_rect.y0, w, h);
+  for (int16_t y = dirty_rect.y0; y < dirty_rect.y1; y++) {
+    tft.writePixels(pixels + y * SCREEN_WIDTH + dirty_rect.x0, w);
+  }
+  tft.endWrite();
+  dirty_rect.empty = true;
+}
+
+// Convierte un nivel lineal a ancho de barra (escala de -60 a 0 dBFS)
+int meterWidth(float level) {
+  if (level <= 0.001f) return 0;
+  float db = 20.0f * log10f(level);
+  int w = (int)((db + 60.0f) / 60.0f * (float)DISPLAY_W);
+  return constrain(w, 0, DISPLAY_W);
+}
+
+void drawMeterBar(int y, float rms, float peak, float held_peak) {
+  canvas->fillRect(WAVEFORM_X, y, DISPLAY_W, METER_H, C_GRID);
+  int rms_w = meterWidth(rms);
+  int peak_w = meterWidth(peak);
+  uint16_t color = COLOR(0, 255, 0);
+  if (peak > 0.5f) color = C_ACCENT_ORANGE;     // Sobre -6 dBFS
+  if (peak > 0.89f) color = C_STATE_REC;        // Sobre -1 dBFS
+  if (peak_w > 0) canvas->fillRect(WAVEFORM_X, y + 1, peak_w, 1, color);
+  if (rms_w > 0) canvas->fillRect(WAVEFORM_X, y, rms_w, METER_H, color);
+  int hold_x = meterWidth(held_peak);
+  if (hold_x > 0) canvas->drawFastVLine(WAVEFORM_X + hold_x - 1, y, METER_H, C_TEXT_LIGHT);
+}
+
+// Medidores de entrada y salida con retención de pico (lectura sin deshabilitar interrupciones)
+void drawMeters() {
+  static crearttech::MeterReading reading = {0.0f, 0.0f, 0.0f, 0.0f, crearttech::ShortTermLoudness::SILENCE_LUFS};
+  static float held_in = 0.0f, held_out = 0.0f;
+  static unsigned long held_in_time = 0, held_out_time = 0;
+  meter_snapshot.Read(reading);  // Si falla se dibuja la lectura anterior
+
+  unsigned long now = millis();
+  if (reading.input_peak >= held_in || now - held_in_time > METER_PEAK_HOLD_MS) { held_in = reading.input_peak; held_in_time = now; }
+  if (reading.output_peak >= held_out || now - held_out_time > METER_PEAK_HOLD_MS) { held_out = reading.output_peak; held_out_time = now; }
+
+  drawMeterBar(METERS_Y, reading.input_rms, reading.input_peak, held_in);
+  drawMeterBar(METERS_Y + METER_H + 1, reading.output_rms, reading.output_peak, held_out);
+
+  canvas->fillRect(75, SCREEN_HEIGHT - 15, 30, 8, C_BG);
+  canvas->setFont(NULL); canvas->setTextSize(1); canvas->setTextColor(C_TEXT_DARK);
+  canvas->setCursor(75, SCREEN_HEIGHT - 15); canvas->print((int)reading.output_lufs); canvas->print("L");
+}
+
 void drawArc(Adafruit_GFX& gfx, int16_t cx, int16_t cy, int16_t radius, uint8_t thickness, int16_t start_angle, int16_t end_angle, uint16_t color) {
   if (end_angle < start_angle) { end_angle += 360; }
   for (int r = radius; r < radius + thickness; r++) {
@@ -473,10 +1102,12 @@ void drawKnobsPanel() {
     float pitch_value = (float)(enc1_counter / PITCH_SENSITIVITY);
     if (pitch_value >= 0) { knob1_arc_start = center_angle; knob1_arc_end = center_angle + (int16_t)((pitch_value / 6.0f) * max_sweep); }
     else { knob1_arc_start = center_angle - (int16_t)((-pitch_value / 6.0f) * max_sweep); knob1_arc_end = center_angle; }
-  } else if (enc1_mode == HIGHPASS) {
-    knob1_label = "HPASS"; knob1_arc_start = 135; knob1_arc_end = 135 + (int16_t)((float)enc1_counter / 100.0f * 270);
   } else {
-    knob1_label = "LPASS"; knob1_arc_start = 135; knob1_arc_end = 135 + (int16_t)((float)enc1_counter / 100.0f * 270);
+    // Banda del EQ: arco desde el centro (0 dB) hacia el realce o el corte
+    knob1_label = (enc1_mode == EQ_LOW) ? "LOW" : (enc1_mode == EQ_MID) ? "MID" : "HIGH";
+    int16_t sweep = (int16_t)((float)(enc1_counter - crearttech::EQ_KNOB_FLAT) / crearttech::EQ_KNOB_FLAT * 135);
+    if (sweep >= 0) { knob1_arc_start = 270; knob1_arc_end = 270 + sweep; }
+    else { knob1_arc_start = 270 + sweep; knob1_arc_end = 270; }
   }
   drawCircularKnob(*canvas, 30, KNOBS_Y + 10, knob1_label, knob1_arc_start, knob1_arc_end, C_ACCENT_MAGENTA, C_TEXT_LIGHT);
 
@@ -496,8 +1127,13 @@ void drawKnobsPanel() {
 void drawScreen() {
   drawBackground();
   drawStatusPanel();
-  drawWaveform();
+  if (display_view == VIEW_SPECTRUM) drawSpectrum();
+  else if (display_view == VIEW_XRUNS) drawXruns();
+  else drawWaveform();
+  drawMeters();
   drawKnobsPanel();
+  // Avance del trabajo en segundo plano: línea fina en el borde superior
+  if (jobs.IsBusy()) canvas->drawFastHLine(0, 0, (int16_t)(jobs.GetActiveProgress() * SCREEN_WIDTH), C_ACCENT_CYAN);
   int current_y = STATUS_Y + 4; int text_x = SCREEN_WIDTH - 50;
   canvas->setFont(NULL); canvas->setTextSize(1); canvas->setTextWrap(false);
   const char* enc4_mode_text; uint16_t enc4_mode_color = C_ACCENT_MAGENTA;
@@ -505,6 +1141,11 @@ void drawScreen() {
     case ENC4_MODE_START_POINT: enc4_mode_text = "S.PT"; break;
     case ENC4_MODE_END_POINT: enc4_mode_text = "E.PT"; break;
     case ENC4_MODE_MOVE: enc4_mode_text = "MOVE"; break;
+    case ENC4_MODE_SCRUB: enc4_mode_text = "SCRB"; break;
+    case ENC4_MODE_GRAIN_POSITION: enc4_mode_text = "G.POS"; break;
+    case ENC4_MODE_GRAIN_SPRAY: enc4_mode_text = "SPRAY"; break;
+    case ENC4_MODE_GRAIN_SIZE: enc4_mode_text = "G.SIZ"; break;
+    case ENC4_MODE_GRAIN_DENSITY: enc4_mode_text = "DENS"; break;
     case ENC4_MODE_GAIN: enc4_mode_text = "GAIN"; break;
     default: enc4_mode_text = ""; break;
   }
@@ -557,47 +1198,511 @@ void updateRgbLed(LooperState state) {
         digitalWrite(LED_G_PIN, HIGH); 
         digitalWrite(LED_B_PIN, LOW); 
         break;
+      case ARMED: 
+        // MAGENTA (rojo + azul): esperando el umbral
+        digitalWrite(LED_R_PIN, LOW); 
+        digitalWrite(LED_G_PIN, HIGH); 
+        digitalWrite(LED_B_PIN, LOW); 
+        break;
     }
 }
 
 //====================================================================
 // --- AUDIO CALLBACK ---
 //====================================================================
+
+// Play/pausa/stop desde PLAYING: la salida baja con una rampa y el estado cambia recién
+// cuando llega a cero; al volver a PLAYING sube desde cero. Stop desde un estado sin
+// salida audible es inmediato. Solo desde el audio callback.
+const float DECLICK_MS = 5.0f;
+static crearttech::DeclickEnvelope transport_declick;
+static bool transport_pending = false;
+static LooperState transport_target = PAUSED;
+static bool transport_restart = false;
+static bool take_handover = false;  // La toma terminó y loop() todavía no la recortó: sin monitoreo
+
+void applyTransport(LooperState target, bool restart) {
+  take_handover = false;
+  if (target == PLAYING) {
+    if (looper_state != PAUSED) return;
+    looper_state = PLAYING;
+    transport_pending = false;
+    transport_declick.Reset(0.0f);
+    transport_declick.FadeTo(1.0f);
+  } else if (looper_state == PLAYING) {
+    transport_pending = true;
+    transport_target = target;
+    transport_restart = restart;
+    transport_declick.FadeTo(0.0f);
+  } else if (target == STOPPED) {
+    if (looper_state == RECORDING) looper.StopRecording();
+    else if (looper_state == OVERDUB) looper.StopOverdub();
+    if (restart) looper.Restart();
+    looper.Disarm();
+    looper_state = STOPPED;
+  }
+}
+
+// REC soltado: cancela lo armado o termina la toma (loop() la recorta y la reproduce) o el overdub
+void applyRecordStop() {
+  if (looper_state == ARMED) {
+    looper.Disarm();
+    looper_state = STOPPED;
+  } else if (looper_state == RECORDING) {
+    looper.StopRecording();
+    looper_state = PAUSED;
+    take_handover = true;
+    takes_finished++;
+  } else if (looper_state == OVERDUB) {
+    looper.StopOverdub();
+    looper_state = PLAYING;
+    overdubs_finished++;
+  }
+}
+
+// La rampa de salida terminó: el cambio de estado entra en vigor
+void commitTransport() {
+  transport_pending = false;
+  if (transport_restart) { looper.Restart(); looper.Disarm(); }
+  looper_state = transport_target;
+  input_monitor_gain = 0.0f;  // El monitoreo entra con su rampa de un bloque
+  transport_declick.Reset(1.0f);
+}
+
+// Activa el render terminado en el looper y el motor granular; solo desde el audio callback.
+// new_length > 0: el render es un remuestreo que ocupa [0, new_length) y ya suena a 1.0x
+void swapRenderBuffer(float peak, size_t new_length) {
+  float* rendered = render_buffer;
+  if (new_length > 0) {
+    looper.SetLoopRegion(0, new_length - 1);
+    looper.SetPlaybackSpeed(1.0f);
+    render_buffer = looper.ReplaceBuffer(rendered, peak, false);
+    granular.SetSource(rendered, kBufferLengthSamples, 0, new_length);
+    automation.Clear();  // Las posiciones eran de la duración anterior
+  } else {
+    render_buffer = looper.ReplaceBuffer(rendered, peak);
+    granular.SetSource(rendered, kBufferLengthSamples, loop_start_sample, loop_end_sample - loop_start_sample + 1);
+    live_fx.delay->Reset();  // La cola del delay ya quedó impresa en el loop
+    automation.Clear();      // El bounce imprimió las pistas de las mezclas, la ganancia y el EQ
+  }
+  buffer = rendered;
+  buffer_swaps++;
+  #ifdef CAPTURE_SESSION
+  logAudioEvent(crearttech::CaptureEventType::SWAP, 0, (uint32_t)new_length);
+  #endif
+}
+
+// Aplica los comandos enviados por loop(); solo se llama desde el audio callback
+void applyLooperCommands() {
+  crearttech::LooperCommand cmd;
+  while (looper_commands.Pop(cmd)) {
+    #ifdef CAPTURE_SESSION
+    const float fields[3] = {(float)(int)cmd.type, cmd.value, cmd.value2};
+    block_command_hash = crearttech::OutputHash::Update(block_command_hash != 0 ? block_command_hash : crearttech::OutputHash::SEED, fields, 3);
+    #endif
+    switch (cmd.type) {
+      case crearttech::LooperCommandType::SCRUB_BEGIN: looper.BeginScrub(SCRUB_SMOOTHING_HZ, (float)kSampleRate); break;
+      case crearttech::LooperCommandType::SCRUB_TARGET: looper.SetScrubTarget(cmd.value, cmd.value2); break;
+      case crearttech::LooperCommandType::SCRUB_END: looper.EndScrub(); break;
+      case crearttech::LooperCommandType::LOOP_REGION:
+        looper.SetLoopRegion((size_t)cmd.value, (size_t)cmd.value + (size_t)cmd.value2 - 1);
+        granular.SetSource(buffer, kBufferLengthSamples, (size_t)cmd.value, (size_t)cmd.value2); break;
+      case crearttech::LooperCommandType::FREEZE: spectral_freeze.SetFrozen(cmd.value != 0.0f); break;
+      case crearttech::LooperCommandType::SWAP_BUFFER: swapRenderBuffer(cmd.value, (size_t)cmd.value2); break;
+      case crearttech::LooperCommandType::AUTOMATION_ARM: automation.Arm(cmd.value != 0.0f); break;
+      case crearttech::LooperCommandType::AUTOMATION_CLEAR: automation.Clear(); break;
+      case crearttech::LooperCommandType::TRANSPORT: applyTransport((LooperState)(int)cmd.value, cmd.value2 != 0.0f); break;
+      case crearttech::LooperCommandType::GRAIN_PARAM: granular.SetParam((crearttech::GrainParam)(int)cmd.value, cmd.value2); break;
+      case crearttech::LooperCommandType::RECORD_ARM:
+        if (looper_state != STOPPED) break;
+        looper.ArmRecording(REC_THRESHOLD, (size_t)cmd.value);
+        looper_state = ARMED;
+        break;
+      case crearttech::LooperCommandType::RECORD_STOP: applyRecordStop(); break;
+      case crearttech::LooperCommandType::OVERDUB_START:
+        if (looper_state != PLAYING) break;
+        looper.SetOverdubInputGain(cmd.value);
+        looper.StartOverdub();  // loop() terminó el snapshot del undo antes de pedirlo
+        looper_state = OVERDUB;
+        break;
+      case crearttech::LooperCommandType::RETRIGGER: looper.Retrigger(); break;
+      case crearttech::LooperCommandType::REVERSE: looper.SetReverse(cmd.value != 0.0f); break;
+      case crearttech::LooperCommandType::PLAYBACK_MODE:
+        looper.SetPlaybackMode((crearttech::PlaybackMode)(int)cmd.value);
+        if (cmd.value2 != 0.0f && !granular_playing) granular.Reset();
+        granular_playing = (cmd.value2 != 0.0f);
+        break;
+      case crearttech::LooperCommandType::PLAYBACK_SPEED: looper.SetPlaybackSpeed(cmd.value); break;
+      case crearttech::LooperCommandType::DELAY_RESET: delay_effect.Reset(); break;
+    }
+  }
+}
+
+void processAudioBlock(float** in, float** out, size_t size);
+
+// Valores actuales de las perillas automatizables, en el orden de las pistas
+void automationKnobs(uint8_t* knobs) {
+  for (size_t b = 0; b < crearttech::EQ_BANDS; b++) knobs[LANE_EQ_LOW + b] = (uint8_t)eq_knob_val[b];
+  knobs[LANE_DELAY_MIX] = (uint8_t)knob3_mix_val;
+  knobs[LANE_REVERB_MIX] = (uint8_t)knob2_reverb_val;
+  knobs[LANE_GAIN] = (uint8_t)(g_gain * 100.0f + 0.5f);
+}
+
+// Perillas -> pistas de automatización -> objetivos de suavizado. Las pistas siguen la
+// posición del cabezal mientras el looper reproduce; un ciclo empieza en cada borde de la región.
+void updateAutomation() {
+  static uint32_t last_cycle = 0;
+  uint32_t cycle = looper.GetCycleCount();
+  bool new_cycle = (cycle != last_cycle);
+  last_cycle = cycle;
+
+  uint8_t knobs[LANE_COUNT], values[LANE_COUNT];
+  automationKnobs(knobs);
+  if (looper_state == PLAYING || looper_state == OVERDUB) {
+    automation.Process(new_cycle, (uint32_t)looper.GetLoopPlayheadPosition(), looper.IsPlayingForward(), knobs, values);
+  }
+  else memcpy(values, knobs, sizeof(values));
+
+  for (size_t b = 0; b < crearttech::EQ_BANDS; b++) eq_smoothers[b].SetTarget((float)values[LANE_EQ_LOW + b]);
+  delay_mix_smoother.SetTarget((float)values[LANE_DELAY_MIX] / 100.0f);
+  reverb_mix_smoother.SetTarget((float)values[LANE_REVERB_MIX] / 100.0f);
+  gain_smoother.SetTarget((float)values[LANE_GAIN] / 100.0f);
+
+  automation_status = automation.IsRecording() ? AUTOMATION_RECORDING : automation.IsArmed() ? AUTOMATION_ARMED :
+                      automation.HasData() ? AUTOMATION_PLAYING : AUTOMATION_OFF;
+}
+
+// Los suavizadores saltan a los valores de las perillas (arranque y perfiles)
+void resetParamSmoothers() {
+  for (size_t b = 0; b < crearttech::EQ_BANDS; b++) eq_smoothers[b].Reset((float)eq_knob_val[b]);
+  delay_mix_smoother.Reset((float)knob3_mix_val / 100.0f);
+  reverb_mix_smoother.Reset((float)knob2_reverb_val / 100.0f);
+  gain_smoother.Reset(g_gain);
+}
+
+// Comandos de loop() que no entraron en la cola: se reenvían en orden al empezar la
+// próxima lectura de controles, antes que cualquier comando nuevo
+const size_t COMMAND_BACKLOG_SIZE = 32;
+static crearttech::LooperCommand command_backlog[COMMAND_BACKLOG_SIZE];
+static size_t command_backlog_count = 0;
+
+// Desde loop(): encola el comando o lo deja pendiente; false solo si la reserva también está llena
+bool sendCommand(const crearttech::LooperCommand& cmd) {
+  if (command_backlog_count == 0 && looper_commands.Push(cmd)) return true;
+  if (command_backlog_count == COMMAND_BACKLOG_SIZE) return false;
+  command_backlog[command_backlog_count++] = cmd;
+  return true;
+}
+
+void flushCommandBacklog() {
+  size_t sent = 0;
+  while (sent < command_backlog_count && looper_commands.Push(command_backlog[sent])) sent++;
+  if (sent == 0) return;
+  command_backlog_count -= sent;
+  memmove(command_backlog, command_backlog + sent, sizeof(command_backlog[0]) * command_backlog_count);
+}
+
+// Desde loop(): el encoder 4 vuelve a ganancia; si estaba en scrub el cabezal sigue solo
+void leaveScrubMode() {
+  if (enc4_mode == ENC4_MODE_SCRUB) {
+    crearttech::LooperCommand cmd = {crearttech::LooperCommandType::SCRUB_END, 0.0f, 0.0f};
+    sendCommand(cmd);
+  }
+  enc4_mode = ENC4_MODE_GAIN;
+}
+
+// Desde loop(): cambio de estado con rampa (lo aplica el audio callback)
+bool requestTransport(LooperState target, bool restart) {
+  crearttech::LooperCommand cmd = {crearttech::LooperCommandType::TRANSPORT, (float)target, restart ? 1.0f : 0.0f};
+  return sendCommand(cmd);
+}
+
+// Desde loop(): el parámetro granular se envía al audio callback en el próximo flushGrainParams()
+void markGrainParam(crearttech::GrainParam param) {
+  grain_params_pending |= (uint8_t)(1u << (int)param);
+}
+
+// Envía los parámetros marcados; los que no entran en la cola se reintentan en la próxima vuelta
+void flushGrainParams() {
+  const float values[(int)crearttech::GrainParam::COUNT] = {grain_position, grain_spray, grain_size_ms, grain_density, g_current_pitch_ratio};
+  for (int p = 0; p < (int)crearttech::GrainParam::COUNT && grain_params_pending != 0; p++) {
+    if ((grain_params_pending & (1u << p)) == 0) continue;
+    crearttech::LooperCommand cmd = {crearttech::LooperCommandType::GRAIN_PARAM, (float)p, values[p]};
+    if (!sendCommand(cmd)) return;
+    grain_params_pending &= (uint8_t)~(1u << p);
+  }
+}
+
+// Desde loop(): las pistas grabadas dejan de valer para la toma nueva. Si no entra ni en la
+// reserva de comandos queda pendiente y se reintenta en cada lectura hasta enviarse
+static bool automation_clear_pending = false;
+
+void clearAutomation() {
+  crearttech::LooperCommand cmd = {crearttech::LooperCommandType::AUTOMATION_CLEAR, 0.0f, 0.0f};
+  automation_clear_pending = !sendCommand(cmd);
+}
+
+// Sin callback previo no hay separación que medir (también tras una pausa deliberada)
+static bool xrun_interval_valid = false;
+
+// Duración del callback y separación desde el anterior contra el periodo del bloque;
+// llamar después de profiler.EndBlock()
+void checkXrun(uint32_t callback_start) {
+  static uint32_t last_start = 0;
+  bool started = xrun_interval_valid;
+  xrun_interval_valid = true;
+  uint32_t interval = callback_start - last_start;
+  last_start = callback_start;
+  uint32_t cycles = profiler.GetLastCycles(crearttech::ProfileStage::CALLBACK);
+  float budget = profiler.GetBudgetCycles();
+
+  crearttech::XrunRecord record;
+  if ((float)cycles > budget) record.kind = crearttech::XrunKind::OVERRUN;
+  else if (started && (float)interval > XRUN_LATE_BLOCKS * budget) record.kind = crearttech::XrunKind::LATE;
+  else return;
+
+  record.uptime_ms = millis();
+  record.callback_cycles = cycles;
+  record.interval_cycles = interval;
+  for (size_t i = 0; i < (size_t)crearttech::ProfileStage::COUNT; i++) {
+    record.stage_cycles[i] = profiler.GetLastCycles((crearttech::ProfileStage)i);
+  }
+  record.looper_state = (uint8_t)looper_state;
+  record.flags = (granular_playing ? crearttech::XRUN_FLAG_GRANULAR : 0) | (freeze_enabled ? crearttech::XRUN_FLAG_FREEZE : 0) |
+                 (reverse_mode ? crearttech::XRUN_FLAG_REVERSE : 0) | (effects_printed ? crearttech::XRUN_FLAG_EFFECTS_PRINTED : 0) |
+                 (effects_idle ? crearttech::XRUN_FLAG_EFFECTS_IDLE : 0) | (speaker_muted ? crearttech::XRUN_FLAG_LINE_INPUT : 0);
+  record.eq_bands = 0;
+  for (size_t b = 0; b < crearttech::EQ_BANDS; b++) {
+    if (live_eq.GetBand((crearttech::EqBand)b) != crearttech::EQ_KNOB_FLAT) record.eq_bands |= 1 << b;
+  }
+  record.delay_mix = (uint8_t)(delay_mix * 100.0f);
+  record.reverb_mix = (uint8_t)knob2_reverb_val;
+  record.active_grains = (uint8_t)granular.GetActiveGrains();
+  record.reserved = 0;
+  xrun_log.Record(record);
+}
+
 void AudioCallback(float** in, float** out, size_t size) {
+  TRACE_BEGIN(audio_trace, TRACE_CALLBACK);
+  uint32_t callback_start = crearttech::CycleCounter::Now();
+  profiler.Begin(crearttech::ProfileStage::CALLBACK);
+  #ifdef DEBUG
+  if (!crearttech::FloatingPointMode::IsFlushToZeroEnabled()) ftz_missing_blocks++;
+  #endif
+  #ifdef CAPTURE_SESSION
+  if (!session_replaying && !capture_stopped && input_log.Write(in[0], size) < size) capture_stopped = true;
+  block_command_hash = 0;
+  #endif
+  TRACE_BEGIN(audio_trace, TRACE_COMMANDS);
+  if (!command_batch_open) applyLooperCommands();
+  applyJackEvents();
+  updateAutomation();
+  TRACE_END(audio_trace, TRACE_COMMANDS);
+  input_meter.ProcessBlock(in[0], size);  // En todos los estados: el nivel se ve antes de grabar
+  processAudioBlock(in, out, size);
+  analyzer_ring.Write(out[0], size); // Única interacción con el analizador: una copia de bloque
+
+  output_meter.ProcessBlock(out[0], size);
+  output_loudness.ProcessBlock(out[0], size);
+  crearttech::MeterReading reading = {
+    input_meter.GetPeak(), input_meter.GetRMS(),
+    output_meter.GetPeak(), output_meter.GetRMS(), output_loudness.GetLUFS()
+  };
+  meter_snapshot.Write(reading);
+  profiler.End(crearttech::ProfileStage::CALLBACK);
+  profiler.EndBlock();
+  checkXrun(callback_start);
+
+  // Costo por grano por muestra (promedio exponencial) y ajuste de granos según la carga
+  if (granular_playing) {
+    size_t grain_samples = granular.GetGrainSamplesLastBlock();
+    if (grain_samples > 0) {
+      float per_sample = (float)profiler.GetLastCycles(crearttech::ProfileStage::GRANULAR) / (float)grain_samples;
+      granular_cycles_per_grain_sample += 0.01f * (per_sample - granular_cycles_per_grain_sample);
+    }
+    #ifdef CAPTURE_SESSION
+    // La carga no se repite igual: al repetir, el presupuesto sale del registro
+    if (!session_replaying) {
+      size_t max_grains = granular.GetMaxActiveGrains();
+      granular.UpdateGrainBudget(profiler.GetLoad(), size);
+      if (granular.GetMaxActiveGrains() != max_grains) {
+        logAudioEvent(crearttech::CaptureEventType::GRAINS, 0, (uint32_t)granular.GetMaxActiveGrains());
+      }
+    }
+    #else
+    granular.UpdateGrainBudget(profiler.GetLoad(), size);
+    #endif
+  }
+  #ifdef TRACE
+  // Cambios de estado del looper tal como los ve el callback (los de loop() un bloque después)
+  static LooperState traced_state = STOPPED;
+  if (looper_state != traced_state) { traced_state = looper_state; TRACE_INSTANT(audio_trace, TRACE_LOOPER_STATE, looper_state); }
+  #endif
+  #ifdef CAPTURE_SESSION
+  endSessionBlock(out[0], out[1], size);
+  #endif
+  TRACE_END(audio_trace, TRACE_CALLBACK);
+}
+
+// Parámetros sin estado de la cadena, leídos una vez por bloque (en vivo o en el bounce)
+struct EffectParams {
+  bool eq_active;        // Alguna banda fuera de 0 dB
+  float input_gain;      // take_gain
+  float delay_feedback;
+  float delay_mix;
+  float reverb_mix;
+  float output_gain;     // g_gain
+  // Rampas por muestra del suavizado
+  float delay_mix_step;
+  float reverb_mix_step;
+  float output_gain_step;
+};
+
+bool eqKnobsFlat() {
+  for (size_t b = 0; b < crearttech::EQ_BANDS; b++) {
+    if (eq_knob_val[b] != crearttech::EQ_KNOB_FLAT) return false;
+  }
+  return true;
+}
+
+EffectParams currentEffectParams() {
+  EffectParams p = {!eqKnobsFlat(), take_gain, delay_feedback, delay_mix, (float)knob2_reverb_val / 100.0f, g_gain};
+  return p;
+}
+
+// Con estos parámetros la cadena no cambia el sonido (salvo el limitador)
+bool effectsNeutral(const EffectParams& p) {
+  return !p.eq_active && p.delay_mix == 0.0f && p.reverb_mix == 0.0f &&
+         p.input_gain == 1.0f && p.output_gain == 1.0f &&
+         p.delay_mix_step == 0.0f && p.reverb_mix_step == 0.0f && p.output_gain_step == 0.0f;
+}
+
+// Parámetros del bloque en vivo: mezclas y ganancia con rampa, bandas del EQ por bloque
+// (el EQ copia coeficientes de la tabla solo cuando cambia la posición redondeada)
+EffectParams liveEffectParams(size_t size) {
+  EffectParams p = currentEffectParams();
+  p.delay_mix = delay_mix_smoother.Next(size, p.delay_mix_step);
+  p.reverb_mix = reverb_mix_smoother.Next(size, p.reverb_mix_step);
+  p.output_gain = gain_smoother.Next(size, p.output_gain_step);
+
+  float step;
+  for (size_t b = 0; b < crearttech::EQ_BANDS; b++) {
+    eq_smoothers[b].Next(size, step);
+    live_eq.SetBand((crearttech::EqBand)b, (uint8_t)lrintf(eq_smoothers[b].GetCurrent()));
+  }
+  p.eq_active = !live_eq.IsFlat();
+  return p;
+}
+
+void setReverbParams(daisysp::ReverbSc* reverb) {
+  reverb->SetFeedback(((float)knob2_decay_val / 100.0f) * 0.70f);
+  reverb->SetLpFreq(500.0f + ((float)knob2_size_val / 100.0f * 15000.0f));
+}
+
+// Filtros, delay, reverb y limitador sobre el bloque del looper; devuelve el pico de salida
+float processEffects(EffectChain& fx, const EffectParams& p, float* out0, float* out1, size_t size) {
+  float effects_peak = 0.0f;
+  float delay_mix = p.delay_mix, reverb_mix = p.reverb_mix, output_gain = p.output_gain;
+  const bool reverb_on = p.reverb_mix > 0.0f || p.reverb_mix_step != 0.0f;
+
+  // EQ: un llamado por bloque a la cascada de biquads (lineal: conmuta con input_gain)
+  if (p.eq_active) fx.eq->Process(out0, size);
+
+  for (size_t i = 0; i < size; i++) {
+    float signal_to_process = out0[i] * p.input_gain;
+
+    // Delay
+    float delayed = fx.delay->Read();
+    fx.delay->Write(signal_to_process + (delayed * p.delay_feedback));
+    float post_delay = (signal_to_process * (1.0f - delay_mix)) + (delayed * delay_mix);
+
+    // Reverb
+    float reverb_out_l = 0.0f, reverb_out_r = 0.0f;
+    float mono_reverb = 0.0f;
+
+    if (reverb_on) {
+      fx.reverb->Process(post_delay, post_delay, &reverb_out_l, &reverb_out_r);
+      mono_reverb = (reverb_out_l + reverb_out_r) * 0.5f;
+    }
+
+    float wet_signal = (post_delay * (1.0f - reverb_mix)) + (mono_reverb * reverb_mix);
+
+    // Ganancia y limitador
+    float final_signal = wet_signal * output_gain;
+    final_signal = tanhf(final_signal); // Soft clip
+
+    out0[i] = out1[i] = final_signal;
+    float a = fabsf(final_signal);
+    if (a > effects_peak) effects_peak = a;
+
+    delay_mix += p.delay_mix_step;
+    reverb_mix += p.reverb_mix_step;
+    output_gain += p.output_gain_step;
+  }
+  return effects_peak;
+}
+
+void processAudioBlock(float** in, float** out, size_t size) {
+
+  if (looper_state != RECORDING && looper_state != OVERDUB && looper_state != ARMED) input_dynamics_running = false;
+
+  // Un comando cambió el estado (ej. overdub) durante una rampa de salida: se descarta
+  if (transport_pending && looper_state != PLAYING) {
+    transport_pending = false;
+    transport_declick.Reset(1.0f);
+  }
 
   // --- REGLA: La entrada solo se procesa para grabar y sobregrabar ---
 
   // Estados con SALIDA SILENCIOSA y SIN procesamiento de entrada hacia el looper (solo limpia delay)
   if (looper_state == PAUSED || looper_state == STOPPED) {
+    // Pass-through del input si queremos que suene mientras estamos parados, o mute.
+    // Si speaker_muted es true, cortamos el sonido directo de entrada para evitar feedback.
+    // El cambio de fuente se hace con una rampa a lo largo del bloque (sin clicks).
+    float monitor_target = (!speaker_muted && !take_handover) ? 1.0f : 0.0f;
+    float monitor_step = (monitor_target - input_monitor_gain) / (float)size;
     for (size_t i = 0; i < size; i++) {
-      // Pass-through del input si queremos que suene mientras estamos parados, o mute.
-      // Si speaker_muted es true, cortamos el sonido directo de entrada para evitar feedback.
-      float input_signal = !speaker_muted ? in[0][i] : 0.0f;
-      out[0][i] = out[1][i] = input_signal * g_gain; 
+      input_monitor_gain += monitor_step;
+      out[0][i] = out[1][i] = in[0][i] * input_monitor_gain * g_gain;
     }
+    input_monitor_gain = monitor_target;
     delay_effect.Write(0.0f);  // Limpiar buffer de delay para prevenir resto de sonido
     return;
   }
 
   // Estados con SALIDA SILENCIOSA (o passthrough sin feedback) y CON procesamiento de grabación
-  if (looper_state == RECORDING || looper_state == OVERDUB) {
-    for (size_t i = 0; i < size; i++) {
-      float input_signal = in[0][i]; // Usamos el canal 0 como entrada principal
-      looper.Process(input_signal);  // Lo que sea que entre, lo procesamos (grabamos)
-
-      // Llenar el buffer visual de Ableton-style
-      if (looper_state == RECORDING) {
-        size_t pos = record_counter;
-        if (pos < kBufferLengthSamples) {
-          waveform_source_buffer[pos] = input_signal;
-          record_counter++;
-          if (record_counter > kBufferLengthSamples) record_counter = kBufferLengthSamples;
-          waveform_display_needs_update = true;
-        }
+  if (looper_state == RECORDING || looper_state == OVERDUB || looper_state == ARMED) {
+    // Usamos el canal 0 como entrada principal; lo que sea que entre, lo grabamos.
+    // La dinámica se aplica en el lugar: la captura y el medidor ya leyeron la entrada cruda
+    TRACE_BEGIN(audio_trace, TRACE_DYNAMICS);
+    profiler.Begin(crearttech::ProfileStage::DYNAMICS);
+    if (!input_dynamics_running) input_dynamics.Reset();  // El detector no arrastra el nivel de la toma anterior
+    input_dynamics_running = true;
+    input_dynamics.Process(in[0], size);
+    profiler.End(crearttech::ProfileStage::DYNAMICS);
+    TRACE_END(audio_trace, TRACE_DYNAMICS);
+
+    TRACE_BEGIN(audio_trace, TRACE_LOOPER);
+    profiler.Begin(crearttech::ProfileStage::LOOPER);
+    looper.ProcessBlock(in[0], out[0], size);
+    profiler.End(crearttech::ProfileStage::LOOPER);
+    TRACE_END(audio_trace, TRACE_LOOPER);
+
+    // El looper detectó el umbral dentro de este bloque: la toma ya empezó
+    if (looper_state == ARMED && !looper.IsArmed()) looper_state = RECORDING;
+
+    if (looper_state == RECORDING) {
+      // Llenar el buffer visual de Ableton-style con lo grabado (incluido el pre-roll)
+      size_t head = looper.GetRecordHead();
+      size_t pos = record_counter;
+      if (head > pos) {
+        memcpy(waveform_source_buffer + pos, buffer + pos, sizeof(float) * (head - pos));
+        record_counter = head;
+        waveform_display_needs_update = true;
       }
-      // La salida es silenciosa (o solo passthrough si se requiere) para prevenir feedback
-      out[0][i] = out[1][i] = 0.0f; 
     }
+    // La salida es silenciosa (o solo passthrough si se requiere) para prevenir feedback
+    for (size_t i = 0; i < size; i++) out[0][i] = out[1][i] = 0.0f;
     return;
   }
 
@@ -605,63 +1710,810 @@ void AudioCallback(float** in, float** out, size_t size) {
   // El único estado con salida audible.
   delay_effect.SetDelay(delay_time_samples);
 
-  for (size_t i = 0; i < size; i++) {
-    // Procesar silencio a través del looper para obtener la señal ya grabada
-    float normal_looper_output = looper.Process(0.0f);
-    float signal_to_process = normal_looper_output;
+  // Leer el bloque ya grabado (sin overdub la entrada se ignora) o la nube granular
+  if (granular_playing) {
+    TRACE_BEGIN(audio_trace, TRACE_GRANULAR);
+    profiler.Begin(crearttech::ProfileStage::GRANULAR);
+    granular.ProcessBlock(out[0], size);
+    profiler.End(crearttech::ProfileStage::GRANULAR);
+    TRACE_END(audio_trace, TRACE_GRANULAR);
+  } else {
+    TRACE_BEGIN(audio_trace, TRACE_LOOPER);
+    profiler.Begin(crearttech::ProfileStage::LOOPER);
+    looper.ProcessBlock(in[0], out[0], size);
+    profiler.End(crearttech::ProfileStage::LOOPER);
+    TRACE_END(audio_trace, TRACE_LOOPER);
+  }
 
-    // Filtros
-    if (enc1_mode == HIGHPASS) {
-      g_highpass_filter->Process(signal_to_process);
-      signal_to_process = g_highpass_filter->High();
-    } else if (enc1_mode == LOWPASS) {
-      g_lowpass_filter->Process(signal_to_process);
-      signal_to_process = g_lowpass_filter->Low();
+  // Fuente en silencio: los efectos reciben ceros solo hasta que se apagan sus colas
+  EffectParams fx_params = liveEffectParams(size);
+  bool source_silent = !granular_playing && looper.LastBlockSilent();
+  if (effects_printed && !granular_playing && effectsNeutral(fx_params)) {
+    // Bounce: los efectos ya están en el búfer
+    memcpy(out[1], out[0], sizeof(float) * size);
+  } else if (source_silent && effects_idle) {
+    silent_blocks_skipped++;
+    memset(out[1], 0, sizeof(float) * size);  // out[0] ya viene en ceros del looper
+  } else {
+    effects_idle = false;
+    TRACE_BEGIN(audio_trace, TRACE_EFFECTS);
+    profiler.Begin(crearttech::ProfileStage::EFFECTS);
+    float effects_peak = processEffects(live_fx, fx_params, out[0], out[1], size);
+    profiler.End(crearttech::ProfileStage::EFFECTS);
+    TRACE_END(audio_trace, TRACE_EFFECTS);
+
+    effects_quiet_blocks = (source_silent && effects_peak < EFFECTS_TAIL_THRESHOLD) ? effects_quiet_blocks + 1 : 0;
+    if (effects_quiet_blocks >= EFFECTS_TAIL_BLOCKS) {
+      effects_idle = true;
+      effects_quiet_blocks = 0;
+      delay_effect.Reset();  // Lo que quede en la línea ya es inaudible
     }
+  }
 
-    // Delay
-    float delayed = delay_effect.Read();
-    delay_effect.Write(signal_to_process + (delayed * delay_feedback));
-    float post_delay = (signal_to_process * (1.0f - delay_mix)) + (delayed * delay_mix);
+  // Freeze espectral sobre la salida final (una etapa de FFT por callback)
+  TRACE_BEGIN(audio_trace, TRACE_SPECTRAL);
+  profiler.Begin(crearttech::ProfileStage::SPECTRAL);
+  spectral_freeze.ProcessBlock(out[0], size);
+  if (spectral_freeze.IsActive()) memcpy(out[1], out[0], sizeof(float) * size);
+  profiler.End(crearttech::ProfileStage::SPECTRAL);
+  TRACE_END(audio_trace, TRACE_SPECTRAL);
+
+  // Rampa de transporte sobre la salida final
+  transport_declick.Process(out[0], out[1], size);
+  if (transport_pending && !transport_declick.IsRamping()) commitTransport();
+}
 
-    // Reverb
-    float reverb_out_l = 0.0f, reverb_out_r = 0.0f;
-    float reverb_mix = (float)knob2_reverb_val / 100.0f;
-    float mono_reverb = 0.0f;
+//====================================================================
+// --- BOUNCE (RENDER DE LOS EFECTOS EN EL LOOP) ---
+//====================================================================
+// Render del loop con la cadena de efectos en la arena de render. Primero copia la toma
+// fuera de la región; después recorre la región dos veces: la primera solo carga las colas
+// de delay y reverb, y la segunda escribe el resultado, así las colas del final del loop
+// quedan sobre su inicio. Las mezclas, la ganancia y el EQ siguen las pistas de
+// automatización en la posición de cada bloque. Al terminar pide al audio callback el
+// intercambio de búferes.
+const size_t BOUNCE_BLOCK_SAMPLES = 48;
+
+// Un solo render a la vez usa la arena; el intercambio lo confirma buffer_swaps
+enum RenderKind { RENDER_BOUNCE, RENDER_RESAMPLE };
+static RenderKind pending_render = RENDER_BOUNCE;
+static bool render_swap_pending = false;
+
+// Pide al audio callback que active la arena; false si la cola está llena (reintentar)
+bool requestRenderSwap(RenderKind kind, float peak, size_t new_length) {
+  crearttech::LooperCommand cmd = {crearttech::LooperCommandType::SWAP_BUFFER, peak, (float)new_length};
+  if (!sendCommand(cmd)) return false;
+  pending_render = kind;
+  render_swap_pending = true;
+  return true;
+}
 
-    if (reverb_mix > 0.0f) {
-      reverb_effect->Process(post_delay, post_delay, &reverb_out_l, &reverb_out_r);
-      mono_reverb = (reverb_out_l + reverb_out_r) * 0.5f;
+class BounceJob : public crearttech::Job {
+public:
+  void Restart(size_t start, size_t end, size_t take_length) {
+    _start = start;
+    _length = end - start + 1;
+    _take_length = take_length;
+    _phase = COPY_TAKE;
+    _pos = 0;
+    _peak = 0.0f;
+    _params = currentEffectParams();
+
+    // Las pistas se leen en la posición de cada bloque, con el mismo suavizado que en vivo
+    automationKnobs(_knobs);
+    uint8_t values[LANE_COUNT];
+    automation.Lookup(0, _knobs, values);
+    const float block_rate = (float)kSampleRate / (float)BOUNCE_BLOCK_SAMPLES;
+    for (size_t i = 0; i < LANE_COUNT; i++) {
+      _smoothers[i].Init(PARAM_SMOOTHING_MS, block_rate);
+      _smoothers[i].Reset(laneScale(i) * (float)values[i]);
     }
+    bounce_fx.eq->Reset();
+    bounce_fx.delay->Reset();
+    bounce_fx.delay->SetDelay(delay_time_samples);
+    bounce_fx.reverb->Init(kSampleRate);
+    setReverbParams(bounce_fx.reverb);
+  }
 
-    float wet_signal = (post_delay * (1.0f - reverb_mix)) + (mono_reverb * reverb_mix);
+  bool Step(size_t max_samples) override {
+    switch (_phase) {
+      case COPY_TAKE: {
+        // Lo que queda fuera de la región se copia tal cual
+        if (_pos >= _start && _pos < _start + _length) _pos = _start + _length;
+        size_t limit = (_pos < _start) ? _start : _take_length;
+        size_t n = (limit > _pos) ? limit - _pos : 0;
+        if (n > max_samples) n = max_samples;
+        memcpy(render_buffer + _pos, buffer + _pos, sizeof(float) * n);
+        _pos += n;
+        if (_pos >= _take_length) { _phase = WARM_UP; _pos = 0; }
+        return false;
+      }
+      case WARM_UP:
+      case RENDER: {
+        size_t n = _length - _pos;
+        if (n > max_samples) n = max_samples;
+        // En la pasada de carga también se escribe en la arena: la segunda lo sobrescribe
+        float* dst = render_buffer + _start + _pos;
+        memcpy(dst, buffer + _start + _pos, sizeof(float) * n);
+        for (size_t i = 0; i < n; i += BOUNCE_BLOCK_SAMPLES) {
+          size_t block = (n - i < BOUNCE_BLOCK_SAMPLES) ? n - i : BOUNCE_BLOCK_SAMPLES;
+          AutomateParams(_pos + i, block);
+          float peak = processEffects(bounce_fx, _params, dst + i, dst + i, block);
+          if (peak > _peak) _peak = peak;
+        }
+        _pos += n;
+        if (_pos < _length) return false;
+        _pos = 0;
+        if (_phase == WARM_UP) { _phase = RENDER; _peak = 0.0f; }
+        else _phase = SWAP;
+        return false;
+      }
+      case SWAP: {
+        // El bounce se confirma como nivel de undo: se espera el snapshot de la región
+        if (jobs.IsPending(&undo_snapshot_job)) return false;
+        return requestRenderSwap(RENDER_BOUNCE, _peak, 0);
+      }
+    }
+    return true;
+  }
 
-    // Ganancia y limitador
-    float final_signal = wet_signal * g_gain;
-    final_signal = tanhf(final_signal); // Soft clip
+  float GetProgress() const override {
+    if (_phase == COPY_TAKE) return 0.0f;
+    float pass = (_length > 0) ? (float)_pos / (float)_length : 1.0f;
+    return (_phase == WARM_UP) ? 0.5f * pass : (_phase == RENDER) ? 0.5f + 0.5f * pass : 1.0f;
+  }
+
+private:
+  enum Phase { COPY_TAKE, WARM_UP, RENDER, SWAP };
+
+  // Los mixes y la ganancia van en 0..1; las bandas del EQ en posiciones de perilla
+  static float laneScale(size_t lane) { return (lane < crearttech::EQ_BANDS) ? 1.0f : 0.01f; }
+
+  // Parámetros del bloque que empieza en position (relativa a la región)
+  void AutomateParams(size_t position, size_t block) {
+    uint8_t values[LANE_COUNT];
+    automation.Lookup((uint32_t)position, _knobs, values);
+    for (size_t i = 0; i < LANE_COUNT; i++) _smoothers[i].SetTarget(laneScale(i) * (float)values[i]);
+    _params.delay_mix = _smoothers[LANE_DELAY_MIX].Next(block, _params.delay_mix_step);
+    _params.reverb_mix = _smoothers[LANE_REVERB_MIX].Next(block, _params.reverb_mix_step);
+    _params.output_gain = _smoothers[LANE_GAIN].Next(block, _params.output_gain_step);
+
+    float step;
+    for (size_t b = 0; b < crearttech::EQ_BANDS; b++) {
+      _smoothers[LANE_EQ_LOW + b].Next(block, step);
+      bounce_fx.eq->SetBand((crearttech::EqBand)b, (uint8_t)lrintf(_smoothers[LANE_EQ_LOW + b].GetCurrent()));
+    }
+    _params.eq_active = !bounce_fx.eq->IsFlat();
+  }
+
+  Phase _phase = COPY_TAKE;
+  size_t _start = 0, _length = 0, _take_length = 0, _pos = 0;
+  float _peak = 0.0f;
+  EffectParams _params;
+  uint8_t _knobs[LANE_COUNT];
+  crearttech::ParamSmoother _smoothers[LANE_COUNT];
+};
+static BounceJob bounce_job;
+
+// El bounce lee las pistas desde loop(): mientras dure no se puede grabar automatización
+bool bounceInProgress() {
+  return jobs.IsPending(&bounce_job) || (render_swap_pending && pending_render == RENDER_BOUNCE);
+}
+
+// Remuestreo destructivo del loop a la afinación actual (windowed-sinc polifásico).
+// El resultado ocupa el inicio de la arena; al activarlo la reproducción vuelve a 1.0x
+// y la afinación ya no cuesta interpolación en tiempo real.
+class ResampleJob : public crearttech::Job {
+public:
+  void Restart(size_t start, size_t end, float ratio) {
+    _start = start;
+    _length = end - start + 1;
+    _resampler.Init(ratio);
+    _out_length = _resampler.OutputLength(_length);
+    if (_out_length > kBufferLengthSamples) _out_length = kBufferLengthSamples;
+    if (_out_length < 1) _out_length = 1;
+    _pos = 0;
+    _peak = 0.0f;
+  }
 
-    out[0][i] = out[1][i] = final_signal;
+  bool Step(size_t max_samples) override {
+    if (_pos >= _out_length) return requestRenderSwap(RENDER_RESAMPLE, _peak, _out_length);
+
+    size_t n = _out_length - _pos;
+    if (n > max_samples) n = max_samples;
+    float* dst = render_buffer + _pos;
+    _resampler.Process(buffer + _start, _length, _out_length, dst, _pos, n);
+    float peak, sum_squares;
+    crearttech::DSPUtils::PeakAndSumSquares(dst, n, peak, sum_squares);
+    if (peak > _peak) _peak = peak;
+    _pos += n;
+    return false;
   }
+
+  float GetProgress() const override { return (float)_pos / (float)_out_length; }
+  size_t GetOutputLength() const { return _out_length; }
+
+private:
+  crearttech::PolyphaseResampler _resampler;
+  size_t _start = 0, _length = 0, _out_length = 1, _pos = 0;
+  float _peak = 0.0f;
+};
+static ResampleJob resample_job;
+
+void cancelRenders() {
+  jobs.Cancel(&bounce_job);
+  jobs.Cancel(&resample_job);
+}
+
+void startBounce() {
+  if (looper_state != PLAYING || granular_mode || recorded_samples == 0 || render_swap_pending) return;
+  if (automation_status == AUTOMATION_ARMED || automation_status == AUTOMATION_RECORDING) return;
+  cancelRenders();
+  bounce_job.Restart(loop_start_sample, loop_end_sample, recorded_samples);
+  jobs.Submit(&bounce_job, crearttech::JobPriority::MAINTENANCE);
+}
+
+void startResample() {
+  if (looper_state != PLAYING || granular_mode || recorded_samples == 0 || render_swap_pending) return;
+  if (g_current_pitch_ratio == 1.0f) return;
+  cancelRenders();
+  resample_job.Restart(loop_start_sample, loop_end_sample, g_current_pitch_ratio);
+  jobs.Submit(&resample_job, crearttech::JobPriority::MAINTENANCE);
+}
+
+// El bounce quedó activo: los efectos quedan neutros para no aplicarlos dos veces. Es a
+// propósito que la ganancia, las mezclas, el EQ y los contadores de sus encoders vuelvan a
+// cero: la perilla muestra lo que suena encima del loop impreso, no lo que ya quedó en él
+void finishBounce() {
+  take_gain = 1.0f; g_gain = 1.0f;
+  knob2_reverb_val = 0; knob3_mix_val = 0; delay_mix = 0.0f;
+  for (size_t b = 0; b < crearttech::EQ_BANDS; b++) eq_knob_val[b] = crearttech::EQ_KNOB_FLAT;
+  noInterrupts();
+  if (knob2_mode == REVERB) enc2_counter = 0;
+  if (knob3_mode == MIX) enc3_counter = 0;
+  if (enc1_mode != PITCH) {
+    // Volver al modo pitch sin cambiar la afinación actual
+    enc1_mode = PITCH;
+    enc1_counter = (int)roundf(12.0f * log2f(g_current_pitch_ratio)) * PITCH_SENSITIVITY;
+  }
+  interrupts();
+  effects_printed = true;
+  waveform_copy_job.Restart(loop_start_sample, loop_end_sample + 1);
+  jobs.Submit(&waveform_copy_job, crearttech::JobPriority::DISPLAY_UPDATE);
+  jobs.Submit(&undo_snapshot_job, crearttech::JobPriority::INTERACTIVE);  // Snapshot del búfer nuevo
+}
+
+// El remuestreo quedó activo: la toma es la región nueva y la afinación vuelve a 0
+void finishResample(size_t new_length) {
+  recorded_samples = new_length;
+  noInterrupts(); record_counter = new_length; interrupts();
+  loop_start_sample = 0; loop_end_sample = new_length - 1;
+  g_current_pitch_ratio = 1.0f;
+  applied_pitch_semitones = 0;
+  markGrainParam(crearttech::GrainParam::PITCH);
+  if (enc1_mode == PITCH) { noInterrupts(); enc1_counter = 0; interrupts(); }
+  waveform_copy_job.Restart(0, new_length);
+  jobs.Submit(&waveform_copy_job, crearttech::JobPriority::DISPLAY_UPDATE);
+  jobs.Submit(&undo_snapshot_job, crearttech::JobPriority::INTERACTIVE);
+}
+
+void finishRender() {
+  render_swap_pending = false;
+  if (pending_render == RENDER_BOUNCE) finishBounce();
+  else finishResample(resample_job.GetOutputLength());
+}
+
+// Región que no entró ni en la reserva de comandos; se reintenta en cada lectura (solo la última)
+static crearttech::LooperCommand loop_region;
+static bool loop_region_pending = false;
+
+// Cambia la región del loop y del motor granular (la aplica el audio callback)
+void setLoopRegion(size_t start_sample, size_t end_sample) {
+  cancelRenders();  // El render en curso era de la región anterior
+  loop_region = {crearttech::LooperCommandType::LOOP_REGION, (float)start_sample, (float)(end_sample - start_sample + 1)};
+  loop_region_pending = !sendCommand(loop_region);
+  jobs.Submit(&undo_snapshot_job, crearttech::JobPriority::INTERACTIVE);  // El snapshot depende de la región
+}
+
+// La toma terminó en el audio callback (quedó en pausa): recorte de silencios y normalización
+// con las estadísticas de la grabación, y la reproducción entra con la rampa del transporte
+void finishTake() {
+  if (!take_expected) return;  // Descartada con un doble toque mientras terminaba
+  take_expected = false;
+  recorded_samples = record_counter;
+  size_t trim_start, trim_end; float gain;
+  looper.AnalyzeTake(recorded_samples, TRIM_SILENCE_THRESHOLD, NORMALIZE_TARGET_PEAK, trim_start, trim_end, gain);
+  loop_start_sample = trim_start; loop_end_sample = trim_end; take_gain = gain;
+  setLoopRegion(loop_start_sample, loop_end_sample);
+  requestTransport(PLAYING, false);
+  clear_job.Restart(buffer, recorded_samples, kBufferLengthSamples);
+  jobs.Submit(&clear_job, crearttech::JobPriority::MAINTENANCE);
+  waveform_display_needs_update = true;
+}
+
+// El overdub terminó: el snapshot para el próximo se copia en segundo plano
+void finishOverdub() {
+  jobs.Submit(&undo_snapshot_job, crearttech::JobPriority::INTERACTIVE);
+}
+
+// Cierra un lote de comandos de loop(). El evento que lo repite se registra con las
+// interrupciones apagadas: su bloque es el primero que aplica los comandos del lote
+void closeCommandBatch(crearttech::CaptureEventType type) {
+  noInterrupts();
+  #ifdef CAPTURE_SESSION
+  logUiEvent(type, 0, 0);
+  #endif
+  command_batch_open = false;
+  interrupts();
 }
 
 void resetSystem() {
   pitch_shifter.Init(DAISY.AudioSampleRate());
-  delay_effect.Reset();
+  crearttech::LooperCommand cmd = {crearttech::LooperCommandType::DELAY_RESET, 0.0f, 0.0f};
+  sendCommand(cmd);
   g_current_pitch_ratio = 1.0f;
-  g_highpass_filter->SetFreq(10.0f);
-  g_lowpass_filter->SetFreq(20000.0f);
   knob2_reverb_val = 0; knob2_size_val = 0; knob2_decay_val = 0;
   reverb_effect->SetFeedback(0.0f); reverb_effect->SetLpFreq(20000.0f);
   knob3_time_val = 0; knob3_feedback_val = 0; knob3_mix_val = 0;
   delay_time_samples = 0; delay_feedback = 0.0f; delay_mix = 0.0f;
+  for (size_t b = 0; b < crearttech::EQ_BANDS; b++) eq_knob_val[b] = crearttech::EQ_KNOB_FLAT;
+  cancelRenders();  // El bounce lee las pistas que se borran
+  clearAutomation();
   noInterrupts(); enc1_counter = 0; enc2_counter = 0; enc3_counter = 0; last_e1 = 0; interrupts();
   enc1_mode = PITCH; knob2_mode = REVERB; knob3_mode = TIME;
   waveform_display_needs_update = true;
 }
 
+#ifdef DENORMAL_BENCHMARK
+// Cola de un impulso por EQ, delay y reverb: compara los ciclos por bloque al
+// inicio y al final de la cola, con flush-to-zero desactivado y activado.
+// LoopEffects no guarda estado entre bloques, así que no puede acumular subnormales.
+const float DENORMAL_TAIL_SECONDS = 20.0f;
+
+void runDenormalBenchmark(float sample_rate) {
+  const size_t blocks = (size_t)(DENORMAL_TAIL_SECONDS * sample_rate / AUDIO_BLOCK_SAMPLES);
+  const size_t window = blocks / 10;
+  for (int pass = 0; pass < 2; pass++) {
+    crearttech::ScopedFlushToZero ftz(pass == 1);
+    delay_effect.Reset(); delay_effect.SetDelay((float)AUDIO_BLOCK_SAMPLES);
+    reverb_effect->Init(sample_rate); reverb_effect->SetFeedback(0.7f);
+    for (size_t band = 0; band < crearttech::EQ_BANDS; band++) live_eq.SetBand((crearttech::EqBand)band, 100);
+    live_eq.Reset();
+
+    uint32_t head_cycles = 0, tail_cycles = 0, subnormals = 0;
+    float x[AUDIO_BLOCK_SAMPLES];
+    for (size_t b = 0; b < blocks; b++) {
+      uint32_t start = crearttech::CycleCounter::Now();
+      memset(x, 0, sizeof(x));
+      if (b == 0) x[0] = 1.0f;
+      live_eq.Process(x, AUDIO_BLOCK_SAMPLES);
+      for (size_t i = 0; i < AUDIO_BLOCK_SAMPLES; i++) {
+        float filtered = x[i];
+        float delayed = delay_effect.Read();
+        delay_effect.Write(filtered + delayed * 0.7f);
+        float l, r;
+        reverb_effect->Process(delayed, delayed, &l, &r);
+        if (fpclassify(l) == FP_SUBNORMAL || fpclassify(delayed) == FP_SUBNORMAL) subnormals++;
+      }
+      uint32_t cycles = crearttech::CycleCounter::Now() - start;
+      if (b < window) head_cycles += cycles;
+      else if (b >= blocks - window) tail_cycles += cycles;
+    }
+    Serial.print(pass == 1 ? "FTZ on : " : "FTZ off: ");
+    Serial.print("head "); Serial.print(head_cycles / window);
+    Serial.print(" cyc/blk, tail "); Serial.print(tail_cycles / window);
+    Serial.print(" cyc/blk, subnormals "); Serial.println(subnormals);
+  }
+
+  // Dejar los efectos como los deja setup()
+  delay_effect.Reset(); delay_effect.SetDelay(2400.0f);
+  reverb_effect->Init(sample_rate);
+  live_eq.Init(&eq_table);
+}
+#endif
+
+#ifdef ENGINE_STRESS_TEST
+// Comandos al azar contra el looper sobre los búferes reales de la SDRAM, antes de
+// arrancar el audio. Se detiene en el primer invariante roto e informa la semilla y
+// el bloque para repetirlo; al final informa el peor bloque contra el presupuesto.
+#ifndef ENGINE_STRESS_SEED
+#define ENGINE_STRESS_SEED 1
+#endif
+const uint32_t ENGINE_STRESS_BLOCKS = 10000000;  // ~2.8 h de audio
+const uint32_t ENGINE_STRESS_COMMAND_ONE_IN = 8; // Un comando cada 8 bloques en promedio
+const uint32_t ENGINE_STRESS_GUARD_PERIOD = 1000;
+const uint32_t ENGINE_STRESS_REPORT_PERIOD = 1000000;
+
+void printStressStats(const crearttech::StressStats& stats, float budget_cycles) {
+  Serial.print("stress: bloques "); Serial.print(stats.blocks);
+  Serial.print(", peor "); Serial.print(stats.worst_ticks);
+  Serial.print(" cyc (bloque "); Serial.print(stats.worst_block);
+  Serial.print(", "); Serial.print(100.0f * stats.worst_ticks / budget_cycles, 2);
+  Serial.print("% del presupuesto), promedio ");
+  Serial.print(stats.blocks > 0 ? (uint32_t)(stats.total_ticks / stats.blocks) : 0);
+  Serial.print(" cyc, excedidos "); Serial.println(stats.over_budget_blocks);
+}
+
+void runEngineStressTest(float sample_rate) {
+  static crearttech::EngineStress stress;
+  float* const buffers[2] = {loop_buffer_a, loop_buffer_b};
+  stress.Init(&looper, buffers, undo_buffers, 3, kBufferLengthSamples, take_chunk_stats, take_silent_bits,
+              kChunkStatsCount, sample_rate, ENGINE_STRESS_SEED, crearttech::CycleCounter::Now);
+  const float budget_cycles = kCpuHz * AUDIO_BLOCK_SAMPLES / sample_rate;
+  stress.SetTickBudget((uint32_t)budget_cycles);
+  float in[AUDIO_BLOCK_SAMPLES], out[AUDIO_BLOCK_SAMPLES];
+
+  Serial.print("stress: semilla "); Serial.println((uint32_t)ENGINE_STRESS_SEED);
+  for (uint32_t b = 1; b <= ENGINE_STRESS_BLOCKS; b++) {
+    bool ok = stress.RunBlock(in, out, AUDIO_BLOCK_SAMPLES, ENGINE_STRESS_COMMAND_ONE_IN);
+    if (b % ENGINE_STRESS_GUARD_PERIOD == 0 && !stress.CheckGuards()) ok = false;
+    if (!ok) break;
+    if (b % ENGINE_STRESS_REPORT_PERIOD == 0) printStressStats(stress.GetStats(), budget_cycles);
+  }
+  stress.CheckGuards();
+
+  const crearttech::StressStats& stats = stress.GetStats();
+  printStressStats(stats, budget_cycles);
+  if (stats.Failures() > 0) {
+    Serial.print("stress: FALLO en el bloque "); Serial.print(stats.first_failure_block);
+    Serial.print(" (no finito "); Serial.print(stats.non_finite_blocks);
+    Serial.print(", cabezal "); Serial.print(stats.playhead_errors);
+    Serial.print(", grabacion "); Serial.print(stats.record_head_errors);
+    Serial.print(", guardas "); Serial.print(stats.guard_errors); Serial.println(")");
+  } else {
+    Serial.println("stress: OK");
+  }
+
+  // Dejar el looper y los búferes como los deja setup()
+  memset(loop_buffer_b, 0, sizeof(loop_buffer_b));
+  looper.Init(buffer, kBufferLengthSamples, undo_buffers, 3);
+  looper.AttachChunkStats(take_chunk_stats, take_silent_bits, kChunkStatsCount);
+}
+#endif
+
+#ifdef WCET_PROFILE
+// Peor caso por camino del audio callback: cada estado y combinación de motor, efectos y
+// freeze se corre con entrada adversa (ruido a plena escala y colas que decaen hasta los
+// subnormales sin flush-to-zero), varispeed al máximo y la caché de datos desalojada
+// antes de cada bloque. Imprime una tabla CSV
+// (líneas "wcet,") para comparar versiones con tools/wcet_compare.py. Los bloques que
+// exceden el presupuesto quedan también en el registro de xruns.
+const uint32_t WCET_WARMUP_BLOCKS = 200;   // Granos, freeze y colas de efectos en régimen
+const uint32_t WCET_MEASURE_BLOCKS = 2000;
+const size_t WCET_EVICT_FLOATS = 64 * 1024 / sizeof(float);  // 4x la caché de datos del M7
+const size_t WCET_CACHE_LINE_FLOATS = 32 / sizeof(float);
+
+enum WcetEngine { WCET_LOOP, WCET_VARISPEED, WCET_GRANULAR, WCET_ENGINE_COUNT };
+enum WcetInput { WCET_NOISE, WCET_DENORMAL, WCET_INPUT_COUNT };
+enum WcetEffects { WCET_FX_EQ = 1 << 0, WCET_FX_DELAY = 1 << 1, WCET_FX_REVERB = 1 << 2 };
+
+const char* const kWcetStateNames[] = {"STOPPED", "RECORDING", "PLAYING", "OVERDUB", "PAUSED", "ARMED"};
+const char* const kWcetEngineNames[] = {"loop", "varispeed", "granular"};
+const char* const kWcetInputNames[] = {"noise", "denormal"};
+const uint8_t kWcetEffectSets[] = {0, WCET_FX_EQ, WCET_FX_DELAY, WCET_FX_REVERB,
+                                   WCET_FX_EQ | WCET_FX_DELAY | WCET_FX_REVERB};
+
+static crearttech::StressRandom wcet_random(1);
+
+// Ruido a plena escala. En WCET_DENORMAL solo hasta el fin del calentamiento y después
+// ceros: durante la medición las colas del EQ, delay, reverb y de la dinámica decaen hasta
+// los subnormales con las etapas todavía activas (una toma entera de subnormales se marca
+// en silencio y los efectos quedan apagados, que es el camino más barato).
+void generateWcetInput(WcetInput input, float* block, size_t size, float level, uint32_t block_index) {
+  if (input == WCET_DENORMAL && block_index >= WCET_WARMUP_BLOCKS) {
+    memset(block, 0, sizeof(float) * size);
+    return;
+  }
+  for (size_t i = 0; i < size; i++) block[i] = level * wcet_random.Uniform(-1.0f, 1.0f);
+}
+
+// Recorre un bloque de SDRAM más grande que la caché: el bloque siguiente arranca en frío
+void evictDataCache() {
+  volatile float sink = 0.0f;
+  for (size_t i = 0; i < WCET_EVICT_FLOATS; i += WCET_CACHE_LINE_FLOATS) sink = sink + waveform_source_buffer[i];
+}
+
+// Toma del largo completo del búfer con la entrada dada (estadísticas de silencio incluidas).
+// En WCET_DENORMAL el ruido ocupa el inicio, lo que el cabezal lee durante el calentamiento.
+void prepareWcetTake(WcetInput input) {
+  float block[AUDIO_BLOCK_SAMPLES], discard[AUDIO_BLOCK_SAMPLES];
+  looper.Init(buffer, kBufferLengthSamples, undo_buffers, 3);
+  looper.AttachChunkStats(take_chunk_stats, take_silent_bits, kChunkStatsCount);
+  looper.StartRecording();
+  for (uint32_t b = 0; looper.IsRecording(); b++) {
+    generateWcetInput(input, block, AUDIO_BLOCK_SAMPLES, 1.0f, b);
+    looper.ProcessBlock(block, discard, AUDIO_BLOCK_SAMPLES);
+  }
+  looper.SetLoopRegion(0, kBufferLengthSamples - 1);
+  granular.Init(DAISY.AudioSampleRate());  // Presupuesto de granos al máximo
+  granular.SetSource(buffer, kBufferLengthSamples, 0, kBufferLengthSamples);
+}
+
+void configureWcetCase(LooperState state, WcetEngine engine, uint8_t fx, bool freeze) {
+  const float max_ratio = powf(2.0f, 6.0f / 12.0f);  // Tope del encoder de pitch
+  looper_state = state;
+  granular_mode = granular_playing = (engine == WCET_GRANULAR);
+  looper.SetReverse(engine == WCET_VARISPEED);
+  looper.SetPlaybackSpeed(engine == WCET_VARISPEED ? max_ratio : 1.0f);
+  looper.SetPlaybackMode(engine == WCET_VARISPEED ? crearttech::PLAYBACK_PINGPONG : crearttech::PLAYBACK_LOOP);
+  granular.SetGrainSize(500.0f); granular.SetDensity(200.0f); granular.SetSpray(1.0f); granular.SetPitch(max_ratio);
+
+  // Las tres bandas activas (el costo de la cascada no depende de la ganancia)
+  for (size_t b = 0; b < crearttech::EQ_BANDS; b++) eq_knob_val[b] = (fx & WCET_FX_EQ) ? 100 : crearttech::EQ_KNOB_FLAT;
+  delay_time_samples = (fx & WCET_FX_DELAY) ? DAISY.AudioSampleRate() / 10.0f : 0.0f;
+  delay_feedback = (fx & WCET_FX_DELAY) ? 0.70f : 0.0f;
+  delay_mix = (fx & WCET_FX_DELAY) ? 1.0f : 0.0f;
+  knob3_mix_val = (fx & WCET_FX_DELAY) ? 100 : 0;
+  knob2_reverb_val = (fx & WCET_FX_REVERB) ? 100 : 0;
+  knob2_size_val = 100; knob2_decay_val = 100;
+  setReverbParams(reverb_effect);
+  g_gain = 2.0f;
+  resetParamSmoothers();
+  transport_declick.Reset(1.0f); transport_pending = false;
+  effects_idle = false; effects_printed = false;
+  spectral_freeze.SetFrozen(freeze);
+
+  record_counter = 0;
+  if (state == ARMED) looper.ArmRecording(REC_THRESHOLD, (size_t)(REC_PREROLL_MS * 0.001f * DAISY.AudioSampleRate()));
+  else if (state == RECORDING) looper.StartRecording();
+  else if (state == OVERDUB) looper.StartOverdub();
+}
+
+void runWcetCase(LooperState state, WcetEngine engine, uint8_t fx, bool freeze, WcetInput input) {
+  // Las colas solo llegan a ser subnormales sin FZ (el caso de un FPSCR mal configurado)
+  crearttech::ScopedFlushToZero ftz(input != WCET_DENORMAL);
+  prepareWcetTake(input);
+  configureWcetCase(state, engine, fx, freeze);
+  xrun_interval_valid = false;  // La preparación no es un callback atrasado
+  // ARMED se mide esperando: la entrada queda justo debajo del umbral
+  float level = (state == ARMED) ? REC_THRESHOLD * 0.9f : 1.0f;
+  float in0[AUDIO_BLOCK_SAMPLES], in1[AUDIO_BLOCK_SAMPLES], out0[AUDIO_BLOCK_SAMPLES], out1[AUDIO_BLOCK_SAMPLES];
+  float* ins[2] = {in0, in1};
+  float* outs[2] = {out0, out1};
+  for (uint32_t b = 0; b < WCET_WARMUP_BLOCKS + WCET_MEASURE_BLOCKS; b++) {
+    if (b == WCET_WARMUP_BLOCKS) profiler.Reset();
+    generateWcetInput(input, in0, AUDIO_BLOCK_SAMPLES, level, b);
+    memcpy(in1, in0, sizeof(in0));
+    evictDataCache();
+    AudioCallback(ins, outs, AUDIO_BLOCK_SAMPLES);
+  }
+  if (state == OVERDUB) looper.StopOverdub();
+  spectral_freeze.Init(DAISY.AudioSampleRate());
+  ftz_missing_blocks = 0;  // Sin FZ a propósito
+
+  uint32_t callback = profiler.GetMaxCycles(crearttech::ProfileStage::CALLBACK);
+  Serial.print("wcet,"); Serial.print(kWcetStateNames[state]);
+  Serial.print(","); Serial.print(kWcetEngineNames[engine]);
+  // F: filtro (el EQ; se conserva la letra para comparar con tablas anteriores)
+  Serial.print(","); Serial.print(fx & WCET_FX_EQ ? "F" : "-"); Serial.print(fx & WCET_FX_DELAY ? "D" : "-");
+  Serial.print(fx & WCET_FX_REVERB ? "R" : "-");
+  Serial.print(","); Serial.print(freeze ? 1 : 0);
+  Serial.print(","); Serial.print(kWcetInputNames[input]);
+  Serial.print(","); Serial.print(callback);
+  for (size_t s = (size_t)crearttech::ProfileStage::LOOPER; s < (size_t)crearttech::ProfileStage::COUNT; s++) {
+    Serial.print(","); Serial.print(profiler.GetMaxCycles((crearttech::ProfileStage)s));
+  }
+  Serial.print(","); Serial.println(100.0f * callback / profiler.GetBudgetCycles(), 1);
+}
+
+void runWcetProfile() {
+  const float saved_delay_time = delay_time_samples, saved_delay_feedback = delay_feedback, saved_delay_mix = delay_mix;
+  const int saved_reverb = knob2_reverb_val, saved_size = knob2_size_val, saved_decay = knob2_decay_val;
+  const int saved_mix = knob3_mix_val;
+  int saved_eq[crearttech::EQ_BANDS];
+  for (size_t b = 0; b < crearttech::EQ_BANDS; b++) saved_eq[b] = eq_knob_val[b];
+  Serial.print("# wcet build "); Serial.print(__DATE__); Serial.print(" "); Serial.print(__TIME__);
+  Serial.print(", budget "); Serial.print((uint32_t)profiler.GetBudgetCycles()); Serial.println(" cyc/block");
+  Serial.println("wcet,state,engine,fx,freeze,input,callback,looper,granular,effects,spectral,dynamics,load_pct");
+  for (int input = 0; input < WCET_INPUT_COUNT; input++) {
+    const LooperState idle_states[] = {STOPPED, ARMED, RECORDING, OVERDUB};
+    for (LooperState state : idle_states) runWcetCase(state, WCET_LOOP, 0, false, (WcetInput)input);
+    for (int engine = 0; engine < WCET_ENGINE_COUNT; engine++) {
+      for (uint8_t fx : kWcetEffectSets) {
+        runWcetCase(PLAYING, (WcetEngine)engine, fx, false, (WcetInput)input);
+        runWcetCase(PLAYING, (WcetEngine)engine, fx, true, (WcetInput)input);
+      }
+    }
+  }
+
+  // Dejar el sampler como lo deja setup()
+  looper.Init(buffer, kBufferLengthSamples, undo_buffers, 3);
+  looper.AttachChunkStats(take_chunk_stats, take_silent_bits, kChunkStatsCount);
+  granular.Init(DAISY.AudioSampleRate());
+  looper_state = STOPPED; granular_mode = granular_playing = false; record_counter = 0;
+  effects_idle = false; g_gain = 1.0f;
+  delay_time_samples = saved_delay_time; delay_feedback = saved_delay_feedback; delay_mix = saved_delay_mix;
+  knob2_reverb_val = saved_reverb; knob2_size_val = saved_size; knob2_decay_val = saved_decay;
+  knob3_mix_val = saved_mix;
+  for (size_t b = 0; b < crearttech::EQ_BANDS; b++) eq_knob_val[b] = saved_eq[b];
+  resetParamSmoothers();
+  delay_effect.Reset(); delay_effect.SetDelay(2400.0f);
+  reverb_effect->Init(DAISY.AudioSampleRate());
+  profiler.Reset();
+  xrun_interval_valid = false;
+}
+#endif
+
+#ifdef CAPTURE_SESSION
+// Volcado binario: cabecera, eventos de loop(), eventos del audio callback y entrada
+void dumpSession() {
+  capture_stopped = true;
+  delay(2);  // El bloque en curso termina de escribir en los registros
+  crearttech::CaptureHeader header = {
+    crearttech::CAPTURE_MAGIC, crearttech::CAPTURE_VERSION, AUDIO_BLOCK_SAMPLES, kSampleRate,
+    (uint32_t)(input_log.Size() / AUDIO_BLOCK_SAMPLES), (uint32_t)ui_events.Size(),
+    (uint32_t)audio_events.Size(), (uint32_t)input_log.Size()
+  };
+  Serial.write((const uint8_t*)&header, sizeof(header));
+  Serial.write((const uint8_t*)ui_events.Data(), ui_events.Size() * sizeof(crearttech::CaptureEvent));
+  Serial.write((const uint8_t*)audio_events.Data(), audio_events.Size() * sizeof(crearttech::CaptureEvent));
+  Serial.write((const uint8_t*)input_log.Data(), input_log.Size() * sizeof(float));
+}
+
+bool readSerialBytes(void* destination, size_t length) {
+  return Serial.readBytes((char*)destination, length) == length;
+}
+
+// Espera REPLAY_WAIT_MS una sesión con el mismo formato del volcado
+bool receiveSession(uint32_t& blocks) {
+  unsigned long start = millis();
+  while (Serial.available() < (int)sizeof(crearttech::CaptureHeader)) {
+    if (millis() - start > REPLAY_WAIT_MS) return false;
+    delay(10);
+  }
+  crearttech::CaptureHeader header;
+  Serial.setTimeout(1000);
+  if (!readSerialBytes(&header, sizeof(header))) return false;
+  if (header.magic != crearttech::CAPTURE_MAGIC || header.version != crearttech::CAPTURE_VERSION ||
+      header.block_size != AUDIO_BLOCK_SAMPLES || header.sample_rate != kSampleRate ||
+      header.ui_events > ui_events.Capacity() || header.audio_events > audio_events.Capacity() ||
+      header.input_samples > input_log.Capacity()) {
+    Serial.println("replay: sesion incompatible");
+    return false;
+  }
+  if (!readSerialBytes(ui_events.Storage(), header.ui_events * sizeof(crearttech::CaptureEvent)) ||
+      !readSerialBytes(audio_events.Storage(), header.audio_events * sizeof(crearttech::CaptureEvent)) ||
+      !readSerialBytes(input_log.Storage(), header.input_samples * sizeof(float))) {
+    Serial.println("replay: sesion incompleta");
+    return false;
+  }
+  ui_events.SetSize(header.ui_events);
+  audio_events.SetSize(header.audio_events);
+  input_log.SetSize(header.input_samples);
+  blocks = header.blocks;
+  return true;
+}
+
+// Eventos de loop(): los controles se inyectan y la lectura corre en el mismo bloque
+void applyReplayUiEvent(const crearttech::CaptureEvent& e) {
+  switch (e.type) {
+    case crearttech::CaptureEventType::CONTROLS: control_levels = e.value; break;
+    case crearttech::CaptureEventType::ENCODER:
+      if (e.id == 1) enc1_counter = (int)e.value;
+      else if (e.id == 2) enc2_counter = (int)e.value;
+      else if (e.id == 3) enc3_counter = (int)e.value;
+      else enc4_counter = (int)e.value;
+      break;
+    case crearttech::CaptureEventType::SCRUB: memcpy(&replay_scrub_velocity, &e.value, sizeof(float)); break;
+    case crearttech::CaptureEventType::ACTION: replay_action_mask |= 1u << e.id; break;
+    case crearttech::CaptureEventType::SCAN: scanInputsTask(); replay_action_mask = 0; break;
+    case crearttech::CaptureEventType::RENDER_DONE: finishRender(); break;
+    case crearttech::CaptureEventType::TAKE_DONE: finishTake(); break;
+    case crearttech::CaptureEventType::OVERDUB_DONE: finishOverdub(); break;
+    default: break;
+  }
+}
+
+// Repite la sesión desde el estado de arranque, sin audio en marcha, y compara los
+// cambios de estado y el hash de la salida con los capturados. Los renders no corren
+// en segundo plano: se terminan en el bloque en que el original se activó.
+// Los eventos de audio de cada bloque se recorren dos veces (antes y después del
+// callback) con dos cursores, así no hay un máximo de eventos por bloque.
+void replaySession(uint32_t blocks) {
+  static float replay_out[2][AUDIO_BLOCK_SAMPLES];
+  float* out[2] = {replay_out[0], replay_out[1]};
+  crearttech::EventCursor ui_cursor(ui_events), audio_before(audio_events), audio_after(audio_events);
+  uint32_t checkpoints = 0;
+  session_replaying = true;
+
+  for (uint32_t b = 0; b < blocks; b++) {
+    session_block = b;
+    crearttech::CaptureEvent e;
+    while (ui_cursor.Next(b, e)) applyReplayUiEvent(e);
+
+    crearttech::CaptureEvent a;
+    while (audio_before.Next(b, a)) {
+      if (a.type == crearttech::CaptureEventType::JACK) {
+        speaker_muted = (a.value != 0);
+        if (a.id == 1) input_monitor_gain = speaker_muted ? 0.0f : 1.0f;  // Estado inicial
+      } else if (a.type == crearttech::CaptureEventType::SWAP) {
+        jobs.Finish(&undo_snapshot_job);
+        jobs.Finish(&bounce_job);
+        jobs.Finish(&resample_job);
+      }
+    }
+
+    float* in[2] = {capture_input + (size_t)b * AUDIO_BLOCK_SAMPLES, capture_input + (size_t)b * AUDIO_BLOCK_SAMPLES};
+    AudioCallback(in, out, AUDIO_BLOCK_SAMPLES);
+
+    bool diverged = false, commands_logged = false;
+    while (!diverged && audio_after.Next(b, a)) {
+      if (a.type == crearttech::CaptureEventType::GRAINS) {
+        granular.SetMaxActiveGrains(a.value);
+      } else if (a.type == crearttech::CaptureEventType::STATE) {
+        diverged = (a.value != (uint32_t)looper_state);
+      } else if (a.type == crearttech::CaptureEventType::COMMANDS) {
+        diverged = (a.value != block_command_hash);
+        commands_logged = true;
+      } else if (a.type == crearttech::CaptureEventType::CHECKSUM) {
+        diverged = (a.value != session_output_hash);
+        checkpoints++;
+      }
+    }
+    if (!diverged && !commands_logged && block_command_hash != 0) diverged = true;  // Comandos que el original aplicó en otro bloque
+    if (diverged) {
+      Serial.print("replay: divergencia en el bloque "); Serial.print(b);
+      Serial.print(", ultimo checkpoint igual: "); Serial.println(checkpoints > 0 ? (checkpoints - 1) * CHECKSUM_BLOCKS : 0);
+      session_replaying = false;
+      return;
+    }
+  }
+  session_replaying = false;
+  Serial.print("replay: "); Serial.print(blocks); Serial.print(" bloques, ");
+  Serial.print(checkpoints); Serial.println(" checkpoints identicos");
+}
+#endif
+
+#ifdef TRACE
+// Volcado binario de los tres anillos; los escritores siguen corriendo durante la copia
+void dumpTrace() {
+  static crearttech::TraceRecord DSY_SDRAM_BSS snapshot[16384];
+  crearttech::TraceDumpHeader header = {crearttech::TRACE_MAGIC, crearttech::TRACE_VERSION, 3, TRACE_POINT_COUNT};
+  Serial.write((const uint8_t*)&header, sizeof(header));
+  Serial.write((const uint8_t*)kTracePointNames, sizeof(kTracePointNames));
+
+  crearttech::TraceRingHeader ring = {"audio", (uint32_t)audio_trace.Snapshot(snapshot)};
+  Serial.write((const uint8_t*)&ring, sizeof(ring));
+  Serial.write((const uint8_t*)snapshot, ring.count * sizeof(crearttech::TraceRecord));
+  ring = {"ui", (uint32_t)ui_trace.Snapshot(snapshot)};
+  Serial.write((const uint8_t*)&ring, sizeof(ring));
+  Serial.write((const uint8_t*)snapshot, ring.count * sizeof(crearttech::TraceRecord));
+  ring = {"isr", (uint32_t)isr_trace.Snapshot(snapshot)};
+  Serial.write((const uint8_t*)&ring, sizeof(ring));
+  Serial.write((const uint8_t*)snapshot, ring.count * sizeof(crearttech::TraceRecord));
+}
+#endif
+
+#if defined(CAPTURE_SESSION) || defined(TRACE)
+// Comandos de un carácter por Serial: 'd' vuelca la sesión capturada, 't' las trazas
+void serialCommandTask() {
+  if (Serial.available() <= 0) return;
+  switch (Serial.read()) {
+    #ifdef CAPTURE_SESSION
+    case 'd': dumpSession(); break;
+    #endif
+    #ifdef TRACE
+    case 't': dumpTrace(); break;
+    #endif
+    default: break;
+  }
+}
+#endif
+
 void setup() {
   Serial.begin(115200);
   delay(250);
+  xrun_log.Attach();
+  #ifdef DEBUG
+  if (xrun_log.GetPreviousBootsTotal() > 0) {
+    Serial.print("xruns en arranques anteriores: "); Serial.println(xrun_log.GetPreviousBootsTotal());
+  }
+  #endif
+  #ifdef CAPTURE_SESSION
+  ui_events.Init(capture_ui_storage, kCaptureUiEvents);
+  audio_events.Init(capture_audio_storage, kCaptureAudioEvents);
+  input_log.Init(capture_input, kCaptureInputSamples);
+  #endif
 
   DAISY.init(DAISY_SEED, AUDIO_SR_48K);
   float sample_rate = DAISY.get_samplerate();
@@ -670,18 +2522,48 @@ void setup() {
   canvas = new GFXcanvas16(SCREEN_WIDTH, SCREEN_HEIGHT);
   
   looper.Init(buffer, kBufferLengthSamples, undo_buffers, 3);  // 3 niveles de undo/redo
+  looper.AttachChunkStats(take_chunk_stats, take_silent_bits, kChunkStatsCount);
+  granular.Init(DAISY.AudioSampleRate());
+  spectral_freeze.Init(DAISY.AudioSampleRate());
+  analyzer.Init(DAISY.AudioSampleRate());
+  input_meter.Init(DAISY.AudioSampleRate(), AUDIO_BLOCK_SAMPLES);
+  output_meter.Init(DAISY.AudioSampleRate(), AUDIO_BLOCK_SAMPLES);
+  output_loudness.Init(DAISY.AudioSampleRate());
+  automation.Init(automation_storage, AUTOMATION_LANE_EVENTS);
+  transport_declick.Init(DAISY.AudioSampleRate(), DECLICK_MS);
+  input_dynamics.Init(DAISY.AudioSampleRate(), INPUT_DYNAMICS);
+  const float block_rate = DAISY.AudioSampleRate() / AUDIO_BLOCK_SAMPLES;
+  for (size_t b = 0; b < crearttech::EQ_BANDS; b++) eq_smoothers[b].Init(PARAM_SMOOTHING_MS, block_rate);
+  delay_mix_smoother.Init(PARAM_SMOOTHING_MS, block_rate);
+  reverb_mix_smoother.Init(PARAM_SMOOTHING_MS, block_rate);
+  gain_smoother.Init(PARAM_SMOOTHING_MS, block_rate);
+  resetParamSmoothers();
+  crearttech::CycleCounter::Enable();
+  profiler.Init(kCpuHz, DAISY.AudioSampleRate(), AUDIO_BLOCK_SAMPLES);
   pitch_shifter.Init(DAISY.AudioSampleRate());
   pitch_shifter.SetFun(1.0f);
-  g_highpass_filter = new daisysp::Svf();
-  g_highpass_filter->Init(DAISY.AudioSampleRate());
-  g_highpass_filter->SetRes(0.7f); g_highpass_filter->SetDrive(0.7f); g_highpass_filter->SetFreq(10.0f);
-  g_lowpass_filter = new daisysp::Svf();
-  g_lowpass_filter->Init(DAISY.AudioSampleRate());
-  g_lowpass_filter->SetRes(0.7f); g_lowpass_filter->SetDrive(0.7f); g_lowpass_filter->SetFreq(20000.0f);
+  eq_table.Init(DAISY.AudioSampleRate());
+  live_eq.Init(&eq_table);
+  bounce_eq.Init(&eq_table);
   delay_effect.Init();
   delay_effect.SetDelay(2400.0f);
   reverb_effect = new (reverb_memory) daisysp::ReverbSc();
   reverb_effect->Init(DAISY.AudioSampleRate());
+  live_fx.eq = &live_eq;
+  live_fx.delay = &delay_effect; live_fx.reverb = reverb_effect;
+  bounce_fx.eq = &bounce_eq;
+  bounce_fx.delay = new (bounce_delay_memory) daisysp::DelayLine<float, 4800>();
+  bounce_fx.delay->Init();
+  bounce_fx.reverb = new (bounce_reverb_memory) daisysp::ReverbSc();
+
+  // Las colas de delay/reverb/EQ no deben caer en subnormales (también dentro del callback)
+  crearttech::FloatingPointMode::EnableFlushToZero();
+  #ifdef DENORMAL_BENCHMARK
+  runDenormalBenchmark(DAISY.AudioSampleRate());
+  #endif
+  #ifdef ENGINE_STRESS_TEST
+  runEngineStressTest(DAISY.AudioSampleRate());
+  #endif
 
   for (int i = 0; i < MAX_STARS; i++) {
     stars[i].x = random(-SCREEN_WIDTH / 2, SCREEN_WIDTH / 2);
@@ -698,16 +2580,35 @@ void setup() {
   pinMode(REV_BUTTON_PIN, INPUT_PULLUP);
   pinMode(RESET_BUTTON_PIN, INPUT_PULLUP);
   pinMode(JACK_DETECT_PIN, INPUT_PULLUP);
+  speaker_muted = (digitalRead(JACK_DETECT_PIN) != LOW);
+  input_monitor_gain = speaker_muted ? 0.0f : 1.0f;
+  #ifdef CAPTURE_SESSION
+  logAudioEvent(crearttech::CaptureEventType::JACK, 1, speaker_muted ? 1u : 0u);  // Antes del primer bloque
+  #endif
 
   pinMode(ENC1_CLK_PIN, INPUT_PULLUP); pinMode(ENC1_DT_PIN, INPUT_PULLUP); pinMode(ENC1_SW_PIN, INPUT_PULLUP);
   pinMode(ENC2_CLK_PIN, INPUT_PULLUP); pinMode(ENC2_DT_PIN, INPUT_PULLUP); pinMode(ENC2_SW_PIN, INPUT_PULLUP);
   pinMode(ENC3_CLK_PIN, INPUT_PULLUP); pinMode(ENC3_DT_PIN, INPUT_PULLUP); pinMode(ENC3_SW_PIN, INPUT_PULLUP);
   pinMode(ENC4_CLK_PIN, INPUT_PULLUP); pinMode(ENC4_DT_PIN, INPUT_PULLUP); pinMode(ENC4_SW_PIN, INPUT_PULLUP);
 
+  #ifdef CAPTURE_SESSION
+  // Con una sesión por Serial el equipo la repite en lugar de arrancar (antes de las ISR)
+  uint32_t replay_blocks = 0;
+  if (receiveSession(replay_blocks)) {
+    replaySession(replay_blocks);
+    Serial.println("replay: terminado, reiniciar para tocar");
+    while (true) delay(1000);
+  }
+  #endif
+  #ifdef WCET_PROFILE
+  runWcetProfile();  // Con todo inicializado y antes de las ISR
+  #endif
+
   attachInterrupt(digitalPinToInterrupt(ENC1_CLK_PIN), encoder1_isr, CHANGE);
   attachInterrupt(digitalPinToInterrupt(ENC2_CLK_PIN), encoder2_isr, CHANGE);
   attachInterrupt(digitalPinToInterrupt(ENC3_CLK_PIN), encoder3_isr, CHANGE);
   attachInterrupt(digitalPinToInterrupt(ENC4_CLK_PIN), encoder4_isr, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(JACK_DETECT_PIN), jack_isr, CHANGE);
 
   pinMode(record_led_pin, OUTPUT); digitalWrite(record_led_pin, LOW);
 
@@ -727,37 +2628,142 @@ void setup() {
     tft.drawRGBBitmap(0, 0, canvas->getBuffer(), SCREEN_WIDTH, SCREEN_HEIGHT);
     delay(30);
   }
+
+  tasks.Init(taskClock);
+  input_task = tasks.Add(scanInputsTask, INPUT_PERIOD_US, INPUT_BUDGET_US);
+  draw_task = tasks.Add(drawTask, DRAW_PERIOD_MIN_US, DRAW_BUDGET_US);
+  #ifdef DEBUG
+  report_task = tasks.Add(reportTask, REPORT_PERIOD_US, REPORT_BUDGET_US);
+  #endif
+  #ifdef TELEMETRY
+  telemetry_task = tasks.Add(telemetryTask, TELEMETRY_PERIOD_US, TELEMETRY_BUDGET_US);
+  #endif
+  #if defined(CAPTURE_SESSION) || defined(TRACE)
+  serial_task = tasks.Add(serialCommandTask, SERIAL_PERIOD_US, SERIAL_BUDGET_US);
+  #endif
+
   DAISY.StartAudio(AudioCallback);
 }
 
 void loop() {
+  tasks.RunReady();
+
+  static uint32_t handled_buffer_swaps = 0;
+  if (buffer_swaps != handled_buffer_swaps) {
+    handled_buffer_swaps = buffer_swaps;
+    command_batch_open = true;
+    finishRender();
+    closeCommandBatch(crearttech::CaptureEventType::RENDER_DONE);
+  }
+  if (takes_finished != handled_takes) {
+    handled_takes = takes_finished;
+    command_batch_open = true;
+    finishTake();
+    closeCommandBatch(crearttech::CaptureEventType::TAKE_DONE);
+  }
+  if (overdubs_finished != handled_overdubs) {
+    handled_overdubs = overdubs_finished;
+    finishOverdub();
+    #ifdef CAPTURE_SESSION
+    logUiEvent(crearttech::CaptureEventType::OVERDUB_DONE, 0, 0);
+    #endif
+  }
 
-  static unsigned long last_jack_check = 0;
-  if (millis() - last_jack_check > 200) {
-    last_jack_check = millis();
-
-    if (digitalRead(JACK_DETECT_PIN) != LOW) {
-      speaker_muted = true;
-    } else {
-      speaker_muted = false;
-    }
+  // La forma de onda se recalcula en segundo plano; si llegan datos nuevos mientras
+  // corre, se vuelve a lanzar al terminar
+  if (waveform_display_needs_update && !jobs.IsPending(&waveform_job)) {
+    waveform_display_needs_update = false;
+    noInterrupts(); size_t current_recorded_samples = record_counter; interrupts();
+    if (current_recorded_samples > 0) {
+      waveform_job.Restart(current_recorded_samples);
+      jobs.Submit(&waveform_job, crearttech::JobPriority::DISPLAY_UPDATE);
+    } else waveform_ready = false;
   }
+
+  // Trabajos en segundo plano hasta la próxima liberación (siempre al menos una porción)
+  uint32_t idle_us = tasks.TimeUntilNextRelease();
+  if (idle_us > JOB_BUDGET_US) idle_us = JOB_BUDGET_US;
+  #ifdef TRACE
+  bool jobs_busy = jobs.IsBusy();
+  if (jobs_busy) TRACE_BEGIN(ui_trace, TRACE_JOBS);
+  #endif
+  jobs.Run(idle_us * (uint32_t)(kCpuHz / 1e6f));
+  #ifdef TRACE
+  if (jobs_busy) TRACE_END(ui_trace, TRACE_JOBS);
+  #endif
+}
+
+// Encoders y botones; corre cada INPUT_PERIOD_US
+void scanInputsTask() {
+  TRACE_BEGIN(ui_trace, TRACE_INPUT_TASK);
+  command_batch_open = true;
+  flushCommandBacklog();
+  if (automation_clear_pending) clearAutomation();
+  if (loop_region_pending) loop_region_pending = !sendCommand(loop_region);
   noInterrupts();
   int e1 = enc1_counter; int e2 = enc2_counter; int e3 = enc3_counter; int e4 = enc4_counter;
   interrupts();
+  #ifdef CAPTURE_SESSION
+  captureControls(e1, e2, e3, e4);
+  #endif
   int e1_delta = e1 - last_e1; last_e1 = e1;
   int e4_delta = e4 - last_e4; last_e4 = e4;
 
-  bool enc4_sw = digitalRead(ENC4_SW_PIN);
+  bool enc4_sw = readButton(ENC4_SW_PIN);
   if (last_enc4_sw_state == HIGH && enc4_sw == LOW) {
-    if (enc4_mode == ENC4_MODE_GAIN) enc4_mode = ENC4_MODE_START_POINT;
+    if (granular_mode) {
+      if (enc4_mode == ENC4_MODE_GAIN) enc4_mode = ENC4_MODE_GRAIN_POSITION;
+      else if (enc4_mode == ENC4_MODE_GRAIN_POSITION) enc4_mode = ENC4_MODE_GRAIN_SPRAY;
+      else if (enc4_mode == ENC4_MODE_GRAIN_SPRAY) enc4_mode = ENC4_MODE_GRAIN_SIZE;
+      else if (enc4_mode == ENC4_MODE_GRAIN_SIZE) enc4_mode = ENC4_MODE_GRAIN_DENSITY;
+      else enc4_mode = ENC4_MODE_GAIN;
+    }
+    else if (enc4_mode == ENC4_MODE_GAIN) enc4_mode = ENC4_MODE_START_POINT;
     else if (enc4_mode == ENC4_MODE_START_POINT) enc4_mode = ENC4_MODE_END_POINT;
     else if (enc4_mode == ENC4_MODE_END_POINT) enc4_mode = ENC4_MODE_MOVE;
+    else if (enc4_mode == ENC4_MODE_MOVE) enc4_mode = (looper_state == OVERDUB) ? ENC4_MODE_GAIN : ENC4_MODE_SCRUB;  // Sin scrub al sobregrabar
     else enc4_mode = ENC4_MODE_GAIN;
     noInterrupts(); enc4_counter = 0; last_e4 = 0; interrupts();
+    e4_delta = 0;
+
+    crearttech::LooperCommand cmd = {crearttech::LooperCommandType::SCRUB_END, 0.0f, 0.0f};
+    if (enc4_mode == ENC4_MODE_SCRUB) {
+      cmd.type = crearttech::LooperCommandType::SCRUB_BEGIN;
+      scrub_offset = 0.0f; scrub_sent_velocity = 0.0f;
+    }
+    if (enc4_mode == ENC4_MODE_SCRUB || enc4_mode == ENC4_MODE_GAIN) sendCommand(cmd);
   }
   last_enc4_sw_state = enc4_sw;
 
+  // Scrub: la posición y la velocidad viajan al audio callback por la cola de comandos
+  if (enc4_mode == ENC4_MODE_SCRUB) {
+    noInterrupts(); unsigned long interval = enc4_interval_us; unsigned long last_pulse = last_isr_time_4; int dir = enc4_direction; interrupts();
+    float velocity = 0.0f;
+    if (interval > 0 && micros() - last_pulse < SCRUB_VELOCITY_TIMEOUT_US) {
+      // Pulsos/segundo * muestras/pulso / sample rate = muestras por muestra
+      velocity = (float)dir * SCRUB_SAMPLES_PER_DETENT * (1000000.0f / (float)interval) / (float)kSampleRate;
+    }
+    velocity = controlScrubVelocity(velocity);
+    if (e4_delta != 0 || velocity != scrub_sent_velocity) {
+      scrub_offset += (float)e4_delta * SCRUB_SAMPLES_PER_DETENT;
+      crearttech::LooperCommand cmd = {crearttech::LooperCommandType::SCRUB_TARGET, scrub_offset, velocity};
+      if (sendCommand(cmd)) scrub_sent_velocity = velocity;
+    }
+    e4_delta = 0;
+  }
+
+  // Parámetros granulares
+  if (e4_delta != 0 && granular_mode) {
+    switch (enc4_mode) {
+      case ENC4_MODE_GRAIN_POSITION: grain_position = constrain(grain_position + (float)e4_delta * 0.01f, 0.0f, 1.0f); markGrainParam(crearttech::GrainParam::POSITION); e4_delta = 0; break;
+      case ENC4_MODE_GRAIN_SPRAY: grain_spray = constrain(grain_spray + (float)e4_delta * 0.01f, 0.0f, 1.0f); markGrainParam(crearttech::GrainParam::SPRAY); e4_delta = 0; break;
+      case ENC4_MODE_GRAIN_SIZE: grain_size_ms = constrain(grain_size_ms + (float)e4_delta * 5.0f, 10.0f, 500.0f); markGrainParam(crearttech::GrainParam::SIZE); e4_delta = 0; break;
+      case ENC4_MODE_GRAIN_DENSITY: grain_density = constrain(grain_density + (float)e4_delta, 1.0f, 200.0f); markGrainParam(crearttech::GrainParam::DENSITY); e4_delta = 0; break;
+      default: break;
+    }
+  }
+  flushGrainParams();
+
   if (e4_delta != 0 && recorded_samples > 0) {
     int sensitivity = max(1, (int)(recorded_samples / 500));
     long delta = (long)e4_delta * sensitivity;
@@ -787,8 +2793,10 @@ void loop() {
       case ENC4_MODE_GAIN: {
         g_gain += (float)e4_delta * 0.01f; g_gain = constrain(g_gain, 0.0f, 2.0f); break;
       }
+      case ENC4_MODE_SCRUB: break; // Se maneja por la cola de comandos
+      default: break;              // Parámetros granulares (arriba)
     }
-    looper.SetLoopRegion(loop_start_sample, loop_end_sample);
+    setLoopRegion(loop_start_sample, loop_end_sample);
   }
 
   // ENC1
@@ -796,16 +2804,21 @@ void loop() {
     case PITCH: {
         int pitch_semitones = e1 / PITCH_SENSITIVITY;
         pitch_semitones = constrain(pitch_semitones, -6, 6);
-        g_current_pitch_ratio = powf(2.0f, (float)pitch_semitones / 12.0f);
-        looper.SetPlaybackSpeed(g_current_pitch_ratio);
-      } break;
-    case HIGHPASS: {
-        e1 = constrain(e1, 0, 100); noInterrupts(); enc1_counter = e1; interrupts();
-        g_highpass_filter->SetFreq(20.0f * powf(500.0f, (float)e1 / 100.0f));
+        // Solo al cambiar: tras un remuestreo el audio callback deja la velocidad en 1.0x
+        if (pitch_semitones != applied_pitch_semitones) {
+          applied_pitch_semitones = pitch_semitones;
+          g_current_pitch_ratio = powf(2.0f, (float)pitch_semitones / 12.0f);
+          crearttech::LooperCommand cmd = {crearttech::LooperCommandType::PLAYBACK_SPEED, g_current_pitch_ratio, 0.0f};
+          sendCommand(cmd);
+          markGrainParam(crearttech::GrainParam::PITCH);
+        }
       } break;
-    case LOWPASS: {
+    case EQ_LOW:
+    case EQ_MID:
+    case EQ_HIGH: {
+        // El audio callback suaviza (o automatiza) la banda y copia sus coeficientes
         e1 = constrain(e1, 0, 100); noInterrupts(); enc1_counter = e1; interrupts();
-        g_lowpass_filter->SetFreq(200.0f * powf(100.0f, (float)e1 / 100.0f));
+        eq_knob_val[enc1_mode - EQ_LOW] = e1;
       } break;
   }
 
@@ -813,18 +2826,34 @@ void loop() {
   e2 = constrain(e2, 0, 100); e3 = constrain(e3, 0, 100);
   noInterrupts(); enc2_counter = e2; enc3_counter = e3; interrupts();
 
-  bool enc2_sw = digitalRead(ENC2_SW_PIN);
+  bool enc2_sw = readButton(ENC2_SW_PIN);
   if (last_enc2_sw_state == HIGH && enc2_sw == LOW) {
     if (knob2_mode == REVERB) { knob2_mode = SIZE; enc2_counter = knob2_size_val; }
     else if (knob2_mode == SIZE) { knob2_mode = DECAY; enc2_counter = knob2_decay_val; }
     else { knob2_mode = REVERB; enc2_counter = knob2_reverb_val; }
   }
   last_enc2_sw_state = enc2_sw;
-  reverb_effect->SetFeedback(((float)knob2_decay_val / 100.0f) * 0.70f);
-  reverb_effect->SetLpFreq(500.0f + ((float)knob2_size_val / 100.0f * 15000.0f));
-
-  bool fn_button = digitalRead(FN_BUTTON_PIN);
-  if (last_fn_button_state == HIGH && fn_button == LOW) loop_edit_mode = !loop_edit_mode;
+  setReverbParams(reverb_effect);
+
+  // FN: pulsación corta cambia de vista al soltar; larga arma (o cancela) la automatización
+  bool fn_button = readButton(FN_BUTTON_PIN);
+  if (last_fn_button_state == HIGH && fn_button == LOW) { fn_press_time = controlMillis(); fn_long_press_actioned = false; }
+  if (fn_button == LOW && !fn_long_press_actioned && timedAction(ACTION_FN_LONG, controlMillis() - fn_press_time > LONG_PRESS_TIME_MS)) {
+    fn_long_press_actioned = true;
+    bool arm = (automation_status != AUTOMATION_ARMED && automation_status != AUTOMATION_RECORDING);
+    if (recorded_samples > 0 && !(arm && bounceInProgress())) {
+      crearttech::LooperCommand cmd = {crearttech::LooperCommandType::AUTOMATION_ARM, arm ? 1.0f : 0.0f, 0.0f};
+      sendCommand(cmd);
+    }
+  }
+  if (last_fn_button_state == LOW && fn_button == HIGH && !fn_long_press_actioned) {
+    #ifdef DEBUG
+    display_view = (display_view == VIEW_WAVEFORM) ? VIEW_SPECTRUM : (display_view == VIEW_SPECTRUM) ? VIEW_XRUNS : VIEW_WAVEFORM;
+    #else
+    display_view = (display_view == VIEW_WAVEFORM) ? VIEW_SPECTRUM : VIEW_WAVEFORM;
+    #endif
+    display_view_changed = true;
+  }
   last_fn_button_state = fn_button;
 
   switch (knob2_mode) {
@@ -832,7 +2861,7 @@ void loop() {
     case SIZE: knob2_size_val = e2; break;
     case DECAY: knob2_decay_val = e2; break;
   }
-  bool enc3_sw = digitalRead(ENC3_SW_PIN);
+  bool enc3_sw = readButton(ENC3_SW_PIN);
   if (last_enc3_sw_state == HIGH && enc3_sw == LOW) {
     if (knob3_mode == TIME) { knob3_mode = DELAY; enc3_counter = knob3_feedback_val; }
     else if (knob3_mode == DELAY) { knob3_mode = MIX; enc3_counter = knob3_mix_val; }
@@ -845,104 +2874,265 @@ void loop() {
     case MIX: delay_mix = (float)e3 / 100.0f; knob3_mix_val = e3; break;
   }
 
-  noInterrupts(); size_t current_recorded_samples = record_counter; interrupts();
-  if (current_recorded_samples > 0) {
-    float max_abs_val = 1e-6f;
-    for (size_t i = 0; i < current_recorded_samples; i++) {
-        float a = fabsf(waveform_source_buffer[i]); if (a > max_abs_val) max_abs_val = a;
-    }
-    if (max_abs_val < 1e-6f) max_abs_val = 1e-6f;
-    waveform_scale = ((WAVEFORM_H / 2.0f) / max_abs_val) * 0.7f;
-    generarOndaVisual_AbletonStyle(displayWaveform, DISPLAY_W, waveform_source_buffer, current_recorded_samples);
-    waveform_ready = true;
-  } else waveform_ready = false;
-  waveform_display_needs_update = false;
-
-  bool rec_button = digitalRead(REC_BUTTON_PIN);
-  bool play_button = digitalRead(PLAY_BUTTON_PIN);
-  bool stop_button = digitalRead(STOP_BUTTON_PIN);
-  bool reset_button = digitalRead(RESET_BUTTON_PIN);
+  bool rec_button = readButton(REC_BUTTON_PIN);
+  bool play_button = readButton(PLAY_BUTTON_PIN);
+  bool stop_button = readButton(STOP_BUTTON_PIN);
+  bool reset_button = readButton(RESET_BUTTON_PIN);
 
   if (last_reset_button_state == HIGH && reset_button == LOW) {
-    unsigned long currentTime = millis();
+    unsigned long currentTime = controlMillis();
     if (currentTime - last_reset_press_time < DOUBLE_PRESS_TIME_MS) reset_press_count++; else reset_press_count = 1;
     last_reset_press_time = currentTime;
     if (reset_press_count == 2) {
       if (recorded_samples > 0) {
         loop_start_sample = 0; loop_end_sample = recorded_samples - 1;
-        looper.SetLoopRegion(loop_start_sample, loop_end_sample);
+        setLoopRegion(loop_start_sample, loop_end_sample);
       }
       reset_press_count = 0;
     }
   }
-  if (reset_press_count == 1 && (millis() - last_reset_press_time > DOUBLE_PRESS_TIME_MS)) {
+  if (reset_press_count == 1 && timedAction(ACTION_RESET_SINGLE, controlMillis() - last_reset_press_time > DOUBLE_PRESS_TIME_MS)) {
     resetSystem(); reset_press_count = 0;
   }
   last_reset_button_state = reset_button;
 
-  if (last_enc1_sw_state == HIGH && digitalRead(ENC1_SW_PIN) == LOW) {
-    if (enc1_mode == PITCH) enc1_mode = HIGHPASS; else if (enc1_mode == HIGHPASS) enc1_mode = LOWPASS; else enc1_mode = PITCH;
+  // ENC1: pulsación corta cambia de modo al soltar; larga imprime la afinación (remuestreo)
+  bool enc1_sw = readButton(ENC1_SW_PIN);
+  if (last_enc1_sw_state == HIGH && enc1_sw == LOW) { enc1_press_time = controlMillis(); enc1_long_press_actioned = false; }
+  if (enc1_sw == LOW && !enc1_long_press_actioned && timedAction(ACTION_ENC1_LONG, controlMillis() - enc1_press_time > LONG_PRESS_TIME_MS)) {
+    enc1_long_press_actioned = true;
+    startResample();
   }
-  last_enc1_sw_state = digitalRead(ENC1_SW_PIN);
+  if (last_enc1_sw_state == LOW && enc1_sw == HIGH && !enc1_long_press_actioned) {
+    // PITCH -> LOW -> MID -> HIGH -> PITCH; el contador retoma el valor del modo nuevo
+    enc1_mode = (enc1_mode == EQ_HIGH) ? PITCH : (Enc1Mode)(enc1_mode + 1);
+    noInterrupts();
+    if (enc1_mode == PITCH) enc1_counter = applied_pitch_semitones * PITCH_SENSITIVITY;
+    else enc1_counter = eq_knob_val[enc1_mode - EQ_LOW];
+    interrupts();
+  }
+  last_enc1_sw_state = enc1_sw;
 
   bool rec_button_is_pressed = (rec_button == LOW);
   bool rec_button_was_pressed = (last_rec_button_state == LOW);
   if (rec_button_is_pressed && !rec_button_was_pressed) {
     if (looper_state == STOPPED) {
-      memset(buffer, 0, sizeof(float) * kBufferLengthSamples);
-      looper.StartRecording(); looper_state = RECORDING;
-      recorded_samples = 0; record_counter = 0; has_undo_state = false; waveform_ready = false;
-    } else if (looper_state == PLAYING) {
-      looper.StartOverdub(); looper_state = OVERDUB;
+      // Se arma la grabación; el audio callback la inicia al cruzar el umbral.
+      // El búfer después de la toma se limpia en segundo plano al parar.
+      jobs.Cancel(&clear_job); jobs.Cancel(&undo_snapshot_job); jobs.Cancel(&waveform_job); jobs.Cancel(&waveform_copy_job); cancelRenders();
+      recorded_samples = 0; record_counter = 0; has_undo_state = false; waveform_ready = false; take_gain = 1.0f;
+      effects_printed = false; clearAutomation(); take_expected = true;
+      crearttech::LooperCommand cmd = {crearttech::LooperCommandType::RECORD_ARM, REC_PREROLL_MS * 0.001f * DAISY.AudioSampleRate(), 0.0f};
+      sendCommand(cmd);
+    } else if (looper_state == PLAYING && overdubs_finished == handled_overdubs) {
+      leaveScrubMode();                 // Mientras se hace scrub el looper no graba
+      jobs.Finish(&undo_snapshot_job);  // Normalmente ya está listo
+      cancelRenders();                  // El overdub cambia el audio que se estaba renderizando
+      // take_gain normaliza solo la toma original
+      crearttech::LooperCommand cmd = {crearttech::LooperCommandType::OVERDUB_START, 1.0f / take_gain, 0.0f};
+      sendCommand(cmd);
     }
   }
   if (!rec_button_is_pressed && rec_button_was_pressed) {
-    if (looper_state == RECORDING) {
-      looper.StopRecording(); recorded_samples = record_counter;
-      loop_start_sample = 0; loop_end_sample = recorded_samples > 0 ? recorded_samples - 1 : 0;
-      looper.SetLoopRegion(loop_start_sample, loop_end_sample);
-      looper_state = PLAYING;
-    } else if (looper_state == OVERDUB) {
-      looper.StopOverdub(); looper_state = PLAYING;
-    }
+    // Sin haber cruzado el umbral cancela la toma; el final de una toma o de un overdub
+    // vuelve a loop() por takes_finished y overdubs_finished
+    crearttech::LooperCommand cmd = {crearttech::LooperCommandType::RECORD_STOP, 0.0f, 0.0f};
+    sendCommand(cmd);
   }
   last_rec_button_state = rec_button;
 
   if (last_play_button_state == HIGH && play_button == LOW) {
-    play_button_press_time = millis(); play_button_long_press_actioned = false;
-    unsigned long currentTime = millis();
-    if (currentTime - lastPlayPressTime < DOUBLE_PRESS_TIME_MS) playPressCount++; else playPressCount = 1;
+    play_button_press_time = controlMillis(); play_button_long_press_actioned = false;
+    unsigned long currentTime = controlMillis();
+    // Con un doble toque pendiente se ignoran más toques hasta aplicarlo
+    if (playPressCount != 2) playPressCount = (currentTime - lastPlayPressTime < DOUBLE_PRESS_TIME_MS) ? playPressCount + 1 : 1;
     lastPlayPressTime = currentTime;
-    if (playPressCount == 2) {
-      looper.Restart(); if (looper_state == RECORDING) looper.StopRecording();
-      looper_state = STOPPED; recorded_samples = 0;
+  }
+  // Doble toque: con la cola llena queda pendiente y se reintenta en la próxima vuelta
+  // sin tocar nada; el reset solo se hace cuando el stop ya va hacia el audio callback
+  if (playPressCount == 2) {
+    if (requestTransport(STOPPED, true)) {  // Desde PLAYING baja la salida y después reinicia
+      recorded_samples = 0; take_expected = false;
       noInterrupts(); record_counter = 0; interrupts();
+      jobs.Cancel(&waveform_job); jobs.Cancel(&waveform_copy_job); jobs.Cancel(&undo_snapshot_job); cancelRenders();
+      effects_printed = false; clearAutomation();
       has_undo_state = false; waveform_ready = false; playPressCount = 0;
     }
   }
   if (play_button == LOW && !play_button_long_press_actioned) {
-    if (millis() - play_button_press_time > 500) { play_button_long_press_actioned = true; }
+    if (timedAction(ACTION_PLAY_LONG, controlMillis() - play_button_press_time > LONG_PRESS_TIME_MS)) {
+      play_button_long_press_actioned = true;
+      startBounce();  // PLAY largo: imprimir los efectos en el loop
+    }
   }
-  if (playPressCount == 1 && (millis() - lastPlayPressTime > DOUBLE_PRESS_TIME_MS)) {
+  if (playPressCount == 1 && timedAction(ACTION_PLAY_SINGLE, controlMillis() - lastPlayPressTime > DOUBLE_PRESS_TIME_MS)) {
+    // Con la cola llena el toque queda pendiente y se reintenta en la próxima vuelta
+    bool queued = true;
     if (!play_button_long_press_actioned) {
-      if (looper_state == PAUSED) looper_state = PLAYING;
-      else if (looper_state == PLAYING) looper_state = PAUSED;
+      if (looper_state == PAUSED) queued = requestTransport(PLAYING, false);
+      else if (looper_state == PLAYING && playback_mode == crearttech::PLAYBACK_ONESHOT) {
+        crearttech::LooperCommand cmd = {crearttech::LooperCommandType::RETRIGGER, 0.0f, 0.0f};
+        queued = sendCommand(cmd);
+      }
+      else if (looper_state == PLAYING) queued = requestTransport(PAUSED, false);
     }
-    playPressCount = 0;
+    if (queued) playPressCount = 0;
   }
   last_play_button_state = play_button;
 
   if (stop_button == LOW && last_stop_button_state == HIGH) {
-    reverse_mode = !reverse_mode; looper.SetReverse(reverse_mode);
+    crearttech::LooperCommand cmd = {crearttech::LooperCommandType::REVERSE, reverse_mode ? 0.0f : 1.0f, 0.0f};
+    if (sendCommand(cmd)) reverse_mode = !reverse_mode;
   }
   last_stop_button_state = stop_button;
 
-  bool current_rev_button_state = digitalRead(REV_BUTTON_PIN); last_rev_button_state = current_rev_button_state;
-  bool current_back_button_state = digitalRead(BACK_BUTTON_PIN); last_back_button_state = current_back_button_state;
+  bool current_rev_button_state = readButton(REV_BUTTON_PIN);
+  if (last_rev_button_state == HIGH && current_rev_button_state == LOW) {
+    crearttech::LooperCommand cmd = {crearttech::LooperCommandType::FREEZE, freeze_enabled ? 0.0f : 1.0f, 0.0f};
+    if (sendCommand(cmd)) freeze_enabled = !freeze_enabled;
+  }
+  last_rev_button_state = current_rev_button_state;
+  bool current_back_button_state = readButton(BACK_BUTTON_PIN);
+  if (last_back_button_state == HIGH && current_back_button_state == LOW) {
+    if (granular_mode) { granular_mode = false; playback_mode = crearttech::PLAYBACK_LOOP; }
+    else if (playback_mode == crearttech::PLAYBACK_LOOP) playback_mode = crearttech::PLAYBACK_PINGPONG;
+    else if (playback_mode == crearttech::PLAYBACK_PINGPONG) playback_mode = crearttech::PLAYBACK_ONESHOT;
+    else {
+      // Tras one-shot viene el modo granular; el looper sigue en loop para el overdub
+      playback_mode = crearttech::PLAYBACK_LOOP;
+      granular_mode = true;
+    }
+    crearttech::LooperCommand cmd = {crearttech::LooperCommandType::PLAYBACK_MODE, (float)playback_mode, granular_mode ? 1.0f : 0.0f};
+    sendCommand(cmd);
+
+    // Los modos del encoder 4 dependen del motor activo
+    leaveScrubMode();
+  }
+  last_back_button_state = current_back_button_state;
+  noInterrupts();  // El bloque en que se registra la lectura es el primero que ve sus comandos
+  #ifdef CAPTURE_SESSION
+  endControlScan();
+  #endif
+  command_batch_open = false;
+  interrupts();
+  TRACE_END(ui_trace, TRACE_INPUT_TASK);
+}
+
+#ifdef DEBUG
+void printTaskStats(const char* name, int id) {
+  const crearttech::TaskStats& s = tasks.GetStats(id);
+  Serial.print(name); Serial.print(" runs "); Serial.print(s.runs);
+  Serial.print(" jitter "); Serial.print(s.max_jitter_us);
+  Serial.print(" us, max "); Serial.print(s.max_duration_us);
+  Serial.print(" us, over budget "); Serial.print(s.budget_overruns);
+  Serial.print(", missed "); Serial.println(s.missed_periods);
+}
+
+void reportTask() {
+  Serial.print("CPU "); Serial.print(profiler.GetLoad() * 100.0f); Serial.print("% peak "); Serial.print(profiler.GetPeakLoad() * 100.0f);
+  Serial.print("% | grains "); Serial.print((int)granular.GetActiveGrains()); Serial.print("/"); Serial.print((int)granular.GetMaxActiveGrains());
+  Serial.print(" | cycles/grain-sample "); Serial.print(granular_cycles_per_grain_sample);
+  Serial.print(" | fx "); Serial.print(profiler.GetAverageCycles(crearttech::ProfileStage::EFFECTS));
+  Serial.print(" cyc, skipped "); Serial.print(silent_blocks_skipped); Serial.println(" blocks/s");
+  silent_blocks_skipped = 0;
+  if (ftz_missing_blocks > 0) { Serial.print("WARNING: FPSCR.FZ off in "); Serial.print(ftz_missing_blocks); Serial.println(" audio blocks"); ftz_missing_blocks = 0; }
+  if (xrun_log.GetTotal() > xrun_log.GetPreviousBootsTotal()) {
+    Serial.print("xruns "); Serial.print(xrun_log.GetTotal() - xrun_log.GetPreviousBootsTotal()); Serial.println(" (FN: vista XRUNS)");
+  }
+  if (jack_switch_latency_us > 0) { Serial.print("jack switch "); Serial.print(jack_switch_latency_us); Serial.println(" us"); jack_switch_latency_us = 0; }
+
+  printTaskStats("input ", input_task);
+  printTaskStats("draw  ", draw_task);
+  Serial.print("draw period "); Serial.print(tasks.GetPeriod(draw_task) / 1000);
+  Serial.print(" ms | worst button latency "); Serial.print(tasks.GetWorstCaseLatency(input_task)); Serial.println(" us");
+  tasks.ResetStats();
+}
+#endif
+
+#ifdef TELEMETRY
+// Telemetría binaria: cada ejecución envía lo que el puerto acepta sin esperar y encola
+// una trama de estado; el driver USB la transmite en segundo plano
+static crearttech::TelemetryStream<4096> telemetry;
+
+void telemetryTask() {
+  const uint8_t* pending;
+  size_t length = telemetry.Peek(pending);
+  int writable = Serial.availableForWrite();
+  if (length > 0 && writable > 0) {
+    if (length > (size_t)writable) length = (size_t)writable;
+    telemetry.Consume(Serial.write(pending, length));
+  }
+
+  static uint32_t sequence = 0;
+  crearttech::TelemetryStatus status;
+  static crearttech::MeterReading reading = {0.0f, 0.0f, 0.0f, 0.0f, crearttech::ShortTermLoudness::SILENCE_LUFS};
+  meter_snapshot.Read(reading);  // Si falla se envía la lectura anterior
+  status.time_ms = millis();
+  status.sequence = sequence++;
+  status.audio_overruns = profiler.GetOverruns();
+  status.dropped_frames = telemetry.GetDropped();
+  status.cpu_load = profiler.GetLoad();
+  status.cpu_peak_load = profiler.GetPeakLoad();
+  status.input_peak = reading.input_peak; status.input_rms = reading.input_rms;
+  status.output_peak = reading.output_peak; status.output_rms = reading.output_rms; status.output_lufs = reading.output_lufs;
+  status.loop_start = loop_start_sample; status.loop_end = loop_end_sample;
+  status.play_position = play_position_samples;
+  status.recorded_samples = recorded_samples;
+  status.take_bytes = recorded_samples * sizeof(float);
+  status.looper_state = (uint8_t)looper_state;
+  status.undo_levels = (uint8_t)looper.GetUndoDepth();
+  status.flags = (granular_mode ? crearttech::TELEMETRY_FLAG_GRANULAR : 0) | (freeze_enabled ? crearttech::TELEMETRY_FLAG_FREEZE : 0) |
+                 (reverse_mode ? crearttech::TELEMETRY_FLAG_REVERSE : 0) | (speaker_muted ? crearttech::TELEMETRY_FLAG_LINE_INPUT : 0);
+  status.active_grains = (uint8_t)granular.GetActiveGrains();
+  for (size_t i = 0; i < (size_t)crearttech::ProfileStage::COUNT; i++) {
+    status.stage_load[i] = profiler.GetAverageCycles((crearttech::ProfileStage)i) / profiler.GetBudgetCycles();
+  }
+  telemetry.PushFrame(crearttech::TelemetryFrameType::STATUS, &status, sizeof(status));
+
+  // Xruns nuevos; tras el arranque también los que quedaron del anterior
+  static uint32_t xruns_sent = 0;
+  if (xruns_sent < xrun_log.GetOldest()) xruns_sent = xrun_log.GetOldest();
+  while (xruns_sent < xrun_log.GetTotal()) {
+    crearttech::XrunRecord record;
+    if (xrun_log.Read(xruns_sent, record) &&
+        !telemetry.PushFrame(crearttech::TelemetryFrameType::XRUN, &record, sizeof(record))) break;
+    xruns_sent++;
+  }
+}
+#endif
+
+// Dibujo con periodo adaptativo: si la pantalla excede su presupuesto o el audio
+// va cargado se dibuja menos seguido, y se vuelve al ritmo normal de a poco
+void drawTask() {
+  TRACE_BEGIN(ui_trace, TRACE_DRAW_TASK);
+  uint32_t period = tasks.GetPeriod(draw_task);
+  if (tasks.GetStats(draw_task).last_duration_us > DRAW_BUDGET_US || profiler.GetLoad() > DRAW_BACKOFF_CPU_LOAD) {
+    period += period / 4;
+    if (period > DRAW_PERIOD_MAX_US) period = DRAW_PERIOD_MAX_US;
+  } else if (period > DRAW_PERIOD_MIN_US) {
+    period -= 1000;
+    if (period < DRAW_PERIOD_MIN_US) period = DRAW_PERIOD_MIN_US;
+  }
+  tasks.SetPeriod(draw_task, period);
 
-  static unsigned long last_draw = 0;
-  if (millis() - last_draw > 30) {
-    drawScreen(); tft.drawRGBBitmap(0, 0, canvas->getBuffer(), SCREEN_WIDTH, SCREEN_HEIGHT);
-    last_draw = millis();
+  static unsigned long last_full_draw = 0;
+  if (display_view == VIEW_SPECTRUM) {
+    if (analyzer_ring.ReadLatest(analyzer_input, crearttech::SpectrumAnalyzer<DISPLAY_W>::INPUT_SIZE)) {
+      analyzer.Process(analyzer_input);
+    }
+  }
+  // En la vista de espectro solo se reenvía el área de las barras; el resto cada 500 ms
+  if (display_view == VIEW_SPECTRUM && !display_view_changed && millis() - last_full_draw < 500) {
+    drawSpectrum();
+    drawMeters();
+    markDirty(WAVEFORM_X, WAVEFORM_Y, DISPLAY_W, METERS_Y + 2 * METER_H + 1 - WAVEFORM_Y);
+    markDirty(75, SCREEN_HEIGHT - 15, 30, 8);
+  } else {
+    drawScreen();
+    markDirty(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+    last_full_draw = millis();
+    display_view_changed = false;
   }
+  flushDirty();
+  TRACE_END(ui_trace, TRACE_DRAW_TASK);
 }
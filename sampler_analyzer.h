@@ -0,0 +1,163 @@
+/**
+ * =====================================================================
+ * sampler_analyzer.h - Spectrum Analyzer (UI side)
+ * =====================================================================
+ * El audio callback solo copia cada bloque de salida a un anillo lock-free;
+ * loop() toma las últimas muestras, las diezma, calcula la FFT y agrupa
+ * los bins en columnas logarítmicas con una tabla precalculada.
+ */
+
+#ifndef SAMPLER_ANALYZER_H
+#define SAMPLER_ANALYZER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <atomic>
+#include "sampler_fft.h"
+
+namespace crearttech {
+
+/**
+ * @brief Anillo de muestras: un escritor (audio) y un lector (UI) sin locks.
+ * @tparam N Capacidad en muestras (potencia de 2)
+ */
+template <size_t N>
+class SnapshotRing {
+  static_assert((N & (N - 1)) == 0, "SnapshotRing size must be a power of 2");
+
+public:
+  SnapshotRing() : _write_index(0) { memset(_data, 0, sizeof(_data)); }
+
+  /** @brief Copia un bloque al anillo (solo desde el audio callback). */
+  void Write(const float* samples, size_t count) {
+    uint32_t idx = _write_index.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < count; i++) {
+      _data[(idx + i) & (N - 1)] = samples[i];
+    }
+    _write_index.store(idx + static_cast<uint32_t>(count), std::memory_order_release);
+  }
+
+  /**
+   * @brief Copia las últimas `count` muestras en orden cronológico (desde la UI).
+   * @return false si el escritor sobrescribió datos durante la copia
+   */
+  bool ReadLatest(float* dest, size_t count) const {
+    if (count > N / 2) return false;
+    uint32_t end = _write_index.load(std::memory_order_acquire);
+    uint32_t start = end - static_cast<uint32_t>(count);
+    for (size_t i = 0; i < count; i++) {
+      dest[i] = _data[(start + i) & (N - 1)];
+    }
+    // Si el escritor avanzó más que el margen libre, la copia pudo mezclarse
+    uint32_t now = _write_index.load(std::memory_order_acquire);
+    return (now - end) <= (N - count);
+  }
+
+private:
+  float _data[N];
+  std::atomic<uint32_t> _write_index;
+};
+
+/**
+ * @brief Analizador de espectro con columnas logarítmicas.
+ * @tparam COLUMNS Número de columnas de la pantalla
+ */
+template <size_t COLUMNS>
+class SpectrumAnalyzer {
+public:
+  static const size_t DECIMATION = 2;
+  static const size_t FFT_SIZE = 512;
+  static const size_t INPUT_SIZE = FFT_SIZE * DECIMATION;
+  static const size_t NUM_BINS = FFT_SIZE / 2 + 1;
+
+  /**
+   * @brief Precalcula ventana y tabla bin -> columna.
+   * @param sample_rate Sample rate de la salida (antes de diezmar)
+   * @param min_hz Frecuencia de la primera columna
+   */
+  void Init(float sample_rate, float min_hz = 40.0f) {
+    _fft.Init();
+
+    for (size_t i = 0; i < FFT_SIZE; i++) {
+      float phase = static_cast<float>(i) / static_cast<float>(FFT_SIZE);
+      _window[i] = 0.5f - 0.5f * cosf(2.0f * static_cast<float>(M_PI) * phase);
+    }
+
+    // Columnas espaciadas logarítmicamente entre min_hz y Nyquist (tras diezmar)
+    const float decimated_rate = sample_rate / static_cast<float>(DECIMATION);
+    const float nyquist = decimated_rate * 0.5f;
+    const float hz_per_bin = decimated_rate / static_cast<float>(FFT_SIZE);
+    const float ratio = nyquist / min_hz;
+    for (size_t c = 0; c < COLUMNS; c++) {
+      float f_lo = min_hz * powf(ratio, static_cast<float>(c) / static_cast<float>(COLUMNS));
+      float f_hi = min_hz * powf(ratio, static_cast<float>(c + 1) / static_cast<float>(COLUMNS));
+      size_t first = static_cast<size_t>(f_lo / hz_per_bin);
+      size_t last = static_cast<size_t>(f_hi / hz_per_bin);
+      if (first < 1) first = 1;
+      if (last < first) last = first;
+      if (last >= NUM_BINS) last = NUM_BINS - 1;
+      if (first > last) first = last;
+      // En graves varias columnas comparten bin; en agudos una columna agrupa varios
+      _column_first_bin[c] = static_cast<uint16_t>(first);
+      _column_last_bin[c] = static_cast<uint16_t>(last);
+    }
+
+    for (size_t c = 0; c < COLUMNS; c++) _levels[c] = 0.0f;
+  }
+
+  /**
+   * @brief Analiza INPUT_SIZE muestras (llamar desde loop()).
+   * @param input Muestras en orden cronológico
+   */
+  void Process(const float* input) {
+    // Diezmado por promedio de pares (filtro anti-alias simple)
+    for (size_t i = 0; i < FFT_SIZE; i++) {
+      float sum = 0.0f;
+      for (size_t d = 0; d < DECIMATION; d++) sum += input[i * DECIMATION + d];
+      _time[i] = sum * (1.0f / static_cast<float>(DECIMATION)) * _window[i];
+    }
+
+    _fft.Forward(_time, _spectrum);
+    RealFFT<FFT_SIZE>::Magnitudes(_spectrum, _magnitude);
+
+    // Hann reduce la amplitud a la mitad; normalizar a 0 dBFS para un seno de pico 1
+    const float norm = 4.0f / static_cast<float>(FFT_SIZE);
+    for (size_t c = 0; c < COLUMNS; c++) {
+      float peak = 0.0f;
+      for (size_t b = _column_first_bin[c]; b <= _column_last_bin[c]; b++) {
+        if (_magnitude[b] > peak) peak = _magnitude[b];
+      }
+      float db = 20.0f * log10f(peak * norm + 1e-9f);
+      float level = (db - FLOOR_DB) / -FLOOR_DB;
+      if (level < 0.0f) level = 0.0f;
+      if (level > 1.0f) level = 1.0f;
+
+      // Subida inmediata, caída suave
+      if (level > _levels[c]) _levels[c] = level;
+      else _levels[c] -= FALL_PER_FRAME;
+      if (_levels[c] < 0.0f) _levels[c] = 0.0f;
+    }
+  }
+
+  /** @brief Nivel de la columna (0.0 = piso de -72 dB, 1.0 = 0 dBFS). */
+  float GetLevel(size_t column) const { return _levels[column]; }
+
+private:
+  static constexpr float FLOOR_DB = -72.0f;
+  static constexpr float FALL_PER_FRAME = 0.03f;
+
+  RealFFT<FFT_SIZE> _fft;
+  float _window[FFT_SIZE];
+  float _time[FFT_SIZE];
+  float _spectrum[FFT_SIZE];
+  float _magnitude[NUM_BINS];
+  uint16_t _column_first_bin[COLUMNS];
+  uint16_t _column_last_bin[COLUMNS];
+  float _levels[COLUMNS];
+};
+
+} // namespace crearttech
+
+#endif // SAMPLER_ANALYZER_H
@@ -0,0 +1,303 @@
+/**
+ * =====================================================================
+ * sampler_automation.h - Per-Cycle Parameter Automation
+ * =====================================================================
+ * Automatización de perillas atada a la posición dentro del ciclo del loop:
+ * - Una pista por parámetro con eventos ordenados por la posición del cabezal
+ *   en la región (muestras), así la repetición sigue al audio con varispeed,
+ *   ping-pong, reversa o scrub
+ * - Reproducción por búsqueda binaria una vez por bloque: el costo depende
+ *   del logaritmo de los eventos, no de las muestras
+ * - Grabación por contacto durante un ciclo armado hacia adelante: la pista
+ *   que se toca conserva lo anterior al contacto (incluido el valor previo
+ *   de la perilla) y desde ahí se reemplaza hasta el fin del ciclo; las
+ *   pistas que no se tocan siguen sonando
+ * Los valores pasan por ParamSmoother antes de llegar al audio, así la
+ * repetición no tiene escalones.
+ */
+
+#ifndef SAMPLER_AUTOMATION_H
+#define SAMPLER_AUTOMATION_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+namespace crearttech {
+
+/**
+ * @brief Lista de eventos de una pista ordenada por posición (un solo hilo la escribe y la lee).
+ * Cada evento ocupa 32 bits: posición en la región (24 bits) y valor de la perilla (8 bits).
+ */
+class AutomationLane {
+public:
+  static const uint32_t MAX_POSITION = (1u << 24) - 1;  // 349 s @ 48kHz
+
+  void Init(uint32_t* storage, size_t capacity) {
+    _events = storage;
+    _capacity = capacity;
+    Clear();
+  }
+
+  void Clear() {
+    _size = 0;
+    _overflow = false;
+  }
+
+  bool IsEmpty() const { return _size == 0; }
+  size_t Size() const { return _size; }
+  bool Overflowed() const { return _overflow; }
+
+  /**
+   * @brief Agrega un evento al final. Una posición igual a la del último evento lo
+   * reemplaza; una anterior se descarta.
+   * @return false si no hay lugar o la posición retrocede
+   */
+  bool Append(uint32_t position, uint8_t value) {
+    if (position > MAX_POSITION) position = MAX_POSITION;
+    if (_size > 0) {
+      uint32_t last = _events[_size - 1] >> 8;
+      if (position < last) return false;
+      if (position == last) {
+        _events[_size - 1] = (position << 8) | value;
+        return true;
+      }
+    }
+    if (_size >= _capacity) {
+      _overflow = true;
+      return false;
+    }
+    _events[_size++] = (position << 8) | value;
+    return true;
+  }
+
+  /**
+   * @brief Valor en una posición: el del último evento en o antes de ella (búsqueda
+   * binaria, en cualquier dirección de lectura). Antes del primer evento vale el primero.
+   * @return false si la pista está vacía
+   */
+  bool Lookup(uint32_t position, uint8_t& value) const {
+    if (_size == 0) return false;
+    size_t count = LowerBound(position + 1);  // Eventos con posición <= position
+    value = static_cast<uint8_t>(_events[(count > 0) ? count - 1 : 0] & 0xFF);
+    return true;
+  }
+
+  /**
+   * @brief Reemplaza el contenido por los eventos de source anteriores a position
+   * (lo que ya sonó del ciclo antes de tocar la perilla).
+   */
+  void CopyBefore(const AutomationLane& source, uint32_t position) {
+    Clear();
+    size_t count = source.LowerBound(position);
+    if (count > _capacity) {
+      count = _capacity;
+      _overflow = true;
+    }
+    for (size_t i = 0; i < count; i++) _events[i] = source._events[i];
+    _size = count;
+  }
+
+  /** @brief Intercambia el almacenamiento y el contenido con otra pista. */
+  void Swap(AutomationLane& other) {
+    AutomationLane tmp = *this;
+    *this = other;
+    other = tmp;
+  }
+
+private:
+  /** @brief Cantidad de eventos con posición menor que position. */
+  size_t LowerBound(uint32_t position) const {
+    size_t lo = 0, hi = _size;
+    while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      if ((_events[mid] >> 8) < position) lo = mid + 1;
+      else hi = mid;
+    }
+    return lo;
+  }
+
+  uint32_t* _events = nullptr;
+  size_t _capacity = 0;
+  size_t _size = 0;
+  bool _overflow = false;
+};
+
+/**
+ * @brief Pistas de automatización de un conjunto de perillas (solo desde el audio callback).
+ * @tparam LANES Número de pistas
+ */
+template <size_t LANES>
+class Automation {
+public:
+  /**
+   * @param storage 2 * LANES * events_per_lane eventos (pista activa y pista de grabación)
+   */
+  void Init(uint32_t* storage, size_t events_per_lane) {
+    for (size_t i = 0; i < LANES; i++) {
+      _lanes[i].Init(storage + (2 * i) * events_per_lane, events_per_lane);
+      _takes[i].Init(storage + (2 * i + 1) * events_per_lane, events_per_lane);
+    }
+    _primed = false;
+    Clear();
+  }
+
+  /** @brief Borra todas las pistas y cancela la grabación. */
+  void Clear() {
+    for (size_t i = 0; i < LANES; i++) _lanes[i].Clear();
+    _armed = false;
+    CancelTake();
+  }
+
+  /** @brief Arma (o cancela) la grabación para el próximo ciclo completo hacia adelante. */
+  void Arm(bool armed) {
+    _armed = armed;
+    if (!armed) CancelTake();
+  }
+
+  bool IsArmed() const { return _armed; }
+  bool IsRecording() const { return _recording; }
+
+  bool HasData() const {
+    for (size_t i = 0; i < LANES; i++) {
+      if (!_lanes[i].IsEmpty()) return true;
+    }
+    return false;
+  }
+
+  /**
+   * @brief Avanza un bloque.
+   * @param new_cycle true si el looper empezó un ciclo en este bloque
+   * @param position Posición del cabezal en la región (muestras)
+   * @param forward true si el cabezal avanza hacia adelante (sin reversa, sin el regreso
+   * del ping-pong y sin scrub); solo así se graba
+   * @param knobs Valores actuales de las perillas
+   * @param out Valores a aplicar (automatizados o los de la perilla)
+   */
+  void Process(bool new_cycle, uint32_t position, bool forward, const uint8_t* knobs, uint8_t* out) {
+    if (!_primed) {
+      for (size_t i = 0; i < LANES; i++) _last_knob[i] = _value[i] = knobs[i];
+      _primed = true;
+    }
+
+    if (new_cycle) {
+      if (_recording) {
+        // Las pistas tocadas pasan a sonar desde este ciclo
+        for (size_t i = 0; i < LANES; i++) {
+          if (_touched[i]) _lanes[i].Swap(_takes[i]);
+          _touched[i] = false;
+        }
+        _recording = false;
+      }
+      if (_armed && forward) {
+        _armed = false;
+        _recording = true;
+      }
+    }
+    // La toma es de un solo recorrido hacia adelante: un cambio de dirección la descarta
+    if (_recording && !forward) {
+      CancelTake();
+      _armed = true;
+    }
+
+    for (size_t i = 0; i < LANES; i++) {
+      bool moved = knobs[i] != _last_knob[i];
+      _last_knob[i] = knobs[i];
+
+      if (_recording && moved && !_touched[i]) {
+        // Lo que sonó antes del contacto: los eventos anteriores o, en una pista vacía,
+        // el valor que tenía la perilla desde el inicio del ciclo
+        _takes[i].CopyBefore(_lanes[i], position);
+        if (_takes[i].IsEmpty()) _takes[i].Append(0, _value[i]);
+        _touched[i] = true;
+      }
+
+      uint8_t value;
+      if (_touched[i]) {
+        if (moved) _takes[i].Append(position, knobs[i]);
+        _value[i] = knobs[i];
+      } else if (_lanes[i].Lookup(position, value)) {
+        _value[i] = value;
+      } else {
+        _value[i] = knobs[i];
+      }
+      out[i] = _value[i];
+    }
+  }
+
+  /**
+   * @brief Valores grabados en una posición, sin tocar el estado de reproducción
+   * (para renders fuera del audio callback mientras no se graba).
+   * @param knobs Valores de las pistas vacías
+   */
+  void Lookup(uint32_t position, const uint8_t* knobs, uint8_t* out) const {
+    for (size_t i = 0; i < LANES; i++) {
+      if (!_lanes[i].Lookup(position, out[i])) out[i] = knobs[i];
+    }
+  }
+
+private:
+  void CancelTake() {
+    for (size_t i = 0; i < LANES; i++) _touched[i] = false;
+    _recording = false;
+  }
+
+  AutomationLane _lanes[LANES];   // Pistas que suenan
+  AutomationLane _takes[LANES];   // Grabación del ciclo en curso
+  bool _touched[LANES] = {};
+  uint8_t _last_knob[LANES] = {};
+  uint8_t _value[LANES] = {};
+  bool _primed = false;
+  bool _armed = false;
+  bool _recording = false;
+};
+
+/**
+ * @brief Suavizado de un parámetro a ritmo de bloque: un polo hacia el objetivo
+ * y rampa lineal dentro del bloque, así los cambios no dejan escalones (zipper).
+ */
+class ParamSmoother {
+public:
+  /**
+   * @param time_ms Constante de tiempo
+   * @param block_rate Bloques por segundo
+   */
+  void Init(float time_ms, float block_rate) {
+    _coeff = 1.0f - expf(-1000.0f / (time_ms * block_rate));
+  }
+
+  /** @brief Salta al valor sin rampa. */
+  void Reset(float value) {
+    _current = value;
+    _target = value;
+  }
+
+  void SetTarget(float target) { _target = target; }
+
+  /**
+   * @brief Avanza un bloque.
+   * @param step Incremento por muestra para llegar al valor nuevo al final del bloque
+   * @return Valor al inicio del bloque
+   */
+  float Next(size_t size, float& step) {
+    float start = _current;
+    _current += _coeff * (_target - _current);
+    // Llegar exacto al objetivo: los valores neutros (0 o 1) desactivan etapas
+    if (fabsf(_target - _current) < SNAP) _current = _target;
+    step = (_current - start) / static_cast<float>(size);
+    return start;
+  }
+
+  float GetCurrent() const { return _current; }
+
+private:
+  static constexpr float SNAP = 1e-4f;
+
+  float _coeff = 1.0f;
+  float _current = 0.0f;
+  float _target = 0.0f;
+};
+
+} // namespace crearttech
+
+#endif // SAMPLER_AUTOMATION_H
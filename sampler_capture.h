@@ -0,0 +1,193 @@
+/**
+ * =====================================================================
+ * sampler_capture.h - Session Capture and Replay
+ * =====================================================================
+ * Registro compacto de una sesión para reproducir un fallo en el banco:
+ * - Eventos de control de tamaño fijo (12 bytes), sellados con el número
+ *   de bloque de audio en que se aplicaron
+ * - Un registro por contexto (loop() y audio callback): un solo productor
+ *   cada uno, sin locks
+ * - La entrada de audio bloque a bloque y un hash de la salida para
+ *   verificar que la repetición es idéntica
+ * La sesión es lineal desde el arranque: repetirla exige partir del mismo
+ * estado, así que al llenarse el registro la captura se detiene.
+ */
+
+#ifndef SAMPLER_CAPTURE_H
+#define SAMPLER_CAPTURE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+namespace crearttech {
+
+/**
+ * @brief Tipos de evento de una sesión.
+ */
+enum class CaptureEventType : uint8_t {
+  // Registro de loop()
+  CONTROLS,     // Niveles de los botones (máscara en value)
+  ENCODER,      // Contador de un encoder tras leerlo (id = 1..4)
+  SCRUB,        // Velocidad de scrub calculada (bits del float en value)
+  ACTION,       // Acción que dependía del tiempo (id), ej. pulsación larga
+  SCAN,         // Fin de una lectura de controles que registró eventos
+  RENDER_DONE,  // loop() atendió un intercambio de búfer
+  TAKE_DONE,    // loop() recortó una toma terminada
+  OVERDUB_DONE, // loop() atendió el fin de un overdub
+  // Registro del audio callback
+  STATE,        // Estado del looper al empezar el bloque (value)
+  JACK,         // Fuente de entrada (value != 0: línea)
+  SWAP,         // Se activó un render terminado
+  GRAINS,       // Presupuesto de granos ajustado por la carga (value = nuevo máximo)
+  COMMANDS,     // Hash de los comandos de loop() aplicados en este bloque
+  CHECKSUM      // Hash de la salida acumulado hasta este bloque
+};
+
+/**
+ * @brief Evento de tamaño fijo.
+ */
+struct CaptureEvent {
+  uint32_t block;          // Bloque de audio en el que se aplica
+  CaptureEventType type;
+  uint8_t id;
+  uint16_t reserved;
+  uint32_t value;
+};
+static_assert(sizeof(CaptureEvent) == 12, "CaptureEvent must stay 12 bytes");
+
+/**
+ * @brief Cabecera del volcado binario (seguida de los eventos de loop(),
+ * los del audio callback y las muestras de entrada, en ese orden).
+ */
+struct CaptureHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t block_size;
+  uint32_t sample_rate;
+  uint32_t blocks;         // Bloques de audio capturados
+  uint32_t ui_events;
+  uint32_t audio_events;
+  uint32_t input_samples;
+};
+
+static const uint32_t CAPTURE_MAGIC = 0x50414353;  // "SCAP" en little-endian
+static const uint16_t CAPTURE_VERSION = 2;
+
+/**
+ * @brief Registro lineal de eventos (un solo productor).
+ */
+class EventLog {
+public:
+  void Init(CaptureEvent* storage, size_t capacity) {
+    _events = storage;
+    _capacity = capacity;
+    _size = 0;
+    _overflow = false;
+  }
+
+  /** @return false si el registro está lleno (la sesión queda truncada) */
+  bool Append(uint32_t block, CaptureEventType type, uint8_t id, uint32_t value) {
+    if (_size >= _capacity) {
+      _overflow = true;
+      return false;
+    }
+    CaptureEvent& e = _events[_size];
+    e.block = block;
+    e.type = type;
+    e.id = id;
+    e.reserved = 0;
+    e.value = value;
+    _size++;
+    return true;
+  }
+
+  size_t Size() const { return _size; }
+  bool Overflowed() const { return _overflow; }
+  const CaptureEvent* Data() const { return _events; }
+
+  /** @brief Para cargar una sesión: escribir en Storage() y fijar el tamaño. */
+  CaptureEvent* Storage() { return _events; }
+  size_t Capacity() const { return _capacity; }
+  void SetSize(size_t size) { _size = (size < _capacity) ? size : _capacity; }
+
+private:
+  CaptureEvent* _events = nullptr;
+  size_t _capacity = 0;
+  size_t _size = 0;
+  bool _overflow = false;
+};
+
+/**
+ * @brief Recorre un registro en orden, bloque a bloque (repetición).
+ */
+class EventCursor {
+public:
+  explicit EventCursor(const EventLog& log) : _log(log) {}
+
+  /** @brief Siguiente evento del bloque dado; false cuando no quedan más en ese bloque. */
+  bool Next(uint32_t block, CaptureEvent& out) {
+    if (_index >= _log.Size() || _log.Data()[_index].block != block) return false;
+    out = _log.Data()[_index++];
+    return true;
+  }
+
+private:
+  const EventLog& _log;
+  size_t _index = 0;
+};
+
+/**
+ * @brief Registro lineal de muestras (entrada de audio).
+ */
+class SampleLog {
+public:
+  void Init(float* storage, size_t capacity) {
+    _samples = storage;
+    _capacity = capacity;
+    _size = 0;
+  }
+
+  /** @return Muestras escritas (menos que length si se llenó) */
+  size_t Write(const float* in, size_t length) {
+    size_t n = _capacity - _size;
+    if (n > length) n = length;
+    memcpy(_samples + _size, in, sizeof(float) * n);
+    _size += n;
+    return n;
+  }
+
+  bool Full() const { return _size >= _capacity; }
+  size_t Size() const { return _size; }
+  const float* Data() const { return _samples; }
+  float* Storage() { return _samples; }
+  size_t Capacity() const { return _capacity; }
+  void SetSize(size_t size) { _size = (size < _capacity) ? size : _capacity; }
+
+private:
+  float* _samples = nullptr;
+  size_t _capacity = 0;
+  size_t _size = 0;
+};
+
+/**
+ * @brief Hash FNV-1a sobre los bits de las muestras: cualquier diferencia
+ * de redondeo entre captura y repetición lo cambia.
+ */
+class OutputHash {
+public:
+  static const uint32_t SEED = 2166136261u;
+
+  static uint32_t Update(uint32_t hash, const float* samples, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+      uint32_t bits;
+      memcpy(&bits, &samples[i], sizeof(bits));
+      hash = (hash ^ bits) * 16777619u;
+    }
+    return hash;
+  }
+};
+
+} // namespace crearttech
+
+#endif // SAMPLER_CAPTURE_H
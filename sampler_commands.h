@@ -0,0 +1,106 @@
+/**
+ * =====================================================================
+ * sampler_commands.h - Lock-free Command Queue (UI -> Audio)
+ * =====================================================================
+ * Cola SPSC (un productor, un consumidor) sin locks para enviar comandos
+ * desde loop() al audio callback. El callback drena la cola al inicio de
+ * cada bloque, así el estado del motor solo se modifica desde el hilo de
+ * audio y loop() nunca necesita deshabilitar interrupciones.
+ */
+
+#ifndef SAMPLER_COMMANDS_H
+#define SAMPLER_COMMANDS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+namespace crearttech {
+
+/**
+ * @brief Tipos de comando que loop() puede enviar al motor de audio.
+ */
+enum class LooperCommandType : uint8_t {
+  SCRUB_BEGIN,       // Entrar en modo scrub (el cabezal sigue al encoder)
+  SCRUB_TARGET,      // Nueva posición objetivo (value) y velocidad (value2)
+  SCRUB_END,         // Salir del modo scrub y continuar la reproducción
+  LOOP_REGION,       // Región del loop y del motor granular: inicio (value) y longitud (value2)
+  FREEZE,            // Congelamiento espectral: activar (value != 0) o liberar
+  SWAP_BUFFER,       // Activar el render terminado: pico en value, nueva duración en value2 (0 = igual)
+  AUTOMATION_ARM,    // Grabar automatización en el próximo ciclo (value != 0) o cancelar
+  AUTOMATION_CLEAR,  // Borrar todas las pistas de automatización
+  TRANSPORT,         // Cambio de estado (con rampa desde PLAYING): estado en value, reiniciar si value2 != 0
+  GRAIN_PARAM,       // Parámetro del motor granular: GrainParam en value, valor en value2
+  RECORD_ARM,        // Armar la grabación por umbral desde STOPPED: pre-roll en muestras (value)
+  RECORD_STOP,       // REC soltado: cancela la grabación armada, termina la toma o el overdub
+  OVERDUB_START,     // Sobregrabar desde PLAYING: ganancia de la entrada (value)
+  RETRIGGER,         // Redisparar la reproducción desde el borde de la región
+  REVERSE,           // Reproducción en reversa (value != 0)
+  PLAYBACK_MODE,     // PlaybackMode en value; motor granular si value2 != 0
+  PLAYBACK_SPEED,    // Velocidad de reproducción del looper (value)
+  DELAY_RESET        // Vaciar la línea del delay
+};
+
+/**
+ * @brief Comando compacto de tamaño fijo.
+ */
+struct LooperCommand {
+  LooperCommandType type;
+  float value;       // Parámetro principal (depende del tipo)
+  float value2;      // Parámetro secundario (depende del tipo)
+};
+
+/**
+ * @brief Cola circular SPSC de capacidad fija.
+ * @tparam T Tipo de elemento (copiable)
+ * @tparam N Capacidad; debe ser potencia de 2
+ */
+template <typename T, size_t N>
+class CommandQueue {
+  static_assert((N & (N - 1)) == 0, "CommandQueue size must be a power of 2");
+
+public:
+  CommandQueue() : _head(0), _tail(0) {}
+
+  /**
+   * @brief Encola un elemento (solo el productor).
+   * @return false si la cola está llena (el comando se descarta)
+   */
+  bool Push(const T& item) {
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    uint32_t tail = _tail.load(std::memory_order_acquire);
+    if (head - tail >= N) return false;
+
+    _items[head & (N - 1)] = item;
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Desencola un elemento (solo el consumidor).
+   * @return false si la cola está vacía
+   */
+  bool Pop(T& item) {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    uint32_t head = _head.load(std::memory_order_acquire);
+    if (tail == head) return false;
+
+    item = _items[tail & (N - 1)];
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /** @brief Verifica si la cola está vacía (aproximado desde el productor). */
+  bool IsEmpty() const {
+    return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+  }
+
+private:
+  T _items[N];
+  std::atomic<uint32_t> _head;  // Escrito solo por el productor
+  std::atomic<uint32_t> _tail;  // Escrito solo por el consumidor
+};
+
+} // namespace crearttech
+
+#endif // SAMPLER_COMMANDS_H
@@ -0,0 +1,94 @@
+/**
+ * =====================================================================
+ * sampler_declick.h - Transport Declick Envelope
+ * =====================================================================
+ * Envolvente de ganancia para los cambios de transporte (play/pausa/stop):
+ * - La rampa empieza en la muestra donde el cambio entra en vigor y puede
+ *   terminar a mitad de bloque; el resto del bloque queda en la ganancia final
+ * - Se procesa por tramos (rampa, constante) con un kernel por tramo, sin
+ *   una rama por muestra
+ * - Una rampa que se invierte a mitad de camino dura lo proporcional a la
+ *   distancia que le queda
+ */
+
+#ifndef SAMPLER_DECLICK_H
+#define SAMPLER_DECLICK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include "sampler_dsp_utils.h"
+
+namespace crearttech {
+
+/**
+ * @brief Rampa de ganancia entre 0 y 1 aplicada a la salida (solo desde el audio callback).
+ */
+class DeclickEnvelope {
+public:
+  /**
+   * @param sample_rate Frecuencia de muestreo
+   * @param time_ms Duración de una rampa completa (0 -> 1)
+   */
+  void Init(float sample_rate, float time_ms) {
+    _ramp_samples = static_cast<size_t>(sample_rate * time_ms * 0.001f);
+    if (_ramp_samples == 0) _ramp_samples = 1;
+    Reset(1.0f);
+  }
+
+  /** @brief Salta a una ganancia sin rampa. */
+  void Reset(float gain) {
+    _gain = gain;
+    _target = gain;
+    _step = 0.0f;
+    _remaining = 0;
+  }
+
+  /** @brief Empieza una rampa hacia target desde la ganancia actual. */
+  void FadeTo(float target) {
+    if (target == _target) return;
+    _target = target;
+    _remaining = static_cast<size_t>(ceilf(fabsf(target - _gain) * static_cast<float>(_ramp_samples)));
+    if (_remaining == 0) _remaining = 1;
+    _step = (target - _gain) / static_cast<float>(_remaining);
+  }
+
+  bool IsRamping() const { return _remaining > 0; }
+  float GetGain() const { return _gain; }
+
+  /**
+   * @brief Aplica la envolvente a un bloque estéreo.
+   * @param out1 Segundo canal (puede ser nullptr)
+   */
+  void Process(float* out0, float* out1, size_t size) {
+    size_t ramp = (_remaining < size) ? _remaining : size;
+    if (ramp > 0) {
+      DSPUtils::ApplyGainRamp(out0, ramp, _gain, _step);
+      if (out1 != nullptr) DSPUtils::ApplyGainRamp(out1, ramp, _gain, _step);
+      _remaining -= ramp;
+      _gain = (_remaining == 0) ? _target : _gain + _step * static_cast<float>(ramp);
+    }
+
+    // Tramo constante después de la rampa: unidad (nada que hacer), silencio o ganancia fija
+    size_t rest = size - ramp;
+    if (rest == 0 || _gain == 1.0f) return;
+    if (_gain == 0.0f) {
+      DSPUtils::ClearBuffer(out0 + ramp, rest);
+      if (out1 != nullptr) DSPUtils::ClearBuffer(out1 + ramp, rest);
+    } else {
+      DSPUtils::ApplyGainRamp(out0 + ramp, rest, _gain, 0.0f);
+      if (out1 != nullptr) DSPUtils::ApplyGainRamp(out1 + ramp, rest, _gain, 0.0f);
+    }
+  }
+
+private:
+  size_t _ramp_samples = 1;
+  size_t _remaining = 0;   // Muestras que le quedan a la rampa en curso
+  float _gain = 1.0f;
+  float _target = 1.0f;
+  float _step = 0.0f;
+};
+
+} // namespace crearttech
+
+#endif // SAMPLER_DECLICK_H
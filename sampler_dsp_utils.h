@@ -16,6 +16,8 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
+#include <math.h>
 
 // Verificar si CMSIS-DSP está disponible
 #ifdef ARM_MATH_CM7
@@ -92,6 +94,19 @@ public:
     }
   }
 
+  /**
+   * @brief Multiplica un buffer por una rampa de ganancia lineal (sin ramas por muestra).
+   * @param buffer Buffer a procesar (in-place)
+   * @param length Número de muestras
+   * @param start Ganancia en la primera muestra
+   * @param step Incremento de ganancia por muestra
+   */
+  static void ApplyGainRamp(float* buffer, size_t length, float start, float step) {
+    for (size_t i = 0; i < length; i++) {
+      buffer[i] *= start + step * static_cast<float>(i);
+    }
+  }
+
   /**
    * @brief Calcula el valor RMS (Root Mean Square) de un buffer.
    * @param buffer Buffer de audio
@@ -140,6 +155,38 @@ public:
     #endif
   }
 
+  /**
+   * @brief Calcula pico absoluto y suma de cuadrados.
+   * Con CMSIS-DSP son dos pasadas vectorizadas (arm_absmax_f32 y arm_power_f32) sobre un
+   * bloque que ya está en caché; sin CMSIS, una sola pasada en C.
+   * @param buffer Buffer de audio
+   * @param length Número de muestras
+   * @param peak Máximo valor absoluto (salida)
+   * @param sum_squares Suma de cuadrados (salida; RMS = sqrt(sum_squares / length))
+   */
+  static void PeakAndSumSquares(const float* buffer, size_t length, float& peak, float& sum_squares) {
+    #if USE_CMSIS_DSP
+      if (length == 0) {
+        peak = sum_squares = 0.0f;
+        return;
+      }
+      uint32_t max_index;
+      arm_absmax_f32(buffer, static_cast<uint32_t>(length), &peak, &max_index);
+      arm_power_f32(buffer, static_cast<uint32_t>(length), &sum_squares);
+    #else
+      float p = 0.0f;
+      float s = 0.0f;
+      for (size_t i = 0; i < length; i++) {
+        float x = buffer[i];
+        float a = fabsf(x);
+        s += x * x;
+        p = (a > p) ? a : p;
+      }
+      peak = p;
+      sum_squares = s;
+    #endif
+  }
+
   /**
    * @brief Limpia un buffer (pone todos los valores a 0).
    * @param buffer Buffer a limpiar
@@ -0,0 +1,130 @@
+/**
+ * =====================================================================
+ * sampler_dynamics.h - Input Dynamics (Compressor / Gate)
+ * =====================================================================
+ * Compresor feed-forward y expansor (gate) sobre la entrada, antes de grabar:
+ * - Detector de pico con ataque instantáneo y relajación precalculada: la
+ *   ganancia de un golpe ya está reducida en su primera muestra
+ * - Techo duro en ±1 a la salida, así lo que llega al búfer nunca supera
+ *   el fondo de escala aunque la curva tenga mucho makeup
+ * - El nivel se pasa a log2 con el exponente del float y una tabla de la
+ *   mantisa (sin logf por muestra)
+ * - La curva estática completa (gate, rodilla, compresión y makeup) está en
+ *   una tabla de ganancia lineal por nivel en dB, con interpolación
+ * Las tablas se calculan al configurar, nunca dentro del audio callback.
+ */
+
+#ifndef SAMPLER_DYNAMICS_H
+#define SAMPLER_DYNAMICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+namespace crearttech {
+
+/**
+ * @brief Parámetros de la curva estática y del detector.
+ */
+struct DynamicsSettings {
+  float threshold_db;       // Inicio de la compresión
+  float ratio;              // Compresión por encima del umbral (ej. 4 = 4:1)
+  float knee_db;            // Ancho de la rodilla suave
+  float makeup_db;          // Ganancia después de comprimir
+  float gate_threshold_db;  // Debajo de este nivel actúa el expansor
+  float gate_ratio;         // Expansión debajo del umbral (ej. 4 = 1:4)
+  float gate_range_db;      // Atenuación máxima del gate
+  float release_ms;
+};
+
+/**
+ * @brief Compresor y gate mono, procesado por bloque in-place (solo desde el audio callback).
+ */
+class InputDynamics {
+public:
+  void Init(float sample_rate, const DynamicsSettings& settings) {
+    for (size_t i = 0; i < LOG2_MANTISSA_STEPS; i++) {
+      // Centro de cada intervalo de la mantisa: el error queda en ±0.05 dB
+      _log2_mantissa[i] = log2f(1.0f + (static_cast<float>(i) + 0.5f) / LOG2_MANTISSA_STEPS);
+    }
+    _release = expf(-1.0f / (settings.release_ms * 0.001f * sample_rate));
+    for (size_t i = 0; i < GAIN_TABLE_SIZE; i++) {
+      float level_db = MIN_LEVEL_DB + static_cast<float>(i) / STEPS_PER_DB;
+      _gain_table[i] = powf(10.0f, StaticGainDb(settings, level_db) / 20.0f);
+    }
+    _envelope = 0.0f;
+  }
+
+  void Reset() { _envelope = 0.0f; }
+
+  /**
+   * @brief Aplica la ganancia a un bloque (la salida queda en [-CEILING, CEILING]).
+   */
+  void Process(float* buffer, size_t size) {
+    float env = _envelope;
+    for (size_t i = 0; i < size; i++) {
+      float x = fabsf(buffer[i]);
+      env = (x > env) ? x : x + _release * (env - x);
+
+      // Nivel en dB -> posición fraccionaria en la tabla de ganancia
+      float pos = (FastLog2(env) * DB_PER_LOG2 - MIN_LEVEL_DB) * STEPS_PER_DB;
+      if (pos < 0.0f) pos = 0.0f;
+      if (pos > GAIN_TABLE_SIZE - 1.001f) pos = GAIN_TABLE_SIZE - 1.001f;
+      size_t index = static_cast<size_t>(pos);
+      float frac = pos - static_cast<float>(index);
+
+      float y = buffer[i] * (_gain_table[index] + frac * (_gain_table[index + 1] - _gain_table[index]));
+      buffer[i] = (y > CEILING) ? CEILING : (y < -CEILING) ? -CEILING : y;
+    }
+    _envelope = env;
+  }
+
+private:
+  static constexpr size_t LOG2_MANTISSA_BITS = 7;
+  static constexpr size_t LOG2_MANTISSA_STEPS = 1u << LOG2_MANTISSA_BITS;
+  static constexpr float MIN_LEVEL_DB = -96.0f;
+  static constexpr float MAX_LEVEL_DB = 12.0f;
+  static constexpr float STEPS_PER_DB = 2.0f;
+  static constexpr size_t GAIN_TABLE_SIZE = static_cast<size_t>((MAX_LEVEL_DB - MIN_LEVEL_DB) * STEPS_PER_DB) + 1;
+  static constexpr float DB_PER_LOG2 = 6.0205999f;  // 20 * log10(2)
+  static constexpr float CEILING = 1.0f;
+
+  /** @brief log2 con el exponente IEEE y la mantisa por tabla (x <= 0 da un nivel muy bajo). */
+  float FastLog2(float x) const {
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    int exponent = static_cast<int>((bits >> 23) & 0xFF) - 127;
+    uint32_t mantissa = (bits >> (23 - LOG2_MANTISSA_BITS)) & (LOG2_MANTISSA_STEPS - 1);
+    return static_cast<float>(exponent) + _log2_mantissa[mantissa];
+  }
+
+  /** @brief Curva estática: ganancia en dB para un nivel de entrada en dB. */
+  static float StaticGainDb(const DynamicsSettings& s, float level_db) {
+    // Compresión con rodilla suave (cuadrática dentro de la rodilla)
+    float over = level_db - s.threshold_db;
+    float slope = 1.0f / s.ratio - 1.0f;
+    float gain_db;
+    if (2.0f * over <= -s.knee_db) gain_db = 0.0f;
+    else if (2.0f * over >= s.knee_db) gain_db = slope * over;
+    else {
+      float k = over + s.knee_db * 0.5f;
+      gain_db = slope * k * k / (2.0f * s.knee_db);
+    }
+    // Expansor debajo del umbral del gate, con atenuación máxima
+    if (level_db < s.gate_threshold_db) {
+      float cut = (s.gate_threshold_db - level_db) * (s.gate_ratio - 1.0f);
+      gain_db -= (cut < s.gate_range_db) ? cut : s.gate_range_db;
+    }
+    return gain_db + s.makeup_db;
+  }
+
+  float _log2_mantissa[LOG2_MANTISSA_STEPS];
+  float _gain_table[GAIN_TABLE_SIZE];
+  float _release = 0.0f;
+  float _envelope = 0.0f;
+};
+
+} // namespace crearttech
+
+#endif // SAMPLER_DYNAMICS_H
@@ -1,9 +1,28 @@
 #pragma once
 // SAMPLER CNA - Audio Engine
+#include <stdint.h>
 #include <string.h>
+#include <math.h>
+#include "sampler_dsp_utils.h"
 
 namespace crearttech {
 
+/**
+ * @brief Estadísticas de un tramo de STATS_CHUNK muestras de la toma.
+ */
+struct ChunkStats {
+  float peak;         // Pico absoluto del tramo
+};
+
+/**
+ * @brief Modos de reproducción del looper.
+ */
+enum PlaybackMode {
+  PLAYBACK_LOOP,      // Wrap-around clásico al llegar al borde de la región
+  PLAYBACK_PINGPONG,  // Rebota en los bordes invirtiendo la dirección
+  PLAYBACK_ONESHOT    // Se detiene al final y queda listo para redisparar
+};
+
 /**
  * @class OverdubLooper
  * @brief Motor principal del looper con grabación, reproducción, overdub y undo/redo.
@@ -14,7 +33,9 @@ public:
    * @brief Prepara el looper para su uso.
    * @param buf Puntero a un búfer de memoria (ej. en la SDRAM) donde se guardará el audio.
    * @param length La longitud total de ese búfer en número de muestras.
-   * @param undo_bufs Array de punteros a buffers de undo (opcional, puede ser nullptr)
+   * @param undo_bufs Array de num_undo_levels + 1 punteros a buffers de undo (opcional,
+   *        puede ser nullptr); el búfer extra recibe el snapshot en preparación, así
+   *        prepararlo no pisa ningún nivel restaurable
    * @param num_undo_levels Número de niveles de undo disponibles (max MAX_UNDO_LEVELS)
    */
   void Init(float *buf, size_t length, float** undo_bufs = nullptr, size_t num_undo_levels = 0) {
@@ -31,12 +52,14 @@ public:
     // Configurar buffers de undo si se proporcionan
     if (undo_bufs != nullptr && num_undo_levels > 0) {
       _undo_enabled = true;
-      _undo_count = (num_undo_levels <= MAX_UNDO_LEVELS) ? num_undo_levels : MAX_UNDO_LEVELS;
+      _undo_levels = (num_undo_levels <= MAX_UNDO_LEVELS) ? num_undo_levels : MAX_UNDO_LEVELS;
+      _undo_count = _undo_levels + 1;
       for (size_t i = 0; i < _undo_count; i++) {
         _undo_buffers[i] = undo_bufs[i];
       }
     } else {
       _undo_enabled = false;
+      _undo_levels = 0;
       _undo_count = 0;
     }
     
@@ -46,16 +69,29 @@ public:
     _inv_buffer_length = 1.0f / static_cast<float>(_buffer_length);
     _inv_crossfade_samples = 1.0f / static_cast<float>(CROSSFADE_SAMPLES);
     
+    _loop_start = 0;
+    _loop_length = 0;
+    _play_head = 0.0f;
+    _rec_head = 0;
+
     _is_empty = true;
+    _is_recording = false;
+    _armed = false;
+    _overdubbing = false;
     _reverse = false;
     _playback_speed = 1.0f;
+    _playback_mode = PLAYBACK_LOOP;
+    _pingpong_direction = 1.0f;
+    _oneshot_done = false;
   }
 
   // --- Funciones de Control de Estado ---
 
   /** @brief Inicia la grabación desde el principio del búfer. */
   void StartRecording() {
+    InvalidatePreparedUndo();
     _rec_head = 0;
+    _take_peak = 0.0f;
     _play_head = 0.0f;
     _is_empty = false;
     _is_recording = true;
@@ -68,18 +104,161 @@ public:
     ApplyCrossfade();
   }
 
-  /** @brief Inicia la sobregrabación (mezcla la entrada con lo que ya hay). */
+  /**
+   * @brief Arma la grabación por umbral: el audio callback la inicia en la muestra
+   * exacta donde la entrada cruza el umbral, anteponiendo `preroll` muestras previas.
+   * @param threshold Nivel absoluto de disparo (lineal)
+   * @param preroll Muestras de pre-roll (se limita a PREROLL_CAPACITY)
+   */
+  void ArmRecording(float threshold, size_t preroll) {
+    _arm_threshold = threshold;
+    _preroll_length = (preroll < PREROLL_CAPACITY) ? preroll : PREROLL_CAPACITY;
+    _preroll_write = 0;
+    _preroll_fill = 0;
+    _is_recording = false;
+    _overdubbing = false;
+    _armed = true;
+  }
+
+  /** @brief Cancela la grabación armada si todavía no se disparó. */
+  void Disarm() { _armed = false; }
+
+  /** @brief Indica si la grabación está armada y esperando el umbral. */
+  bool IsArmed() const { return _armed; }
+
+  /** @brief Indica si la grabación inicial está en curso. */
+  bool IsRecording() const { return _is_recording; }
+
+  /** @brief Muestras escritas en la grabación inicial en curso (incluye el pre-roll). */
+  size_t GetRecordHead() const { return _rec_head; }
+
+  /**
+   * @brief Asigna el almacenamiento de estadísticas por tramo (ej. en la SDRAM).
+   * @param stats Array de al menos buffer_length / STATS_CHUNK + 1 entradas
+   * @param silent_bits Bits de "tramo en silencio", (count + 31) / 32 palabras
+   * @param count Número de tramos disponibles
+   */
+  void AttachChunkStats(ChunkStats* stats, uint32_t* silent_bits, size_t count) {
+    _chunk_stats = stats;
+    _silent_bits = silent_bits;
+    _chunk_stats_count = count;
+    // Sin datos ningún tramo se da por silencioso
+    memset(_silent_bits, 0, sizeof(uint32_t) * ((count + 31) / 32));
+  }
+
+  /** @brief Indica si el último bloque de reproducción salió entero de tramos en silencio. */
+  bool LastBlockSilent() const { return _last_block_silent; }
+
+  /** @brief Pico absoluto de la toma acumulado durante la grabación. */
+  float GetTakePeak() const { return _take_peak; }
+
+  /**
+   * @brief Cambia el búfer activo por un render de la toma (ej. un bounce), con
+   * la misma longitud. Solo debe llamarse desde el audio callback.
+   * @param buf Búfer nuevo
+   * @param peak Pico del contenido nuevo
+   * @param undoable true si la región no cambió: el snapshot de undo preparado se
+   *        confirma y el render se puede deshacer. Con false (ej. un remuestreo que
+   *        cambia la duración) el historial se descarta, porque ya no corresponde.
+   * @return Búfer anterior (queda libre para el próximo render)
+   */
+  float* ReplaceBuffer(float* buf, float peak, bool undoable = true) {
+    if (undoable && IsUndoPrepared()) CommitUndoState();
+    if (!undoable) {
+      _undo_depth = 0;
+      _redo_depth = 0;
+    }
+    InvalidatePreparedUndo();
+    float* previous = _buffer;
+    _buffer = buf;
+    if (peak > _take_peak) _take_peak = peak;
+    // Las estadísticas de silencio eran del búfer anterior
+    if (_loop_length > 0) MarkRangeAudible(_loop_start, _loop_start + _loop_length - 1);
+    return previous;
+  }
+
+  /**
+   * @brief Recorta el silencio inicial y final y calcula la ganancia de normalización
+   * a partir de las estadísticas por tramo, sin volver a leer muestras.
+   * @param length Muestras grabadas
+   * @param silence_threshold Pico por debajo del cual un tramo se considera silencio
+   * @param target_peak Pico deseado tras normalizar (lineal)
+   * @param start Inicio de la región recortada
+   * @param end Fin (inclusive) de la región recortada
+   * @param gain Ganancia a aplicar en reproducción (no se escribe en el búfer)
+   */
+  void AnalyzeTake(size_t length, float silence_threshold, float target_peak,
+                   size_t& start, size_t& end, float& gain) const {
+    start = 0;
+    end = (length > 0) ? length - 1 : 0;
+    gain = 1.0f;
+    if (_chunk_stats == nullptr || length == 0) return;
+
+    size_t chunks = (length + STATS_CHUNK - 1) / STATS_CHUNK;
+    if (chunks > _chunk_stats_count) chunks = _chunk_stats_count;
+
+    size_t first = 0;
+    while (first < chunks && _chunk_stats[first].peak < silence_threshold) first++;
+    if (first == chunks) return;  // Toma en silencio: se conserva entera
+    size_t last = chunks - 1;
+    while (last > first && _chunk_stats[last].peak < silence_threshold) last--;
+
+    float peak = 0.0f;
+    for (size_t c = first; c <= last; c++) {
+      if (_chunk_stats[c].peak > peak) peak = _chunk_stats[c].peak;
+    }
+
+    // Un tramo de margen a cada lado para no cortar ataques ni colas suaves
+    first = (first > TRIM_MARGIN_CHUNKS) ? first - TRIM_MARGIN_CHUNKS : 0;
+    last = (last + TRIM_MARGIN_CHUNKS < chunks) ? last + TRIM_MARGIN_CHUNKS : chunks - 1;
+    start = first * STATS_CHUNK;
+    size_t stop = (last + 1) * STATS_CHUNK;
+    end = ((stop < length) ? stop : length) - 1;
+
+    gain = target_peak / peak;
+    if (gain > MAX_NORMALIZE_GAIN) gain = MAX_NORMALIZE_GAIN;
+  }
+
+  static const size_t STATS_CHUNK = 256;  // ~5.3ms @ 48kHz
+
+  /**
+   * @brief Ganancia de la entrada al sobregrabar. Con la inversa de la normalización de
+   * reproducción, el material nuevo suena a la ganancia con que entra y solo la toma
+   * original queda normalizada.
+   */
+  void SetOverdubInputGain(float gain) { _overdub_input_gain = gain; }
+
+  /**
+   * @brief Inicia la sobregrabación (mezcla la entrada con lo que ya hay).
+   * Sale del scrub: en modo scrub el bloque no pasa por la sobregrabación.
+   */
   void StartOverdub()  { 
-    SaveUndoState();
+    if (IsUndoPrepared()) CommitUndoState();  // Snapshot ya copiado en segundo plano
+    else SaveUndoState();
+    _scrubbing = false;
     _overdubbing = true; 
   }
 
   /** @brief Detiene la sobregrabación. */
-  void StopOverdub()   { _overdubbing = false; }
+  void StopOverdub()   {
+    _overdubbing = false;
+    InvalidatePreparedUndo();
+  }
 
   /** @brief Vuelve a colocar el cabezal de reproducción al inicio del loop. */
   void Restart()       { _play_head = 0; }
 
+  /**
+   * @brief Redispara la reproducción desde el borde de entrada de la región.
+   * En modo one-shot sale del estado "terminado"; en ping-pong reinicia la dirección.
+   */
+  void Retrigger() {
+    _cycles++;
+    _pingpong_direction = 1.0f;
+    _play_head = _reverse ? static_cast<float>(_loop_length - 1) : 0.0f;
+    _oneshot_done = false;
+  }
+
   // --- Funciones de Manipulación del Loop ---
 
   /**
@@ -110,6 +289,67 @@ public:
   /** @brief Activa o desactiva la reproducción en reversa. */
   void SetReverse(bool reverse) { _reverse = reverse; }
 
+  /**
+   * @brief Selecciona el modo de reproducción (loop, ping-pong o one-shot).
+   * Reinicia la dirección de ping-pong y el estado "terminado" del one-shot.
+   */
+  void SetPlaybackMode(PlaybackMode mode) {
+    _playback_mode = mode;
+    _pingpong_direction = 1.0f;
+    _oneshot_done = false;
+  }
+
+  /** @brief Devuelve el modo de reproducción actual. */
+  PlaybackMode GetPlaybackMode() const { return _playback_mode; }
+
+  /** @brief En modo one-shot, indica que el cabezal llegó al final y espera Retrigger(). */
+  bool IsOneShotDone() const { return _oneshot_done; }
+
+  /**
+   * @brief Entra en modo scrub: el cabezal deja de avanzar solo y sigue un objetivo.
+   * @param smoothing_hz Frecuencia natural del filtro críticamente amortiguado
+   * @param sample_rate Sample rate del sistema
+   */
+  void BeginScrub(float smoothing_hz, float sample_rate) {
+    float w = 2.0f * static_cast<float>(M_PI) * smoothing_hz / sample_rate;
+    _scrub_w2 = w * w;
+    _scrub_2w = 2.0f * w;
+    _scrub_origin = _play_head;
+    _scrub_pos = _play_head;
+    _scrub_vel = 0.0f;
+    _scrub_target = _play_head;
+    _scrub_goal = _play_head;
+    _scrub_target_vel = 0.0f;
+    _scrubbing = true;
+  }
+
+  /**
+   * @brief Actualiza el objetivo del scrub.
+   * @param offset Desplazamiento acumulado desde BeginScrub (muestras, sin envolver)
+   * @param velocity Velocidad estimada del encoder (muestras por muestra); el objetivo
+   * avanza hacia el último detent a esta velocidad sin pasarlo (en cero salta a él)
+   */
+  void SetScrubTarget(float offset, float velocity) {
+    _scrub_goal = _scrub_origin + offset;
+    _scrub_target_vel = velocity;
+  }
+
+  /** @brief Sale del modo scrub; la reproducción continúa desde la posición alcanzada. */
+  void EndScrub() { _scrubbing = false; }
+
+  /** @brief Indica si el cabezal está en modo scrub. */
+  bool IsScrubbing() const { return _scrubbing; }
+
+  /**
+   * @brief El cabezal avanza solo hacia adelante: sin scrub, sin reversa y fuera del
+   * regreso del ping-pong.
+   */
+  bool IsPlayingForward() const {
+    float step = _playback_speed * _pingpong_direction;
+    if (_reverse) step = -step;
+    return !_scrubbing && step > 0.0f;
+  }
+
   /** @brief Ajusta la velocidad de reproducción. 1.0 es normal, >1.0 es más rápido. */
   void SetPlaybackSpeed(float speed) { _playback_speed = speed; }
   
@@ -199,14 +439,70 @@ public:
            _buffer + _loop_start, 
            sizeof(float) * _loop_length);
     
+    CommitUndoState();
+  }
+
+  /**
+   * @brief Copia una porción de la región actual al siguiente nivel de undo
+   * (llamar desde loop(), nunca desde el audio callback). Así StartOverdub()
+   * no tiene que copiar todo el loop en el momento de pulsar REC.
+   * @param max_samples Máximo de muestras a copiar en esta porción
+   * @return true cuando el snapshot está completo
+   */
+  bool PrepareUndoStep(size_t max_samples) {
+    return PrepareUndoStep(_loop_start, _loop_length, max_samples);
+  }
+
+  /**
+   * @brief Igual, para una región que el audio callback todavía no aplicó (ya está en
+   * la cola antes del overdub): StartOverdub() la encuentra preparada.
+   */
+  bool PrepareUndoStep(size_t loop_start, size_t loop_length, size_t max_samples) {
+    if (!_undo_enabled || _undo_count == 0) return true;
+    if (_prepared_start != loop_start || _prepared_length != loop_length) {
+      // La región cambió: el snapshot parcial ya no sirve
+      _prepared_start = loop_start;
+      _prepared_length = loop_length;
+      _prepared_pos = 0;
+    }
+    size_t n = _prepared_length - _prepared_pos;
+    if (n > max_samples) n = max_samples;
+    memcpy(_undo_buffers[_undo_write_index] + _prepared_pos,
+           _buffer + _prepared_start + _prepared_pos,
+           sizeof(float) * n);
+    _prepared_pos += n;
+    return _prepared_pos >= _prepared_length;
+  }
+
+  /** @brief Avance del snapshot de undo en preparación (0.0 a 1.0). */
+  float GetUndoPrepareProgress() const {
+    return (_prepared_length > 0) ? static_cast<float>(_prepared_pos) / static_cast<float>(_prepared_length) : 0.0f;
+  }
+
+  /** @brief Descarta el snapshot preparado (el búfer cambió desde que se copió). */
+  void InvalidatePreparedUndo() {
+    _prepared_pos = 0;
+    _prepared_length = static_cast<size_t>(-1);
+  }
 
+  /** @brief Indica si el snapshot preparado corresponde a la región actual. */
+  bool IsUndoPrepared() const {
+    return _undo_enabled && _prepared_start == _loop_start && _prepared_length == _loop_length &&
+           _prepared_pos >= _prepared_length;
+  }
+
+  /**
+   * @brief Confirma el nivel de undo recién escrito en _undo_write_index.
+   */
+  void CommitUndoState() {
+    InvalidatePreparedUndo();
     _undo_write_index = (_undo_write_index + 1) % _undo_count;
     
 
     _undo_read_index = _undo_write_index;
     
 
-    if (_undo_depth < _undo_count) {
+    if (_undo_depth < _undo_levels) {
       _undo_depth++;
     }
   }
@@ -217,6 +513,7 @@ public:
    */
   bool Undo() {
     if (!_undo_enabled || _undo_depth == 0) return false;
+    InvalidatePreparedUndo();
     
 
     _undo_read_index = (_undo_read_index - 1 + _undo_count) % _undo_count;
@@ -243,6 +540,7 @@ public:
    */
   bool Redo() {
     if (!_undo_enabled || _redo_depth == 0) return false;
+    InvalidatePreparedUndo();
     
 
     _undo_read_index = (_undo_read_index + 1) % _undo_count;
@@ -265,6 +563,9 @@ public:
    * @brief Verifica si hay niveles de undo disponibles.
    */
   bool CanUndo() const { return _undo_enabled && _undo_depth > 0; }
+
+  /** @brief Niveles de undo guardados. */
+  size_t GetUndoDepth() const { return _undo_depth; }
   
   /**
    * @brief Verifica si hay niveles de redo disponibles.
@@ -280,6 +581,12 @@ public:
     return static_cast<float>(_loop_start + _play_head) * _inv_buffer_length;
   }
 
+  /**
+   * @brief Ciclos empezados: cuenta cada cruce de un borde de la región (wrap,
+   * rebote o fin del one-shot) y cada Retrigger(). Sirve para atar eventos al ciclo.
+   */
+  uint32_t GetCycleCount() const { return _cycles; }
+
   /** @brief Devuelve la posición del cabezal dentro de la región del loop (en muestras). */
   size_t GetLoopPlayheadPosition() const { return static_cast<size_t>(_play_head); }
 
@@ -289,44 +596,74 @@ public:
    * @return Muestra de audio de salida (DAC).
    */
   float Process(float in) {
+    float out;
+    ProcessBlock(&in, &out, 1);
+    return out;
+  }
+
+  /**
+   * @brief Procesa un bloque completo de audio.
+   *
+   * El bloque se divide en segmentos que terminan justo donde el cabezal cruza
+   * un borde de la región; dentro de cada segmento el kernel no evalúa el modo
+   * de reproducción, y la acción de borde (wrap, rebote o parada) se aplica una
+   * sola vez entre segmentos.
+   *
+   * @param in Bloque de entrada (solo se usa al grabar o sobregrabar).
+   * @param out Bloque de salida.
+   * @param size Número de muestras del bloque.
+   */
+  void ProcessBlock(const float* in, float* out, size_t size) {
+    _last_block_silent = false;
+    if (_armed) {
+      ArmedBlock(in, out, size);
+      return;
+    }
 
     if (_is_recording) {
-      _buffer[_rec_head] = in;
+      RecordBlock(in, out, size);
+      return;
+    }
 
-      _rec_head++;
-      if (_rec_head >= _buffer_length) {
-        _rec_head = 0;
-        _is_recording = false;
-      }
-      return in;
+    if (_scrubbing) {
+      if (_is_empty || _loop_length == 0) memset(out, 0, sizeof(float) * size);
+      else ScrubBlock(out, size);
+      return;
     }
 
-    if (_is_empty) return 0.0f;
+    size_t done = 0;
+    _last_block_silent = true;
+    while (done < size) {
+      if (_is_empty || _oneshot_done || _loop_length == 0) {
+        memset(out + done, 0, sizeof(float) * (size - done));
+        return;
+      }
 
-    float out = GetInterpolatedSample(_play_head);
+      float step = _playback_speed * _pingpong_direction;
+      if (_reverse) step = -step;
 
-    if (_overdubbing) {
-      size_t index = (_loop_start + static_cast<size_t>(_play_head)) % _buffer_length;
-      float mixed = _buffer[index] + in;
-      mixed = SoftClip(mixed);
-      _buffer[index] = mixed;
-      out = mixed;
-    }
+      bool crosses = false;
+      size_t n = SamplesUntilEdge(step, size - done, crosses);
 
-    if (_reverse) {
-      _play_head -= _playback_speed;
-      if (_play_head < 0.0f) _play_head += _loop_length;
-    } else {
-      _play_head += _playback_speed;
-      if (_play_head >= _loop_length) _play_head -= _loop_length;
-    }
+      if (_overdubbing) {
+        OverdubSegment(in + done, out + done, n, step);
+      } else {
+        PlaySegment(out + done, n, step);
+      }
+      done += n;
 
-    return out;
+      if (crosses) HandleEdge(step);
+    }
   }
 
 private:
   // --- Constantes ---
   static const size_t CROSSFADE_SAMPLES = 128; // ~2.7ms @ 48kHz
+  static const size_t PREROLL_CAPACITY = 1024;  // ~21ms @ 48kHz (potencia de 2)
+  static const size_t TRIM_MARGIN_CHUNKS = 1;
+  static constexpr float SILENT_PEAK = 1e-4f;  // -80 dBFS: por debajo el tramo se trata como silencio
+  static constexpr float MAX_NORMALIZE_GAIN = 8.0f;  // +18 dB como máximo
+  static constexpr float SCRUB_GAIN_PER_SPEED = 8.0f; // Ganancia plena a partir de 1/8 de velocidad
   
 
   
@@ -336,6 +673,7 @@ private:
   void ApplyCrossfade() {
 
     if (_loop_length < CROSSFADE_SAMPLES * 2) return;
+    MarkRangeAudible(_loop_start, _loop_start + CROSSFADE_SAMPLES - 1);
     
     for (size_t i = 0; i < CROSSFADE_SAMPLES; i++) {
       float fade = static_cast<float>(i) * _inv_crossfade_samples;
@@ -348,6 +686,315 @@ private:
     }
   }
   
+  /**
+   * @brief Espera el umbral guardando la entrada en el anillo de pre-roll.
+   * Al cruzarlo copia el pre-roll al inicio del búfer y graba el resto del
+   * bloque desde la muestra del cruce, sin esperar a loop().
+   */
+  void ArmedBlock(const float* in, float* out, size_t size) {
+    size_t trigger = size;
+    for (size_t i = 0; i < size; i++) {
+      if (fabsf(in[i]) >= _arm_threshold) { trigger = i; break; }
+    }
+
+    for (size_t i = 0; i < trigger; i++) {
+      _preroll[_preroll_write] = in[i];
+      _preroll_write = (_preroll_write + 1) & (PREROLL_CAPACITY - 1);
+    }
+    if (_preroll_fill < PREROLL_CAPACITY) {
+      _preroll_fill = (_preroll_fill + trigger < PREROLL_CAPACITY) ? _preroll_fill + trigger : PREROLL_CAPACITY;
+    }
+    memset(out, 0, sizeof(float) * trigger);
+    if (trigger == size) return;
+
+    // Disparo: las últimas muestras antes del cruce pasan a ser el inicio de la toma
+    size_t preroll = (_preroll_fill < _preroll_length) ? _preroll_fill : _preroll_length;
+    size_t read = (_preroll_write - preroll) & (PREROLL_CAPACITY - 1);
+    for (size_t i = 0; i < preroll; i++) {
+      _buffer[i] = _preroll[(read + i) & (PREROLL_CAPACITY - 1)];
+    }
+
+    _armed = false;
+    StartRecording();
+    AccumulateStats(0, preroll);
+    _rec_head = preroll;
+    RecordBlock(in + trigger, out + trigger, size - trigger);
+  }
+
+  /**
+   * @brief Escribe un bloque de grabación inicial; se detiene al llenar el búfer.
+   */
+  void RecordBlock(const float* in, float* out, size_t size) {
+    size_t n = _buffer_length - _rec_head;
+    if (n > size) n = size;
+
+    memcpy(_buffer + _rec_head, in, sizeof(float) * n);
+    memcpy(out, in, sizeof(float) * n);
+    AccumulateStats(_rec_head, n);
+    _rec_head += n;
+
+    if (_rec_head >= _buffer_length) {
+      _is_recording = false;  // _rec_head queda en el largo total de la toma
+    }
+    if (n < size) memset(out + n, 0, sizeof(float) * (size - n));
+  }
+
+  /**
+   * @brief Actualiza las estadísticas de los tramos que cubren [start, start + n).
+   * Un tramo se reinicia al escribir su primera muestra, así no hace falta
+   * limpiar el array al empezar una toma.
+   */
+  void AccumulateStats(size_t start, size_t n) {
+    while (n > 0) {
+      size_t chunk = start / STATS_CHUNK;
+      size_t offset = start - chunk * STATS_CHUNK;
+      size_t len = STATS_CHUNK - offset;
+      if (len > n) len = n;
+
+      float peak = DSPUtils::FindPeak(_buffer + start, len);
+      if (peak > _take_peak) _take_peak = peak;
+
+      if (_chunk_stats != nullptr && chunk < _chunk_stats_count) {
+        ChunkStats& stats = _chunk_stats[chunk];
+        if (offset == 0 || peak > stats.peak) stats.peak = peak;
+        SetChunkSilent(chunk, stats.peak < SILENT_PEAK);
+      }
+      start += len;
+      n -= len;
+    }
+  }
+
+  // --- Bits de silencio por tramo ---
+
+  bool ChunkSilent(size_t chunk) const {
+    return chunk < _chunk_stats_count && (_silent_bits[chunk >> 5] & (1u << (chunk & 31))) != 0;
+  }
+
+  void SetChunkSilent(size_t chunk, bool silent) {
+    if (silent) _silent_bits[chunk >> 5] |= (1u << (chunk & 31));
+    else _silent_bits[chunk >> 5] &= ~(1u << (chunk & 31));
+  }
+
+  /** @brief true si todos los tramos de [first, last] (índices absolutos) están en silencio. */
+  bool RangeSilent(size_t first, size_t last) const {
+    for (size_t c = first / STATS_CHUNK; c <= last / STATS_CHUNK; c++) {
+      if (!ChunkSilent(c)) return false;
+    }
+    return true;
+  }
+
+  /** @brief Marca como audibles los tramos de [first, last] (índices absolutos). */
+  void MarkRangeAudible(size_t first, size_t last) {
+    if (_silent_bits == nullptr) return;
+    for (size_t c = first / STATS_CHUNK; c <= last / STATS_CHUNK && c < _chunk_stats_count; c++) {
+      SetChunkSilent(c, false);
+    }
+  }
+
+  /**
+   * @brief Rango absoluto que lee un segmento (incluye el vecino de interpolación).
+   * @return false si el rango da la vuelta al final del búfer
+   */
+  bool SegmentRange(float head, float step, size_t n, size_t& first, size_t& last) const {
+    float end = head + step * static_cast<float>(n - 1);
+    size_t lo = static_cast<size_t>((step < 0.0f) ? end : head);
+    size_t hi = static_cast<size_t>((step < 0.0f) ? head : end) + 1;
+    if (hi >= _loop_length) hi = _loop_length - 1;
+    first = _loop_start + lo;
+    last = _loop_start + hi;
+    return last < _buffer_length;
+  }
+
+  /** @brief Indica si un segmento de reproducción lee solo tramos en silencio. */
+  bool SegmentSilent(float head, float step, size_t n) const {
+    if (_silent_bits == nullptr) return false;
+    size_t first, last;
+    if (!SegmentRange(head, step, n, first, last)) return false;
+    // Al final de la región la interpolación lee también el vecino de borde
+    if (last == _loop_start + _loop_length - 1 && !ChunkSilent((_loop_start + EdgeNeighbourIndex()) / STATS_CHUNK)) {
+      return false;
+    }
+    return RangeSilent(first, last);
+  }
+
+  void MarkSegmentAudible(float head, float step, size_t n) {
+    size_t first, last;
+    if (SegmentRange(head, step, n, first, last)) MarkRangeAudible(first, last);
+    else MarkRangeAudible(0, _buffer_length - 1);  // Caso raro: región que da la vuelta
+  }
+
+  /**
+   * @brief Calcula cuántas muestras pueden leerse antes de cruzar el borde de la región.
+   * @param step Incremento del cabezal por muestra (negativo en reversa)
+   * @param max_samples Muestras restantes en el bloque
+   * @param crosses Se pone a true si el segmento termina cruzando un borde
+   * @return Longitud del segmento en muestras (al menos 1)
+   */
+  size_t SamplesUntilEdge(float step, size_t max_samples, bool& crosses) {
+    const float length = static_cast<float>(_loop_length);
+    float n_f;
+    if (step > 0.0f) {
+      n_f = ceilf((length - _play_head) / step);
+    } else if (step < 0.0f) {
+      n_f = floorf(_play_head / -step) + 1.0f;
+    } else {
+      crosses = false;
+      return max_samples;
+    }
+
+    if (n_f < 1.0f) n_f = 1.0f;
+    if (n_f > static_cast<float>(max_samples)) {
+      crosses = false;
+      return max_samples;
+    }
+
+    // Corrige el redondeo: la última lectura del segmento debe quedar dentro de la región
+    size_t n = static_cast<size_t>(n_f);
+    float last = _play_head + step * static_cast<float>(n - 1);
+    while (n > 1 && (last >= length || last < 0.0f)) {
+      n--;
+      last -= step;
+    }
+    crosses = true;
+    return n;
+  }
+
+  /**
+   * @brief Aplica la acción de borde del modo actual tras cruzar la región.
+   */
+  void HandleEdge(float step) {
+    const float length = static_cast<float>(_loop_length);
+    const float last = length - 1.0f;
+    bool past_end = (step > 0.0f);
+
+    // Cruce por redondeo que no salió realmente de la región
+    if (_play_head >= 0.0f && _play_head < length) return;
+    _cycles++;
+
+    switch (_playback_mode) {
+      case PLAYBACK_LOOP:
+        _play_head += past_end ? -length : length;
+        break;
+
+      case PLAYBACK_PINGPONG:
+        _play_head = past_end ? (2.0f * last - _play_head) : -_play_head;
+        _pingpong_direction = -_pingpong_direction;
+        break;
+
+      case PLAYBACK_ONESHOT:
+        _oneshot_done = true;
+        _play_head = _reverse ? last : 0.0f;
+        break;
+    }
+
+    if (_play_head < 0.0f) _play_head = 0.0f;
+    if (_play_head > last) _play_head = last;
+  }
+
+  /**
+   * @brief Índice (relativo a la región) que sigue a la última muestra al interpolar.
+   * En loop interpola hacia el inicio; en ping-pong y one-shot se queda en el borde.
+   */
+  size_t EdgeNeighbourIndex() const {
+    return (_playback_mode == PLAYBACK_LOOP) ? 0 : _loop_length - 1;
+  }
+
+  /**
+   * @brief Kernel de reproducción: lee n muestras interpoladas sin cruzar bordes.
+   */
+  void PlaySegment(float* out, size_t n, float step) {
+    const size_t edge_next = EdgeNeighbourIndex();
+    float head = _play_head;
+    if (SegmentSilent(head, step, n)) {
+      memset(out, 0, sizeof(float) * n);
+      _play_head = head + step * static_cast<float>(n);
+      return;
+    }
+    _last_block_silent = false;
+    for (size_t i = 0; i < n; i++) {
+      out[i] = GetInterpolatedSample(head, edge_next);
+      head += step;
+    }
+    _play_head = head;
+  }
+
+  /**
+   * @brief Kernel de sobregrabación: mezcla la entrada en el búfer y devuelve la mezcla.
+   * El soft-clip se aplica solo donde entra audio: un tramo con la entrada en silencio
+   * deja el búfer intacto, así una vuelta de overdub sin tocar nada no cambia el loop.
+   */
+  void OverdubSegment(const float* in, float* out, size_t n, float step) {
+    float head = _play_head;
+    if (DSPUtils::FindPeak(in, n) < SILENT_PEAK) {
+      // Entrada en silencio: el búfer no cambia, se evita el soft-clip y la escritura
+      if (SegmentSilent(head, step, n)) {
+        memset(out, 0, sizeof(float) * n);
+      } else {
+        _last_block_silent = false;
+        for (size_t i = 0; i < n; i++) {
+          out[i] = _buffer[(_loop_start + static_cast<size_t>(head)) % _buffer_length];
+          head += step;
+        }
+      }
+      _play_head = _play_head + step * static_cast<float>(n);
+      return;
+    }
+
+    _last_block_silent = false;
+    MarkSegmentAudible(head, step, n);
+    for (size_t i = 0; i < n; i++) {
+      size_t index = (_loop_start + static_cast<size_t>(head)) % _buffer_length;
+      float mixed = SoftClip(_buffer[index] + in[i] * _overdub_input_gain);
+      _buffer[index] = mixed;
+      out[i] = mixed;
+      head += step;
+    }
+    _play_head = head;
+  }
+
+  /**
+   * @brief Kernel de scrub: el cabezal sigue al objetivo con un filtro de segundo
+   * orden críticamente amortiguado (sin sobreimpulso) y se lee con interpolación.
+   * El objetivo va hacia el último detent a la velocidad del encoder, así se mueve
+   * como una rampa entre actualizaciones de loop() y se detiene en el detent: al
+   * soltar el encoder el cabezal no pasa de la posición marcada.
+   */
+  void ScrubBlock(float* out, size_t size) {
+    const float length = static_cast<float>(_loop_length);
+    const size_t edge_next = EdgeNeighbourIndex();
+
+    float pos = _scrub_pos;
+    float vel = _scrub_vel;
+    float target = _scrub_target;
+    const float goal = _scrub_goal;
+    const float max_step = (_scrub_target_vel != 0.0f) ? fabsf(_scrub_target_vel) : INFINITY;
+
+    for (size_t i = 0; i < size; i++) {
+      float delta = goal - target;
+      target += (delta > max_step) ? max_step : (delta < -max_step) ? -max_step : delta;
+      vel += _scrub_w2 * (target - pos) - _scrub_2w * vel;
+      pos += vel;
+
+      float read = fmodf(pos, length);
+      if (read < 0.0f) read += length;
+      if (read >= length) read = 0.0f;
+
+      // Como en una cinta: a velocidad cero no hay sonido
+      float speed_gain = fabsf(vel) * SCRUB_GAIN_PER_SPEED;
+      if (speed_gain > 1.0f) speed_gain = 1.0f;
+
+      out[i] = GetInterpolatedSample(read, edge_next) * speed_gain;
+    }
+
+    _scrub_pos = pos;
+    _scrub_vel = vel;
+    _scrub_target = target;
+
+    float head = fmodf(pos, length);
+    if (head < 0.0f) head += length;
+    _play_head = (head < length) ? head : 0.0f;
+  }
+
   /**
    * @brief Soft clipping con tanh.
    */
@@ -358,11 +1005,12 @@ private:
   /**
    * @brief Obtiene una muestra interpolada del buffer para reproducción suave.
    * @param position Posición flotante dentro del loop (0.0 a _loop_length)
+   * @param edge_next Índice usado como vecino de la última muestra de la región
    * @return Muestra interpolada linealmente entre dos muestras adyacentes
    */
-  float GetInterpolatedSample(float position) {
+  float GetInterpolatedSample(float position, size_t edge_next) {
     size_t idx0 = static_cast<size_t>(position);
-    size_t idx1 = (idx0 + 1) % _loop_length;
+    size_t idx1 = (idx0 + 1 < _loop_length) ? idx0 + 1 : edge_next;
     float frac = position - static_cast<float>(idx0);
     size_t actual_idx0 = (_loop_start + idx0) % _buffer_length;
     size_t actual_idx1 = (_loop_start + idx1) % _buffer_length;
@@ -384,8 +1032,41 @@ private:
   bool _is_recording;
   bool _reverse;
   bool _overdubbing;
+  float _overdub_input_gain = 1.0f;
+
+  // Grabación armada por umbral
+  bool _armed = false;
+  float _arm_threshold = 0.0f;
+  float _preroll[PREROLL_CAPACITY];
+  size_t _preroll_length = 0;
+  size_t _preroll_write = 0;
+  size_t _preroll_fill = 0;
+
+  // Estadísticas de la toma (acumuladas al grabar)
+  ChunkStats* _chunk_stats = nullptr;
+  uint32_t* _silent_bits = nullptr;
+  size_t _chunk_stats_count = 0;
+  bool _last_block_silent = false;
+  float _take_peak = 0.0f;
 
   float _playback_speed;
+
+  // Modos de reproducción
+  PlaybackMode _playback_mode = PLAYBACK_LOOP;
+  float _pingpong_direction = 1.0f;  // +1 ida, -1 vuelta (solo ping-pong)
+  bool _oneshot_done = false;
+  uint32_t _cycles = 0;
+
+  // Scrub (cabezal controlado por el encoder)
+  bool _scrubbing = false;
+  float _scrub_origin = 0.0f;
+  float _scrub_pos = 0.0f;
+  float _scrub_vel = 0.0f;
+  float _scrub_target = 0.0f;
+  float _scrub_goal = 0.0f;           // Posición del último detent
+  float _scrub_target_vel = 0.0f;
+  float _scrub_w2 = 0.0f;
+  float _scrub_2w = 0.0f;
   
   // Quantización rítmica
   bool _quantize = false;
@@ -397,13 +1078,19 @@ private:
   float _inv_crossfade_samples = 0.0f;
   
   static const size_t MAX_UNDO_LEVELS = 3;
-  float* _undo_buffers[MAX_UNDO_LEVELS];
+  float* _undo_buffers[MAX_UNDO_LEVELS + 1];  // Niveles más el snapshot en preparación
   bool _undo_enabled = false;
-  size_t _undo_count = 0;
+  size_t _undo_levels = 0;
+  size_t _undo_count = 0;                      // Búferes del anillo (_undo_levels + 1)
   size_t _undo_write_index = 0;
   size_t _undo_read_index = 0;
   size_t _undo_depth = 0;
   size_t _redo_depth = 0;
+
+  // Snapshot de undo copiado en segundo plano (ver PrepareUndoStep)
+  size_t _prepared_start = 0;
+  size_t _prepared_length = static_cast<size_t>(-1);
+  size_t _prepared_pos = 0;
 };
 
 } // namespace crearttech
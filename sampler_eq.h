@@ -0,0 +1,193 @@
+/**
+ * =====================================================================
+ * sampler_eq.h - 3-Band Parametric EQ (Biquad Cascade)
+ * =====================================================================
+ * Ecualizador de tres bandas como una cascada de biquads (DF2T):
+ * - Low shelf, peaking medio y high shelf, ±12 dB por banda
+ * - Un solo llamado por bloque: arm_biquad_cascade_df2T_f32 con CMSIS-DSP,
+ *   o la misma recursión en C en el host
+ * - Los coeficientes de cada posición de la perilla (0..100) se calculan una
+ *   vez al arrancar; al mover una banda solo se copian 5 valores de la tabla
+ * - Con las tres bandas en 0 dB el bloque no se procesa
+ */
+
+#ifndef SAMPLER_EQ_H
+#define SAMPLER_EQ_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "sampler_dsp_utils.h"
+
+namespace crearttech {
+
+/**
+ * @brief Bandas del ecualizador (orden de la cascada).
+ */
+enum class EqBand : uint8_t {
+  LOW_SHELF,
+  PEAK,
+  HIGH_SHELF,
+  COUNT
+};
+
+static const size_t EQ_BANDS = static_cast<size_t>(EqBand::COUNT);
+static const size_t EQ_KNOB_STEPS = 101;       // Perilla 0..100
+static const uint8_t EQ_KNOB_FLAT = 50;        // 0 dB
+static const float EQ_RANGE_DB = 12.0f;
+static const size_t EQ_COEFFS_PER_STAGE = 5;   // b0, b1, b2, a1, a2 (a con signo de CMSIS)
+
+/**
+ * @brief Coeficientes de todas las posiciones de perilla de cada banda (compartida por
+ * todas las instancias; se llena una vez al arrancar).
+ */
+class EqCoefficientTable {
+public:
+  void Init(float sample_rate) {
+    const float freqs[EQ_BANDS] = {LOW_SHELF_HZ, PEAK_HZ, HIGH_SHELF_HZ};
+    for (size_t band = 0; band < EQ_BANDS; band++) {
+      for (size_t knob = 0; knob < EQ_KNOB_STEPS; knob++) {
+        float* c = _coeffs[band][knob];
+        if (knob == EQ_KNOB_FLAT) {
+          // Identidad exacta: una banda en 0 dB no colorea ni agrega ruido de redondeo
+          c[0] = 1.0f; c[1] = c[2] = c[3] = c[4] = 0.0f;
+          continue;
+        }
+        Design(static_cast<EqBand>(band), freqs[band], KnobToDb(static_cast<uint8_t>(knob)), sample_rate, c);
+      }
+    }
+  }
+
+  const float* Get(EqBand band, uint8_t knob) const {
+    return _coeffs[static_cast<size_t>(band)][knob];
+  }
+
+  static float KnobToDb(uint8_t knob) {
+    return (static_cast<float>(knob) - EQ_KNOB_FLAT) * (EQ_RANGE_DB / EQ_KNOB_FLAT);
+  }
+
+private:
+  static constexpr float LOW_SHELF_HZ = 150.0f;
+  static constexpr float PEAK_HZ = 1000.0f;
+  static constexpr float PEAK_Q = 0.9f;
+  static constexpr float HIGH_SHELF_HZ = 5000.0f;
+
+  /** @brief Fórmulas de RBJ (Audio EQ Cookbook), shelves con pendiente S = 1. */
+  static void Design(EqBand band, float freq, float gain_db, float sample_rate, float* c) {
+    const float A = powf(10.0f, gain_db / 40.0f);
+    const float w0 = 2.0f * static_cast<float>(M_PI) * freq / sample_rate;
+    const float cs = cosf(w0), sn = sinf(w0);
+    float b0, b1, b2, a0, a1, a2;
+    if (band == EqBand::PEAK) {
+      const float alpha = sn / (2.0f * PEAK_Q);
+      b0 = 1.0f + alpha * A; b1 = -2.0f * cs; b2 = 1.0f - alpha * A;
+      a0 = 1.0f + alpha / A; a1 = -2.0f * cs; a2 = 1.0f - alpha / A;
+    } else {
+      const float two_sqrt_a_alpha = 2.0f * sqrtf(A) * (sn * 0.5f * sqrtf(2.0f));
+      if (band == EqBand::LOW_SHELF) {
+        b0 = A * ((A + 1.0f) - (A - 1.0f) * cs + two_sqrt_a_alpha);
+        b1 = 2.0f * A * ((A - 1.0f) - (A + 1.0f) * cs);
+        b2 = A * ((A + 1.0f) - (A - 1.0f) * cs - two_sqrt_a_alpha);
+        a0 = (A + 1.0f) + (A - 1.0f) * cs + two_sqrt_a_alpha;
+        a1 = -2.0f * ((A - 1.0f) + (A + 1.0f) * cs);
+        a2 = (A + 1.0f) + (A - 1.0f) * cs - two_sqrt_a_alpha;
+      } else {
+        b0 = A * ((A + 1.0f) + (A - 1.0f) * cs + two_sqrt_a_alpha);
+        b1 = -2.0f * A * ((A - 1.0f) + (A + 1.0f) * cs);
+        b2 = A * ((A + 1.0f) + (A - 1.0f) * cs - two_sqrt_a_alpha);
+        a0 = (A + 1.0f) - (A - 1.0f) * cs + two_sqrt_a_alpha;
+        a1 = 2.0f * ((A - 1.0f) - (A + 1.0f) * cs);
+        a2 = (A + 1.0f) - (A - 1.0f) * cs - two_sqrt_a_alpha;
+      }
+    }
+    // CMSIS espera y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] + a1 y[n-1] + a2 y[n-2]
+    c[0] = b0 / a0; c[1] = b1 / a0; c[2] = b2 / a0;
+    c[3] = -a1 / a0; c[4] = -a2 / a0;
+  }
+
+  float _coeffs[EQ_BANDS][EQ_KNOB_STEPS][EQ_COEFFS_PER_STAGE];
+};
+
+/**
+ * @brief Cascada de tres biquads con estado propio (una instancia por cadena de efectos).
+ */
+class ThreeBandEq {
+public:
+  void Init(const EqCoefficientTable* table) {
+    _table = table;
+    for (size_t band = 0; band < EQ_BANDS; band++) {
+      _knobs[band] = 0xFF;  // Fuerza la copia
+      SetBand(static_cast<EqBand>(band), EQ_KNOB_FLAT);
+    }
+    #if USE_CMSIS_DSP
+    arm_biquad_cascade_df2T_init_f32(&_instance, EQ_BANDS, _coeffs, _state);
+    #endif
+    Reset();
+  }
+
+  /** @brief Borra el estado de los filtros (no los coeficientes). */
+  void Reset() {
+    memset(_state, 0, sizeof(_state));
+  }
+
+  /**
+   * @brief Posición de la perilla de una banda; copia coeficientes solo si cambió.
+   * Al salir de plano el estado empieza en cero: lo que quedó era de la última vez
+   * que estuvo activo, aunque Process() no se haya llamado mientras estaba plano.
+   */
+  void SetBand(EqBand band, uint8_t knob) {
+    size_t b = static_cast<size_t>(band);
+    if (knob >= EQ_KNOB_STEPS) knob = EQ_KNOB_STEPS - 1;
+    if (knob == _knobs[b]) return;
+    bool was_flat = IsFlat();
+    _knobs[b] = knob;
+    memcpy(_coeffs + b * EQ_COEFFS_PER_STAGE, _table->Get(band, knob), sizeof(float) * EQ_COEFFS_PER_STAGE);
+    if (was_flat && !IsFlat()) Reset();
+  }
+
+  uint8_t GetBand(EqBand band) const { return _knobs[static_cast<size_t>(band)]; }
+
+  bool IsFlat() const {
+    for (size_t band = 0; band < EQ_BANDS; band++) {
+      if (_knobs[band] != EQ_KNOB_FLAT) return false;
+    }
+    return true;
+  }
+
+  /** @brief Filtra un bloque in-place. Plano: no hace nada. */
+  void Process(float* buffer, size_t size) {
+    if (IsFlat()) return;
+    #if USE_CMSIS_DSP
+    arm_biquad_cascade_df2T_f32(&_instance, buffer, buffer, static_cast<uint32_t>(size));
+    #else
+    for (size_t stage = 0; stage < EQ_BANDS; stage++) {
+      const float* c = _coeffs + stage * EQ_COEFFS_PER_STAGE;
+      const float b0 = c[0], b1 = c[1], b2 = c[2], a1 = c[3], a2 = c[4];
+      float d1 = _state[2 * stage], d2 = _state[2 * stage + 1];
+      for (size_t i = 0; i < size; i++) {
+        float x = buffer[i];
+        float y = b0 * x + d1;
+        d1 = b1 * x + a1 * y + d2;
+        d2 = b2 * x + a2 * y;
+        buffer[i] = y;
+      }
+      _state[2 * stage] = d1;
+      _state[2 * stage + 1] = d2;
+    }
+    #endif
+  }
+
+private:
+  const EqCoefficientTable* _table = nullptr;
+  float _coeffs[EQ_BANDS * EQ_COEFFS_PER_STAGE];
+  float _state[2 * EQ_BANDS];
+  uint8_t _knobs[EQ_BANDS];
+  #if USE_CMSIS_DSP
+  arm_biquad_cascade_df2T_instance_f32 _instance;
+  #endif
+};
+
+} // namespace crearttech
+
+#endif // SAMPLER_EQ_H
@@ -0,0 +1,160 @@
+/**
+ * =====================================================================
+ * sampler_fft.h - Real FFT Wrapper (CMSIS-DSP / fallback)
+ * =====================================================================
+ * FFT real de tamaño fijo con el formato empaquetado de CMSIS:
+ *   [Re(X0), Re(X N/2), Re(X1), Im(X1), ..., Re(X N/2-1), Im(X N/2-1)]
+ * En el target usa arm_rfft_fast_f32; sin CMSIS usa una FFT compleja
+ * radix-2 (más lenta, pensada solo para compilar y probar en host).
+ */
+
+#ifndef SAMPLER_FFT_H
+#define SAMPLER_FFT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "sampler_dsp_utils.h"
+
+namespace crearttech {
+
+/**
+ * @brief FFT real de N puntos.
+ * @tparam N Tamaño de la FFT (potencia de 2, 32 a 4096)
+ */
+template <size_t N>
+class RealFFT {
+  static_assert((N & (N - 1)) == 0 && N >= 32 && N <= 4096, "RealFFT size must be a power of 2 in [32, 4096]");
+
+public:
+  /** @brief Prepara tablas e instancia (llamar una vez, fuera del audio callback). */
+  void Init() {
+    #if USE_CMSIS_DSP
+      arm_rfft_fast_init_f32(&_instance, static_cast<uint16_t>(N));
+    #else
+      for (size_t i = 0; i < N / 2; i++) {
+        float angle = -2.0f * static_cast<float>(M_PI) * static_cast<float>(i) / static_cast<float>(N);
+        _cos[i] = cosf(angle);
+        _sin[i] = sinf(angle);
+      }
+    #endif
+  }
+
+  /**
+   * @brief Transformada directa.
+   * @param in N muestras reales (se usa como área de trabajo y queda modificado)
+   * @param out N floats en formato empaquetado
+   */
+  void Forward(float* in, float* out) {
+    #if USE_CMSIS_DSP
+      arm_rfft_fast_f32(&_instance, in, out, 0);
+    #else
+      for (size_t i = 0; i < N; i++) {
+        _work[2 * i] = in[i];
+        _work[2 * i + 1] = 0.0f;
+      }
+      ComplexFFT(_work);
+      out[0] = _work[0];
+      out[1] = _work[N];
+      for (size_t k = 1; k < N / 2; k++) {
+        out[2 * k] = _work[2 * k];
+        out[2 * k + 1] = _work[2 * k + 1];
+      }
+    #endif
+  }
+
+  /**
+   * @brief Transformada inversa (incluye la escala 1/N).
+   * @param in N floats en formato empaquetado (queda modificado)
+   * @param out N muestras reales
+   */
+  void Inverse(float* in, float* out) {
+    #if USE_CMSIS_DSP
+      arm_rfft_fast_f32(&_instance, in, out, 1);
+    #else
+      // Reconstruir el espectro hermítico y conjugar para usar la FFT directa
+      _work[0] = in[0];
+      _work[1] = 0.0f;
+      _work[N] = in[1];
+      _work[N + 1] = 0.0f;
+      for (size_t k = 1; k < N / 2; k++) {
+        _work[2 * k] = in[2 * k];
+        _work[2 * k + 1] = -in[2 * k + 1];
+        _work[2 * (N - k)] = in[2 * k];
+        _work[2 * (N - k) + 1] = in[2 * k + 1];
+      }
+      ComplexFFT(_work);
+      const float scale = 1.0f / static_cast<float>(N);
+      for (size_t i = 0; i < N; i++) out[i] = _work[2 * i] * scale;
+    #endif
+  }
+
+  /**
+   * @brief Magnitudes de los bins 0..N/2 a partir del formato empaquetado.
+   * @param spectrum N floats empaquetados
+   * @param mag N/2 + 1 magnitudes
+   */
+  static void Magnitudes(const float* spectrum, float* mag) {
+    mag[0] = fabsf(spectrum[0]);
+    mag[N / 2] = fabsf(spectrum[1]);
+    #if USE_CMSIS_DSP
+      arm_cmplx_mag_f32(spectrum + 2, mag + 1, static_cast<uint32_t>(N / 2 - 1));
+    #else
+      for (size_t k = 1; k < N / 2; k++) {
+        float re = spectrum[2 * k];
+        float im = spectrum[2 * k + 1];
+        mag[k] = sqrtf(re * re + im * im);
+      }
+    #endif
+  }
+
+private:
+  #if USE_CMSIS_DSP
+    arm_rfft_fast_instance_f32 _instance;
+  #else
+    /** @brief FFT compleja radix-2 in-place (datos intercalados re/im). */
+    void ComplexFFT(float* data) {
+      // Reordenamiento bit-reverse
+      for (size_t i = 1, j = 0; i < N; i++) {
+        size_t bit = N >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) {
+          float tr = data[2 * i], ti = data[2 * i + 1];
+          data[2 * i] = data[2 * j];
+          data[2 * i + 1] = data[2 * j + 1];
+          data[2 * j] = tr;
+          data[2 * j + 1] = ti;
+        }
+      }
+
+      for (size_t len = 2; len <= N; len <<= 1) {
+        size_t half = len >> 1;
+        size_t twiddle_step = N / len;
+        for (size_t start = 0; start < N; start += len) {
+          for (size_t k = 0; k < half; k++) {
+            float wr = _cos[k * twiddle_step];
+            float wi = _sin[k * twiddle_step];
+            size_t a = 2 * (start + k);
+            size_t b = 2 * (start + k + half);
+            float xr = data[b] * wr - data[b + 1] * wi;
+            float xi = data[b] * wi + data[b + 1] * wr;
+            data[b] = data[a] - xr;
+            data[b + 1] = data[a + 1] - xi;
+            data[a] += xr;
+            data[a + 1] += xi;
+          }
+        }
+      }
+    }
+
+    float _cos[N / 2];
+    float _sin[N / 2];
+    float _work[2 * N];
+  #endif
+};
+
+} // namespace crearttech
+
+#endif // SAMPLER_FFT_H
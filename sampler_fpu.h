@@ -0,0 +1,111 @@
+/**
+ * =====================================================================
+ * sampler_fpu.h - Denormal Handling (Flush-to-Zero)
+ * =====================================================================
+ * Las colas del delay, la reverb y los estados de los filtros decaen hacia
+ * números subnormales. En x86 cada operación subnormal cuesta cientos de
+ * ciclos; en el Cortex-M7 el modo FZ los convierte en cero.
+ * - Target: bit FZ de FPSCR (hilo actual) y de FPDSCR (valor con el que
+ *   arrancan las interrupciones, incluido el audio callback)
+ * - Host x86: bits FTZ y DAZ de MXCSR; host AArch64: bit FZ de FPCR
+ */
+
+#ifndef SAMPLER_FPU_H
+#define SAMPLER_FPU_H
+
+#include <stdint.h>
+
+#if defined(__SSE__) || defined(_M_X64)
+  #include <xmmintrin.h>
+#endif
+
+namespace crearttech {
+
+/**
+ * @brief Lectura y escritura del modo de subnormales de la FPU.
+ */
+class FloatingPointMode {
+public:
+  /**
+   * @brief Activa flush-to-zero para el hilo actual y, en el target, para
+   * todas las interrupciones futuras (llamar en setup() antes de StartAudio).
+   */
+  static void EnableFlushToZero() {
+    SetFlushToZero(true);
+    #if defined(__arm__) && defined(__VFP_FP__) && !defined(__SOFTFP__)
+      volatile uint32_t* fpdscr = reinterpret_cast<volatile uint32_t*>(0xE000EF3C);
+      *fpdscr |= ARM_FZ_BIT;
+    #endif
+  }
+
+  /** @brief Indica si flush-to-zero está activo en el contexto actual. */
+  static bool IsFlushToZeroEnabled() {
+    #if defined(__arm__) && defined(__VFP_FP__) && !defined(__SOFTFP__)
+      return (ReadFPSCR() & ARM_FZ_BIT) != 0;
+    #elif defined(__aarch64__)
+      return (ReadFPCR() & ARM_FZ_BIT) != 0;
+    #elif defined(__SSE__) || defined(_M_X64)
+      return (_mm_getcsr() & X86_FTZ_DAZ_BITS) == X86_FTZ_DAZ_BITS;
+    #else
+      return false;
+    #endif
+  }
+
+  /** @brief Activa o desactiva flush-to-zero en el contexto actual. */
+  static void SetFlushToZero(bool enable) {
+    #if defined(__arm__) && defined(__VFP_FP__) && !defined(__SOFTFP__)
+      uint32_t fpscr = ReadFPSCR();
+      WriteFPSCR(enable ? (fpscr | ARM_FZ_BIT) : (fpscr & ~ARM_FZ_BIT));
+    #elif defined(__aarch64__)
+      uint64_t fpcr = ReadFPCR();
+      WriteFPCR(enable ? (fpcr | ARM_FZ_BIT) : (fpcr & ~static_cast<uint64_t>(ARM_FZ_BIT)));
+    #elif defined(__SSE__) || defined(_M_X64)
+      uint32_t csr = _mm_getcsr();
+      _mm_setcsr(enable ? (csr | X86_FTZ_DAZ_BITS) : (csr & ~X86_FTZ_DAZ_BITS));
+    #else
+      (void)enable;
+    #endif
+  }
+
+private:
+  static const uint32_t ARM_FZ_BIT = 1u << 24;
+  static const uint32_t X86_FTZ_DAZ_BITS = 0x8040u;  // FTZ (bit 15) | DAZ (bit 6)
+
+  #if defined(__arm__) && defined(__VFP_FP__) && !defined(__SOFTFP__)
+    static uint32_t ReadFPSCR() {
+      uint32_t value;
+      __asm__ volatile("vmrs %0, fpscr" : "=r"(value));
+      return value;
+    }
+    static void WriteFPSCR(uint32_t value) { __asm__ volatile("vmsr fpscr, %0" : : "r"(value)); }
+  #elif defined(__aarch64__)
+    static uint64_t ReadFPCR() {
+      uint64_t value;
+      __asm__ volatile("mrs %0, fpcr" : "=r"(value));
+      return value;
+    }
+    static void WriteFPCR(uint64_t value) { __asm__ volatile("msr fpcr, %0" : : "r"(value)); }
+  #endif
+};
+
+/**
+ * @brief Guarda RAII: fija el modo flush-to-zero y restaura el anterior al salir.
+ * Pensado para el hilo de render en host (o para comparar ambos modos en el target).
+ */
+class ScopedFlushToZero {
+public:
+  explicit ScopedFlushToZero(bool enable = true) : _previous(FloatingPointMode::IsFlushToZeroEnabled()) {
+    FloatingPointMode::SetFlushToZero(enable);
+  }
+  ~ScopedFlushToZero() { FloatingPointMode::SetFlushToZero(_previous); }
+
+  ScopedFlushToZero(const ScopedFlushToZero&) = delete;
+  ScopedFlushToZero& operator=(const ScopedFlushToZero&) = delete;
+
+private:
+  bool _previous;
+};
+
+} // namespace crearttech
+
+#endif // SAMPLER_FPU_H
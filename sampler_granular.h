@@ -0,0 +1,330 @@
+/**
+ * =====================================================================
+ * sampler_granular.h - Granular Playback Engine
+ * =====================================================================
+ * Reproduce el loop grabado como una nube de granos:
+ * - Pool fijo de granos (sin memoria dinámica en el audio callback)
+ * - Ventana Hann leída desde una tabla precalculada
+ * - Acumulación por bloque: cada grano activo suma su tramo del bloque
+ * - Número máximo de granos ajustado según la carga de CPU
+ */
+
+#ifndef SAMPLER_GRANULAR_H
+#define SAMPLER_GRANULAR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+namespace crearttech {
+
+/**
+ * @brief Parámetros que loop() envía al motor (ver LooperCommandType::GRAIN_PARAM).
+ */
+enum class GrainParam : uint8_t {
+  POSITION,
+  SPRAY,
+  SIZE,
+  DENSITY,
+  PITCH,
+  COUNT
+};
+
+/**
+ * @brief Motor granular sobre el búfer del looper.
+ */
+class GranularEngine {
+public:
+  static const size_t MAX_GRAINS = 24;
+  static const size_t WINDOW_TABLE_SIZE = 512;
+
+  /**
+   * @brief Prepara el motor y precalcula la tabla de ventana.
+   * @param sample_rate Sample rate del sistema
+   */
+  void Init(float sample_rate) {
+    _sample_rate = sample_rate;
+
+    // Tabla Hann con muestras de guarda para la interpolación
+    for (size_t i = 0; i < WINDOW_TABLE_SIZE + 2; i++) {
+      float phase = static_cast<float>(i) / static_cast<float>(WINDOW_TABLE_SIZE);
+      _window[i] = 0.5f - 0.5f * cosf(2.0f * static_cast<float>(M_PI) * phase);
+    }
+
+    for (size_t i = 0; i < MAX_GRAINS; i++) _grains[i].active = false;
+
+    _buffer = nullptr;
+    _buffer_length = 0;
+    _region_start = 0;
+    _region_length = 0;
+    _max_active = MAX_GRAINS;
+    _budget_hold = 0;
+    _samples_to_next_grain = 0.0f;
+    _grain_samples_last_block = 0;
+
+    SetPosition(0.0f);
+    SetSpray(0.1f);
+    SetGrainSize(80.0f);
+    SetDensity(20.0f);
+    SetPitch(1.0f);
+  }
+
+  /**
+   * @brief Define el búfer fuente y la región de la que se toman los granos.
+   * Solo debe llamarse desde el audio callback (ver LooperCommandType::LOOP_REGION).
+   */
+  void SetSource(const float* buffer, size_t buffer_length, size_t region_start, size_t region_length) {
+    if (region_start >= buffer_length) region_start = 0;
+    if (region_start + region_length > buffer_length) region_length = buffer_length - region_start;
+
+    _buffer = buffer;
+    _buffer_length = buffer_length;
+    _region_start = region_start;
+    _region_length = region_length;
+  }
+
+  /** @brief Posición central de los granos dentro de la región (0.0 a 1.0). */
+  void SetPosition(float position) { _position = Clamp01(position); }
+
+  /** @brief Dispersión aleatoria de la posición (0.0 a 1.0 de la región). */
+  void SetSpray(float spray) { _spray = Clamp01(spray); }
+
+  /** @brief Duración de cada grano en milisegundos. */
+  void SetGrainSize(float size_ms) {
+    if (size_ms < MIN_GRAIN_MS) size_ms = MIN_GRAIN_MS;
+    if (size_ms > MAX_GRAIN_MS) size_ms = MAX_GRAIN_MS;
+    _grain_size_samples = size_ms * 0.001f * _sample_rate;
+    UpdateNormalization();
+  }
+
+  /** @brief Granos nuevos por segundo. */
+  void SetDensity(float grains_per_second) {
+    if (grains_per_second < MIN_DENSITY) grains_per_second = MIN_DENSITY;
+    if (grains_per_second > MAX_DENSITY) grains_per_second = MAX_DENSITY;
+    _spawn_interval = _sample_rate / grains_per_second;
+    UpdateNormalization();
+  }
+
+  /** @brief Relación de pitch de los granos (1.0 = original). */
+  void SetPitch(float ratio) { _pitch = ratio; }
+
+  /** @brief Aplica un parámetro recibido por la cola de comandos. */
+  void SetParam(GrainParam param, float value) {
+    switch (param) {
+      case GrainParam::POSITION: SetPosition(value); break;
+      case GrainParam::SPRAY: SetSpray(value); break;
+      case GrainParam::SIZE: SetGrainSize(value); break;
+      case GrainParam::DENSITY: SetDensity(value); break;
+      case GrainParam::PITCH: SetPitch(value); break;
+      default: break;
+    }
+  }
+
+  /**
+   * @brief Ajusta el número máximo de granos según la carga de CPU.
+   * Reduce un grano si la carga supera el umbral alto y recupera uno si hay
+   * margen; los granos que ya suenan terminan su ventana, así no hay clicks.
+   * Después de un cambio espera lo que dura un grano (y al menos lo que tarda
+   * el promedio de la carga en asentarse) antes del siguiente: hasta entonces
+   * la carga medida todavía no refleja el ajuste anterior.
+   * @param cpu_load Carga promedio del callback (0.0 a 1.0)
+   * @param size Muestras del bloque
+   */
+  void UpdateGrainBudget(float cpu_load, size_t size) {
+    if (_budget_hold > size) {
+      _budget_hold -= size;
+      return;
+    }
+    _budget_hold = 0;
+
+    size_t previous = _max_active;
+    if (cpu_load > LOAD_HIGH && _max_active > 1) {
+      _max_active--;
+    } else if (cpu_load < LOAD_LOW && _max_active < MAX_GRAINS) {
+      _max_active++;
+    }
+    if (_max_active != previous) {
+      float settle = BUDGET_SETTLE_MS * 0.001f * _sample_rate;
+      _budget_hold = static_cast<size_t>((_grain_size_samples > settle) ? _grain_size_samples : settle);
+    }
+  }
+
+  /** @brief Fija el límite de granos sin esperar (repetición de una sesión capturada). */
+  void SetMaxActiveGrains(size_t max_active) {
+    if (max_active < 1) max_active = 1;
+    if (max_active > MAX_GRAINS) max_active = MAX_GRAINS;
+    _max_active = max_active;
+  }
+
+  /**
+   * @brief Genera un bloque granular (sobrescribe out).
+   * @param out Bloque de salida
+   * @param size Número de muestras
+   */
+  void ProcessBlock(float* out, size_t size) {
+    memset(out, 0, sizeof(float) * size);
+    _grain_samples_last_block = 0;
+    if (_buffer == nullptr || _region_length < 2) return;
+
+    // Disparo de granos con offset exacto dentro del bloque
+    float block_end = static_cast<float>(size);
+    while (_samples_to_next_grain < block_end) {
+      SpawnGrain(static_cast<size_t>(_samples_to_next_grain));
+      _samples_to_next_grain += _spawn_interval;
+    }
+    _samples_to_next_grain -= block_end;
+
+    // Acumulación: cada grano suma su tramo completo del bloque
+    for (size_t g = 0; g < MAX_GRAINS; g++) {
+      if (_grains[g].active) AccumulateGrain(_grains[g], out, size);
+    }
+
+    const float gain = _normalization;
+    for (size_t i = 0; i < size; i++) out[i] *= gain;
+  }
+
+  /** @brief Número de granos sonando actualmente. */
+  size_t GetActiveGrains() const {
+    size_t count = 0;
+    for (size_t g = 0; g < MAX_GRAINS; g++) {
+      if (_grains[g].active) count++;
+    }
+    return count;
+  }
+
+  /** @brief Límite actual de granos (ajustado por la carga de CPU). */
+  size_t GetMaxActiveGrains() const { return _max_active; }
+
+  /** @brief Muestras-grano calculadas en el último bloque (para medir ciclos por grano). */
+  size_t GetGrainSamplesLastBlock() const { return _grain_samples_last_block; }
+
+  /** @brief Silencia todos los granos inmediatamente. */
+  void Reset() {
+    for (size_t g = 0; g < MAX_GRAINS; g++) _grains[g].active = false;
+    _samples_to_next_grain = 0.0f;
+  }
+
+private:
+  static constexpr float MIN_GRAIN_MS = 10.0f;
+  static constexpr float MAX_GRAIN_MS = 500.0f;
+  static constexpr float MIN_DENSITY = 1.0f;
+  static constexpr float MAX_DENSITY = 200.0f;
+  static constexpr float LOAD_HIGH = 0.80f;
+  static constexpr float LOAD_LOW = 0.60f;
+  static constexpr float BUDGET_SETTLE_MS = 100.0f;  // Promedio de la carga del profiler (~100 bloques)
+
+  struct Grain {
+    bool active;
+    size_t delay;          // Muestras de espera dentro del bloque actual
+    float read_pos;        // Posición de lectura relativa a la región
+    float window_phase;    // Posición en la tabla de ventana
+    float window_inc;      // Avance de la ventana por muestra
+  };
+
+  static float Clamp01(float x) { return x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x); }
+
+  /** @brief Generador pseudoaleatorio rápido en [-1, 1). */
+  float RandomBipolar() {
+    _rng_state = _rng_state * 1664525u + 1013904223u;
+    return static_cast<float>(static_cast<int32_t>(_rng_state)) * (1.0f / 2147483648.0f);
+  }
+
+  /** @brief La suma de granos solapados crece con densidad * tamaño; compensar en potencia. */
+  void UpdateNormalization() {
+    if (_spawn_interval <= 0.0f) return;
+    float overlap = _grain_size_samples / _spawn_interval;
+    _normalization = (overlap > 1.0f) ? 1.0f / sqrtf(overlap) : 1.0f;
+  }
+
+  void SpawnGrain(size_t offset_in_block) {
+    size_t active = 0;
+    Grain* free_grain = nullptr;
+    for (size_t g = 0; g < MAX_GRAINS; g++) {
+      if (_grains[g].active) active++;
+      else if (free_grain == nullptr) free_grain = &_grains[g];
+    }
+    if (free_grain == nullptr || active >= _max_active) return;
+
+    const float length = static_cast<float>(_region_length);
+    float pos = (_position + _spray * 0.5f * RandomBipolar()) * length;
+    pos = fmodf(pos, length);
+    if (pos < 0.0f) pos += length;
+
+    free_grain->active = true;
+    free_grain->delay = offset_in_block;
+    free_grain->read_pos = pos;
+    free_grain->window_phase = 0.0f;
+    free_grain->window_inc = static_cast<float>(WINDOW_TABLE_SIZE) / _grain_size_samples;
+  }
+
+  void AccumulateGrain(Grain& grain, float* out, size_t size) {
+    const float length = static_cast<float>(_region_length);
+    const float table_end = static_cast<float>(WINDOW_TABLE_SIZE);
+    const float* src = _buffer + _region_start;
+    const float step = _pitch;
+
+    size_t start = grain.delay;
+    grain.delay = 0;
+
+    // Muestras restantes de la ventana: el bucle interno no comprueba el fin del grano
+    size_t remaining = static_cast<size_t>((table_end - grain.window_phase) / grain.window_inc);
+    size_t end = size;
+    bool finishes = false;
+    if (start + remaining < end) {
+      end = start + remaining;
+      finishes = true;
+    }
+
+    float pos = grain.read_pos;
+    float phase = grain.window_phase;
+    for (size_t i = start; i < end; i++) {
+      size_t w_idx = static_cast<size_t>(phase);
+      float w_frac = phase - static_cast<float>(w_idx);
+      float w = _window[w_idx] + w_frac * (_window[w_idx + 1] - _window[w_idx]);
+
+      size_t s_idx = static_cast<size_t>(pos);
+      size_t s_next = (s_idx + 1 < _region_length) ? s_idx + 1 : 0;
+      float s_frac = pos - static_cast<float>(s_idx);
+      float s = src[s_idx] + s_frac * (src[s_next] - src[s_idx]);
+
+      out[i] += s * w;
+
+      phase += grain.window_inc;
+      pos += step;
+      if (pos >= length) pos -= length;
+      if (pos < 0.0f) pos += length;
+    }
+
+    _grain_samples_last_block += end - start;
+    grain.read_pos = pos;
+    grain.window_phase = phase;
+    if (finishes) grain.active = false;
+  }
+
+  float _window[WINDOW_TABLE_SIZE + 2];
+  Grain _grains[MAX_GRAINS];
+
+  const float* _buffer = nullptr;
+  size_t _buffer_length = 0;
+  size_t _region_start = 0;
+  size_t _region_length = 0;
+
+  float _sample_rate = 48000.0f;
+  float _position = 0.0f;
+  float _spray = 0.0f;
+  float _grain_size_samples = 3840.0f;
+  float _spawn_interval = 2400.0f;
+  float _pitch = 1.0f;
+  float _normalization = 1.0f;
+
+  size_t _max_active = MAX_GRAINS;
+  size_t _budget_hold = 0;     // Muestras hasta el próximo ajuste del límite
+  float _samples_to_next_grain = 0.0f;
+  size_t _grain_samples_last_block = 0;
+  uint32_t _rng_state = 22222u;
+};
+
+} // namespace crearttech
+
+#endif // SAMPLER_GRANULAR_H
@@ -0,0 +1,180 @@
+/**
+ * =====================================================================
+ * sampler_jobs.h - Cooperative Background Job Scheduler
+ * =====================================================================
+ * Trabajo pesado fuera del audio callback (copias de undo, limpieza de
+ * búferes, reescaneo de la forma de onda) repartido en porciones:
+ * - Cada trabajo procesa como máximo N muestras por porción y se reanuda
+ * - El trabajo de mayor prioridad pendiente corre primero
+ * - loop() le da al planificador un presupuesto de ciclos por iteración,
+ *   así la lectura de botones y encoders nunca queda bloqueada
+ */
+
+#ifndef SAMPLER_JOBS_H
+#define SAMPLER_JOBS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sampler_profiler.h"
+
+namespace crearttech {
+
+/**
+ * @brief Prioridad de un trabajo (menor valor = más urgente).
+ */
+enum class JobPriority : uint8_t {
+  INTERACTIVE,     // Necesario para la próxima acción del usuario (ej. snapshot de undo)
+  DISPLAY_UPDATE,  // Visible en pantalla (ej. forma de onda)
+  MAINTENANCE      // Mantenimiento (ej. limpiar búferes)
+};
+
+/**
+ * @brief Trabajo reanudable.
+ */
+class Job {
+public:
+  virtual ~Job() {}
+
+  /**
+   * @brief Procesa una porción del trabajo.
+   * @param max_samples Máximo de muestras a procesar en esta porción
+   * @return true cuando el trabajo terminó
+   */
+  virtual bool Step(size_t max_samples) = 0;
+
+  /** @brief Avance del trabajo (0.0 a 1.0). */
+  virtual float GetProgress() const = 0;
+};
+
+/**
+ * @brief Planificador cooperativo con cola fija de trabajos.
+ * @tparam MAX_JOBS Número máximo de trabajos pendientes
+ */
+template <size_t MAX_JOBS>
+class JobScheduler {
+public:
+  /**
+   * @param slice_samples Muestras por porción (acota el tiempo de cada Step)
+   */
+  explicit JobScheduler(size_t slice_samples = 4096) : _slice_samples(slice_samples) {
+    for (size_t i = 0; i < MAX_JOBS; i++) _slots[i].job = nullptr;
+  }
+
+  /**
+   * @brief Encola un trabajo; si ya estaba pendiente solo actualiza su prioridad.
+   * @return false si la cola está llena
+   */
+  bool Submit(Job* job, JobPriority priority) {
+    Slot* free_slot = nullptr;
+    for (size_t i = 0; i < MAX_JOBS; i++) {
+      if (_slots[i].job == job) {
+        _slots[i].priority = priority;
+        return true;
+      }
+      if (_slots[i].job == nullptr && free_slot == nullptr) free_slot = &_slots[i];
+    }
+    if (free_slot == nullptr) return false;
+    free_slot->job = job;
+    free_slot->priority = priority;
+    free_slot->sequence = _next_sequence++;
+    return true;
+  }
+
+  /** @brief Retira un trabajo pendiente sin terminarlo. */
+  void Cancel(Job* job) {
+    for (size_t i = 0; i < MAX_JOBS; i++) {
+      if (_slots[i].job == job) _slots[i].job = nullptr;
+    }
+    if (_active == job) _active = nullptr;
+  }
+
+  /** @brief Indica si un trabajo sigue pendiente. */
+  bool IsPending(const Job* job) const {
+    for (size_t i = 0; i < MAX_JOBS; i++) {
+      if (_slots[i].job == job) return true;
+    }
+    return false;
+  }
+
+  /**
+   * @brief Termina un trabajo de inmediato (cuando la acción del usuario lo necesita ya).
+   */
+  void Finish(Job* job) {
+    if (!IsPending(job)) return;
+    while (!job->Step(_slice_samples)) {}
+    Cancel(job);
+  }
+
+  /**
+   * @brief Ejecuta porciones hasta agotar el presupuesto (llamar una vez por loop()).
+   * Siempre ejecuta al menos una porción si hay trabajo pendiente.
+   * @param budget_cycles Ciclos disponibles en esta iteración
+   */
+  void Run(uint32_t budget_cycles) {
+    uint32_t start = CycleCounter::Now();
+    do {
+      Slot* slot = NextSlot();
+      if (slot == nullptr) break;
+
+      uint32_t slice_start = CycleCounter::Now();
+      bool done = slot->job->Step(_slice_samples);
+      uint32_t slice_cycles = CycleCounter::Now() - slice_start;
+      if (slice_cycles > _max_slice_cycles) _max_slice_cycles = slice_cycles;
+
+      _active = slot->job;
+      if (done) {
+        slot->job = nullptr;
+        _active = nullptr;
+        _completed++;
+      }
+    } while (CycleCounter::Now() - start < budget_cycles);
+  }
+
+  /** @brief Hay trabajos pendientes. */
+  bool IsBusy() const {
+    for (size_t i = 0; i < MAX_JOBS; i++) {
+      if (_slots[i].job != nullptr) return true;
+    }
+    return false;
+  }
+
+  /** @brief Avance del trabajo en curso (0.0 si no hay ninguno empezado). */
+  float GetActiveProgress() const { return (_active != nullptr) ? _active->GetProgress() : 0.0f; }
+
+  /** @brief Porción más larga medida (en ciclos), para ajustar slice_samples. */
+  uint32_t GetMaxSliceCycles() const { return _max_slice_cycles; }
+
+  /** @brief Trabajos terminados desde el arranque. */
+  uint32_t GetCompletedJobs() const { return _completed; }
+
+private:
+  struct Slot {
+    Job* job;
+    JobPriority priority;
+    uint32_t sequence;  // Orden de llegada dentro de la misma prioridad
+  };
+
+  Slot* NextSlot() {
+    Slot* best = nullptr;
+    for (size_t i = 0; i < MAX_JOBS; i++) {
+      Slot& s = _slots[i];
+      if (s.job == nullptr) continue;
+      if (best == nullptr || s.priority < best->priority ||
+          (s.priority == best->priority && static_cast<int32_t>(s.sequence - best->sequence) < 0)) {
+        best = &s;
+      }
+    }
+    return best;
+  }
+
+  Slot _slots[MAX_JOBS];
+  size_t _slice_samples;
+  uint32_t _next_sequence = 0;
+  Job* _active = nullptr;
+  uint32_t _max_slice_cycles = 0;
+  uint32_t _completed = 0;
+};
+
+} // namespace crearttech
+
+#endif // SAMPLER_JOBS_H
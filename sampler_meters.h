@@ -0,0 +1,236 @@
+/**
+ * =====================================================================
+ * sampler_meters.h - Level Metering (Peak / RMS / Short-term LUFS)
+ * =====================================================================
+ * Medidores calculados en el audio callback, un bloque a la vez:
+ * - Pico y RMS con DSPUtils::PeakAndSumSquares (con CMSIS-DSP, absmax y power
+ *   vectorizados; en el host, una sola pasada)
+ * - Loudness K-weighted de corto plazo (3 s, ITU-R BS.1770) con dos biquads
+ * - Publicación por seqlock: la UI lee sin deshabilitar interrupciones
+ */
+
+#ifndef SAMPLER_METERS_H
+#define SAMPLER_METERS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include <atomic>
+#include "sampler_dsp_utils.h"
+
+namespace crearttech {
+
+/**
+ * @brief Lecturas publicadas por el audio callback.
+ */
+struct MeterReading {
+  float input_peak;    // Pico de entrada (lineal, con caída balística)
+  float input_rms;     // RMS de entrada (lineal, ~300 ms)
+  float output_peak;   // Pico de salida
+  float output_rms;    // RMS de salida
+  float output_lufs;   // Loudness de corto plazo de la salida (LUFS)
+};
+
+/**
+ * @brief Snapshot protegido por seqlock: un escritor (audio), lectores (UI).
+ * El escritor nunca espera; el lector reintenta si el escritor lo interrumpió.
+ */
+template <typename T>
+class SeqlockSnapshot {
+public:
+  SeqlockSnapshot() : _sequence(0), _value() {}
+
+  /** @brief Publica un valor nuevo (solo el audio callback). */
+  void Write(const T& value) {
+    uint32_t seq = _sequence.load(std::memory_order_relaxed);
+    _sequence.store(seq + 1, std::memory_order_relaxed);      // Impar: escritura en curso
+    std::atomic_thread_fence(std::memory_order_release);
+    _value = value;
+    std::atomic_thread_fence(std::memory_order_release);
+    _sequence.store(seq + 2, std::memory_order_relaxed);      // Par: valor consistente
+  }
+
+  /**
+   * @brief Lee una copia consistente.
+   * @return false si tras varios intentos no se obtuvo una copia estable
+   */
+  bool Read(T& out) const {
+    for (int attempt = 0; attempt < MAX_READ_ATTEMPTS; attempt++) {
+      uint32_t before = _sequence.load(std::memory_order_acquire);
+      if (before & 1u) continue;
+      out = _value;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      uint32_t after = _sequence.load(std::memory_order_relaxed);
+      if (before == after) return true;
+    }
+    return false;
+  }
+
+private:
+  static const int MAX_READ_ATTEMPTS = 8;
+  std::atomic<uint32_t> _sequence;
+  T _value;
+};
+
+/**
+ * @brief Biquad DF2T simple para procesar bloques.
+ */
+struct Biquad {
+  float b0, b1, b2, a1, a2;
+  float z1, z2;
+
+  void Process(const float* in, float* out, size_t length) {
+    float s1 = z1, s2 = z2;
+    for (size_t i = 0; i < length; i++) {
+      float x = in[i];
+      float y = b0 * x + s1;
+      s1 = b1 * x - a1 * y + s2;
+      s2 = b2 * x - a2 * y;
+      out[i] = y;
+    }
+    z1 = s1;
+    z2 = s2;
+  }
+};
+
+/**
+ * @brief Loudness de corto plazo K-weighted (ventana de 3 s en pasos de 100 ms).
+ */
+class ShortTermLoudness {
+public:
+  /**
+   * @brief Calcula los coeficientes K-weighting para el sample rate dado.
+   */
+  void Init(float sample_rate) {
+    // Etapa 1: shelving de agudos (+4 dB sobre ~1.7 kHz)
+    {
+      const float f0 = 1681.974450955533f;
+      const float gain_db = 3.999843853973347f;
+      const float q = 0.7071752369554196f;
+      const float k = tanf(static_cast<float>(M_PI) * f0 / sample_rate);
+      const float vh = powf(10.0f, gain_db / 20.0f);
+      const float vb = powf(vh, 0.4996667741545416f);
+      const float a0 = 1.0f + k / q + k * k;
+      _shelf.b0 = (vh + vb * k / q + k * k) / a0;
+      _shelf.b1 = 2.0f * (k * k - vh) / a0;
+      _shelf.b2 = (vh - vb * k / q + k * k) / a0;
+      _shelf.a1 = 2.0f * (k * k - 1.0f) / a0;
+      _shelf.a2 = (1.0f - k / q + k * k) / a0;
+    }
+    // Etapa 2: pasa-altos RLB (~38 Hz)
+    {
+      const float f0 = 38.13547087602444f;
+      const float q = 0.5003270373238773f;
+      const float k = tanf(static_cast<float>(M_PI) * f0 / sample_rate);
+      const float a0 = 1.0f + k / q + k * k;
+      _highpass.b0 = 1.0f;
+      _highpass.b1 = -2.0f;
+      _highpass.b2 = 1.0f;
+      _highpass.a1 = 2.0f * (k * k - 1.0f) / a0;
+      _highpass.a2 = (1.0f - k / q + k * k) / a0;
+    }
+    _shelf.z1 = _shelf.z2 = 0.0f;
+    _highpass.z1 = _highpass.z2 = 0.0f;
+
+    _bucket_length = static_cast<size_t>(sample_rate * 0.1f);
+    _bucket_sum = 0.0f;
+    _bucket_count = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; i++) _buckets[i] = 0.0f;
+    _bucket_index = 0;
+    _window_sum = 0.0f;
+    _lufs = SILENCE_LUFS;
+  }
+
+  /**
+   * @brief Filtra un bloque y acumula su energía.
+   * @param in Bloque de entrada
+   * @param length Número de muestras (hasta MAX_BLOCK)
+   */
+  void ProcessBlock(const float* in, size_t length) {
+    if (length > MAX_BLOCK) length = MAX_BLOCK;
+    _shelf.Process(in, _scratch, length);
+    _highpass.Process(_scratch, _scratch, length);
+
+    float peak, sum_squares;
+    DSPUtils::PeakAndSumSquares(_scratch, length, peak, sum_squares);
+    _bucket_sum += sum_squares;
+    _bucket_count += length;
+
+    if (_bucket_count >= _bucket_length) {
+      // Suma móvil de 3 s: entra el bucket nuevo, sale el más antiguo
+      _window_sum += _bucket_sum - _buckets[_bucket_index];
+      _buckets[_bucket_index] = _bucket_sum;
+      _bucket_index = (_bucket_index + 1) % NUM_BUCKETS;
+      _bucket_sum = 0.0f;
+      _bucket_count = 0;
+
+      if (_window_sum < 0.0f) _window_sum = 0.0f;
+      float mean_square = _window_sum / static_cast<float>(_bucket_length * NUM_BUCKETS);
+      _lufs = (mean_square > 1e-10f) ? -0.691f + 10.0f * log10f(mean_square) : SILENCE_LUFS;
+    }
+  }
+
+  /** @brief Loudness de corto plazo en LUFS (se actualiza cada 100 ms). */
+  float GetLUFS() const { return _lufs; }
+
+  static constexpr float SILENCE_LUFS = -70.0f;
+
+private:
+  static const size_t NUM_BUCKETS = 30;  // 30 x 100 ms = 3 s
+  static const size_t MAX_BLOCK = 256;
+
+  Biquad _shelf;
+  Biquad _highpass;
+  float _scratch[MAX_BLOCK];
+
+  size_t _bucket_length = 4800;
+  float _bucket_sum = 0.0f;
+  size_t _bucket_count = 0;
+  float _buckets[NUM_BUCKETS];
+  size_t _bucket_index = 0;
+  float _window_sum = 0.0f;
+  float _lufs = SILENCE_LUFS;
+};
+
+/**
+ * @brief Balística de un medidor: pico con caída y RMS promediado.
+ */
+class LevelMeter {
+public:
+  /**
+   * @param sample_rate Sample rate del sistema
+   * @param block_size Muestras por bloque (las constantes de tiempo son por bloque)
+   */
+  void Init(float sample_rate, size_t block_size) {
+    float blocks_per_second = sample_rate / static_cast<float>(block_size);
+    // Pico: cae 20 dB en ~1.5 s; RMS: constante de tiempo de 300 ms
+    _peak_release = powf(0.1f, 1.0f / (1.5f * blocks_per_second));
+    _rms_coeff = 1.0f - expf(-1.0f / (0.3f * blocks_per_second));
+    _peak = 0.0f;
+    _mean_square = 0.0f;
+  }
+
+  /** @brief Mide un bloque con el kernel de una sola pasada. */
+  void ProcessBlock(const float* in, size_t length) {
+    if (length == 0) return;
+    float peak, sum_squares;
+    DSPUtils::PeakAndSumSquares(in, length, peak, sum_squares);
+
+    _peak *= _peak_release;
+    if (peak > _peak) _peak = peak;
+    _mean_square += _rms_coeff * (sum_squares / static_cast<float>(length) - _mean_square);
+  }
+
+  float GetPeak() const { return _peak; }
+  float GetRMS() const { return sqrtf(_mean_square); }
+
+private:
+  float _peak_release = 0.99f;
+  float _rms_coeff = 0.01f;
+  float _peak = 0.0f;
+  float _mean_square = 0.0f;
+};
+
+} // namespace crearttech
+
+#endif // SAMPLER_METERS_H
@@ -0,0 +1,166 @@
+/**
+ * =====================================================================
+ * sampler_profiler.h - Cycle Counter and CPU Load Profiler
+ * =====================================================================
+ * Mide ciclos por etapa del audio callback usando el contador DWT->CYCCNT
+ * del Cortex-M7 (en host usa un reloj monotónico en nanosegundos).
+ * Calcula la carga de CPU como ciclos usados / ciclos disponibles por bloque.
+ */
+
+#ifndef SAMPLER_PROFILER_H
+#define SAMPLER_PROFILER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if !defined(__arm__)
+  #include <chrono>
+#endif
+
+namespace crearttech {
+
+/**
+ * @brief Etapas medidas dentro del audio callback.
+ */
+enum class ProfileStage : uint8_t {
+  CALLBACK,          // Callback completo
+  LOOPER,            // OverdubLooper::ProcessBlock
+  GRANULAR,          // GranularEngine::ProcessBlock
+  EFFECTS,           // EQ, delay, reverb y limitador
+  SPECTRAL,          // SpectralFreeze::ProcessBlock
+  DYNAMICS,          // InputDynamics::Process (antes de grabar)
+  COUNT
+};
+
+/**
+ * @brief Acceso al contador de ciclos del procesador.
+ */
+class CycleCounter {
+public:
+  /** @brief Habilita DWT->CYCCNT (llamar una vez en setup()). */
+  static void Enable() {
+    #if defined(__arm__)
+      volatile uint32_t* demcr    = reinterpret_cast<volatile uint32_t*>(0xE000EDFC);
+      volatile uint32_t* dwt_lar  = reinterpret_cast<volatile uint32_t*>(0xE0001FB0);
+      volatile uint32_t* dwt_ctrl = reinterpret_cast<volatile uint32_t*>(0xE0001000);
+      volatile uint32_t* dwt_cnt  = reinterpret_cast<volatile uint32_t*>(0xE0001004);
+      *demcr |= (1u << 24);     // TRCENA
+      *dwt_lar = 0xC5ACCE55;    // Desbloquear DWT
+      *dwt_cnt = 0;
+      *dwt_ctrl |= 1u;          // CYCCNTENA
+    #endif
+  }
+
+  /** @brief Lee el contador de ciclos (en host: nanosegundos). */
+  static inline uint32_t Now() {
+    #if defined(__arm__)
+      return *reinterpret_cast<volatile uint32_t*>(0xE0001004);
+    #else
+      return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count());
+    #endif
+  }
+};
+
+/**
+ * @brief Profiler por etapas con carga de CPU promedio y pico.
+ */
+class Profiler {
+public:
+  /**
+   * @brief Configura el presupuesto de ciclos por bloque.
+   * @param cpu_hz Frecuencia del núcleo (480 MHz en Daisy Seed; 1 GHz nominal en host)
+   * @param sample_rate Sample rate del sistema
+   * @param block_size Muestras por bloque de audio
+   */
+  void Init(float cpu_hz, float sample_rate, size_t block_size) {
+    _budget_cycles = cpu_hz * static_cast<float>(block_size) / sample_rate;
+    _inv_budget = (_budget_cycles > 0.0f) ? 1.0f / _budget_cycles : 0.0f;
+    Reset();
+  }
+
+  /** @brief Reinicia las estadísticas acumuladas. */
+  void Reset() {
+    for (size_t i = 0; i < STAGE_COUNT; i++) {
+      _start[i] = 0;
+      _last[i] = 0;
+      _last_block[i] = 0;
+      _max[i] = 0;
+      _avg[i] = 0.0f;
+    }
+    _load = 0.0f;
+    _peak_load = 0.0f;
+  }
+
+  /** @brief Marca el inicio de una etapa. */
+  inline void Begin(ProfileStage stage) {
+    _start[static_cast<size_t>(stage)] = CycleCounter::Now();
+  }
+
+  /** @brief Marca el fin de una etapa y guarda sus ciclos. */
+  inline void End(ProfileStage stage) {
+    size_t i = static_cast<size_t>(stage);
+    _last[i] = CycleCounter::Now() - _start[i];
+  }
+
+  /**
+   * @brief Cierra el bloque: actualiza promedios, máximos y carga de CPU.
+   * Llamar al final del callback, después de End(ProfileStage::CALLBACK).
+   * Las etapas que no corrieron en este bloque deben quedar en 0 (ver Begin/End).
+   */
+  void EndBlock() {
+    for (size_t i = 0; i < STAGE_COUNT; i++) {
+      if (_last[i] > _max[i]) _max[i] = _last[i];
+      _avg[i] += AVG_COEFF * (static_cast<float>(_last[i]) - _avg[i]);
+    }
+
+    float load = static_cast<float>(_last[static_cast<size_t>(ProfileStage::CALLBACK)]) * _inv_budget;
+    _load += AVG_COEFF * (load - _load);
+    if (load > _peak_load) _peak_load = load;
+    if (load > 1.0f) _overruns++;
+
+    for (size_t i = 0; i < STAGE_COUNT; i++) _last_block[i] = _last[i];
+    for (size_t i = 0; i < STAGE_COUNT; i++) _last[i] = 0;
+  }
+
+  /** @brief Carga de CPU promedio (0.0 a 1.0+, 1.0 = presupuesto completo). */
+  float GetLoad() const { return _load; }
+
+  /** @brief Carga de CPU máxima observada desde el último Reset(). */
+  float GetPeakLoad() const { return _peak_load; }
+
+  /** @brief Bloques que excedieron el presupuesto desde el arranque (Reset() no los borra). */
+  uint32_t GetOverruns() const { return _overruns; }
+
+  /** @brief Ciclos de la etapa en el último bloque cerrado. */
+  uint32_t GetLastCycles(ProfileStage stage) const { return _last_block[static_cast<size_t>(stage)]; }
+
+  /** @brief Ciclos promedio de la etapa. */
+  float GetAverageCycles(ProfileStage stage) const { return _avg[static_cast<size_t>(stage)]; }
+
+  /** @brief Ciclos máximos de la etapa desde el último Reset(). */
+  uint32_t GetMaxCycles(ProfileStage stage) const { return _max[static_cast<size_t>(stage)]; }
+
+  /** @brief Presupuesto de ciclos por bloque. */
+  float GetBudgetCycles() const { return _budget_cycles; }
+
+private:
+  static const size_t STAGE_COUNT = static_cast<size_t>(ProfileStage::COUNT);
+  static constexpr float AVG_COEFF = 0.01f; // Promedio exponencial (~100 bloques)
+
+  uint32_t _start[STAGE_COUNT] = {};
+  uint32_t _last[STAGE_COUNT] = {};
+  uint32_t _last_block[STAGE_COUNT] = {};
+  uint32_t _max[STAGE_COUNT] = {};
+  float _avg[STAGE_COUNT] = {};
+
+  float _budget_cycles = 0.0f;
+  float _inv_budget = 0.0f;
+  float _load = 0.0f;
+  float _peak_load = 0.0f;
+  uint32_t _overruns = 0;
+};
+
+} // namespace crearttech
+
+#endif // SAMPLER_PROFILER_H
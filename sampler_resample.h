@@ -0,0 +1,141 @@
+/**
+ * =====================================================================
+ * sampler_resample.h - Offline Polyphase Windowed-Sinc Resampler
+ * =====================================================================
+ * Remuestreo de alta calidad del loop, fuera de tiempo real (por porciones):
+ * - Banco polifásico de PHASES fases x TAPS coeficientes (sinc con ventana Kaiser)
+ * - Interpolación lineal entre fases vecinas
+ * - Si el loop se acorta (ratio > 1) el corte baja a 1/ratio para evitar aliasing
+ * - La región se trata como cíclica: los taps que salen de un borde leen del otro,
+ *   así el loop remuestreado cierra sin click
+ */
+
+#ifndef SAMPLER_RESAMPLE_H
+#define SAMPLER_RESAMPLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+namespace crearttech {
+
+/**
+ * @brief Remuestreador polifásico de una región cíclica.
+ */
+class PolyphaseResampler {
+public:
+  static const size_t TAPS = 32;    // Coeficientes por fase (16 a cada lado)
+  static const size_t PHASES = 64;  // Posiciones fraccionarias tabuladas
+
+  /**
+   * @brief Calcula el banco de filtros para una relación de remuestreo.
+   * @param ratio Muestras de entrada por muestra de salida (2.0 = una octava arriba, mitad de duración)
+   */
+  void Init(float ratio) {
+    _ratio = (ratio > 0.0f) ? ratio : 1.0f;
+    // Corte como fracción de la Nyquist de entrada, con margen para la banda de transición
+    const float cutoff = (_ratio > 1.0f) ? PASSBAND / _ratio : PASSBAND;
+    const float half = static_cast<float>(TAPS / 2);
+    const float inv_i0_beta = 1.0f / BesselI0(KAISER_BETA);
+
+    for (size_t p = 0; p <= PHASES; p++) {
+      float frac = static_cast<float>(p) / static_cast<float>(PHASES);
+      float sum = 0.0f;
+      for (size_t t = 0; t < TAPS; t++) {
+        // Tap t lee la muestra floor(pos) + t - (TAPS/2 - 1)
+        float x = static_cast<float>(t) - (half - 1.0f) - frac;
+        float r = x / half;
+        float window = (r > -1.0f && r < 1.0f) ? BesselI0(KAISER_BETA * sqrtf(1.0f - r * r)) * inv_i0_beta : 0.0f;
+        float h = cutoff * Sinc(cutoff * x) * window;
+        _table[p][t] = h;
+        sum += h;
+      }
+      // Ganancia unitaria en continua para cada fase
+      for (size_t t = 0; t < TAPS; t++) _table[p][t] /= sum;
+    }
+  }
+
+  /** @brief Longitud del resultado para una región de input_length muestras. */
+  size_t OutputLength(size_t input_length) const {
+    return static_cast<size_t>(static_cast<double>(input_length) / _ratio);
+  }
+
+  /**
+   * @brief Calcula las salidas [first, first + n) del remuestreo de una región cíclica.
+   * Con la salida completa (OutputLength) el paso es region_length / output_length, no la
+   * relación nominal: la última salida cae justo antes del inicio y el ciclo cierra sin
+   * salto de fase (la afinación difiere de la nominal en menos de una muestra por ciclo).
+   * Si la salida se recortó porque no entra en el destino se usa la relación nominal.
+   * @param region Inicio de la región de entrada
+   * @param region_length Muestras de la región
+   * @param output_length Muestras del resultado
+   * @param out Destino de las n muestras
+   */
+  void Process(const float* region, size_t region_length, size_t output_length,
+               float* out, size_t first, size_t n) const {
+    const long length = static_cast<long>(region_length);
+    const long back = static_cast<long>(TAPS / 2) - 1;
+    const double step = (output_length > 0 && output_length == OutputLength(region_length))
+                          ? static_cast<double>(region_length) / static_cast<double>(output_length)
+                          : static_cast<double>(_ratio);
+    for (size_t k = 0; k < n; k++) {
+      // Doble precisión: con regiones de cientos de miles de muestras un float pierde la fase
+      double pos = static_cast<double>(first + k) * step;
+      long base = static_cast<long>(pos);
+      float phase = static_cast<float>(pos - static_cast<double>(base)) * static_cast<float>(PHASES);
+      size_t p = static_cast<size_t>(phase);
+      if (p >= PHASES) p = PHASES - 1;
+      float blend = phase - static_cast<float>(p);
+      const float* h0 = _table[p];
+      const float* h1 = _table[p + 1];
+
+      float acc0 = 0.0f, acc1 = 0.0f;
+      long lo = base - back;
+      if (lo >= 0 && lo + static_cast<long>(TAPS) <= length) {
+        const float* x = region + lo;
+        for (size_t t = 0; t < TAPS; t++) {
+          acc0 += h0[t] * x[t];
+          acc1 += h1[t] * x[t];
+        }
+      } else {
+        // Cerca de los bordes: índices envueltos
+        for (size_t t = 0; t < TAPS; t++) {
+          long idx = (lo + static_cast<long>(t)) % length;
+          if (idx < 0) idx += length;
+          acc0 += h0[t] * region[idx];
+          acc1 += h1[t] * region[idx];
+        }
+      }
+      out[k] = acc0 + blend * (acc1 - acc0);
+    }
+  }
+
+private:
+  static constexpr float PASSBAND = 0.95f;
+  static constexpr float KAISER_BETA = 8.0f;  // Error en la banda de paso ~-70 dB con 32 taps
+
+  static float Sinc(float x) {
+    if (fabsf(x) < 1e-6f) return 1.0f;
+    float px = static_cast<float>(M_PI) * x;
+    return sinf(px) / px;
+  }
+
+  /** @brief Función de Bessel modificada I0 (serie; solo para construir la tabla). */
+  static float BesselI0(float x) {
+    float sum = 1.0f, term = 1.0f;
+    float q = x * x * 0.25f;
+    for (int k = 1; k < 32; k++) {
+      term *= q / static_cast<float>(k * k);
+      sum += term;
+      if (term < sum * 1e-9f) break;
+    }
+    return sum;
+  }
+
+  float _table[PHASES + 1][TAPS];
+  float _ratio = 1.0f;
+};
+
+} // namespace crearttech
+
+#endif // SAMPLER_RESAMPLE_H
@@ -0,0 +1,242 @@
+/**
+ * =====================================================================
+ * sampler_spectral.h - Spectral Freeze
+ * =====================================================================
+ * Congela el espectro de la salida y lo sostiene indefinidamente:
+ * - Captura: ventana Hann + FFT real de FRAME_SIZE muestras
+ * - Sostén: magnitudes fijas con fase aleatoria en cada hop
+ * - Resíntesis: IFFT + ventana Hann + overlap-add (solapamiento 4x)
+ *
+ * El trabajo de cada frame se reparte entre callbacks: en cada bloque se
+ * ejecuta como máximo UNA etapa (FFT, magnitudes, espectro, IFFT u OLA).
+ * Un hop de 256 muestras dura ~5.3 bloques de 48, y la resíntesis necesita
+ * 3 etapas por hop, así que ningún callback paga un frame completo.
+ *
+ * Techo de CPU (estimado para Cortex-M7 @ 480 MHz con CMSIS-DSP): la etapa
+ * más cara es la FFT/IFFT real de 1024 puntos, ~20k ciclos, es decir ~4%
+ * del presupuesto de un bloque de 48 muestras (480k ciclos). El costo real
+ * queda medido en ProfileStage::SPECTRAL.
+ */
+
+#ifndef SAMPLER_SPECTRAL_H
+#define SAMPLER_SPECTRAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "sampler_fft.h"
+
+namespace crearttech {
+
+/**
+ * @brief Efecto de congelamiento espectral (STFT con fase aleatoria).
+ */
+class SpectralFreeze {
+public:
+  static const size_t FRAME_SIZE = 1024;
+  static const size_t HOP_SIZE = FRAME_SIZE / 4;
+  static const size_t NUM_BINS = FRAME_SIZE / 2 + 1;
+
+  /**
+   * @brief Prepara tablas y estado (llamar una vez, fuera del audio callback).
+   * @param sample_rate Sample rate del sistema (para la rampa de mezcla)
+   */
+  void Init(float sample_rate) {
+    _fft.Init();
+
+    for (size_t i = 0; i < FRAME_SIZE; i++) {
+      float phase = static_cast<float>(i) / static_cast<float>(FRAME_SIZE);
+      _window[i] = 0.5f - 0.5f * cosf(2.0f * static_cast<float>(M_PI) * phase);
+    }
+    for (size_t i = 0; i < PHASE_TABLE_SIZE; i++) {
+      _cos_table[i] = cosf(2.0f * static_cast<float>(M_PI) * static_cast<float>(i) / static_cast<float>(PHASE_TABLE_SIZE));
+    }
+
+    // Hann² con solapamiento 4x suma 1.5; la IFFT ya incluye 1/N
+    _ola_gain = 1.0f / 1.5f;
+    _mix_step = 1.0f / (MIX_RAMP_SECONDS * sample_rate);
+
+    memset(_history, 0, sizeof(_history));
+    memset(_ola, 0, sizeof(_ola));
+    memset(_hop_play, 0, sizeof(_hop_play));
+    memset(_hop_next, 0, sizeof(_hop_next));
+    _history_pos = 0;
+    _hop_pos = 0;
+    _stage = STAGE_IDLE;
+    _frozen = false;
+    _requested = false;
+    _recapture = false;
+    _wet = 0.0f;
+  }
+
+  /**
+   * @brief Activa o libera el congelamiento (solo desde el audio callback).
+   * Si vuelve a activarse mientras la salida anterior todavía se desvanece, las
+   * magnitudes viejas se siguen resintetizando hasta que el fade-out termina y
+   * recién entonces se captura el espectro actual.
+   */
+  void SetFrozen(bool frozen) {
+    _recapture = frozen && (_recapture || (!_requested && _stage != STAGE_IDLE));
+    _requested = frozen;
+  }
+
+  /** @brief Indica si el congelamiento está pedido o todavía sonando su salida. */
+  bool IsActive() const { return _requested || _wet > 0.0f; }
+
+  /**
+   * @brief Procesa un bloque in-place.
+   * Sin congelamiento solo guarda la historia de entrada (una copia por bloque).
+   */
+  void ProcessBlock(float* buffer, size_t size) {
+    WriteHistory(buffer, size);
+
+    if (_requested && _stage == STAGE_IDLE) {
+      _stage = STAGE_CAPTURE_FFT;
+      _frozen = false;
+    }
+
+    if (_stage == STAGE_IDLE) return;
+
+    // Mezcla: la salida congelada entra cuando el primer hop está listo
+    const bool fading_out = !_requested || _recapture;
+    for (size_t i = 0; i < size; i++) {
+      if (_hop_pos >= HOP_SIZE) NextHop();
+
+      float target = (!fading_out && _frozen) ? 1.0f : 0.0f;
+      if (_wet < target) { _wet += _mix_step; if (_wet > target) _wet = target; }
+      else if (_wet > target) { _wet -= _mix_step; if (_wet < target) _wet = target; }
+
+      float frozen_sample = _hop_play[_hop_pos++];
+      buffer[i] = buffer[i] * (1.0f - _wet) + frozen_sample * _wet;
+    }
+
+    // Una sola etapa del frame por callback
+    RunStage();
+
+    // Al terminar el fade-out se libera, o se captura de nuevo en el próximo bloque
+    if (fading_out && _wet <= 0.0f && (_frozen || _recapture)) Stop();
+  }
+
+private:
+  static const size_t PHASE_TABLE_SIZE = 256;
+  static constexpr float MIX_RAMP_SECONDS = 0.02f;
+
+  enum Stage : uint8_t {
+    STAGE_IDLE,
+    STAGE_CAPTURE_FFT,     // Ventana + FFT del frame capturado
+    STAGE_CAPTURE_MAG,     // Magnitudes que se sostendrán
+    STAGE_SYNTH_SPECTRUM,  // Magnitud fija + fase aleatoria
+    STAGE_SYNTH_IFFT,      // IFFT del frame sintetizado
+    STAGE_SYNTH_OLA,       // Ventana + overlap-add -> siguiente hop
+    STAGE_READY            // Hop siguiente listo, esperando al borde del hop
+  };
+
+  void WriteHistory(const float* buffer, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+      _history[_history_pos] = buffer[i];
+      _history_pos = (_history_pos + 1) & (FRAME_SIZE - 1);
+    }
+  }
+
+  /** @brief Borde de hop: el hop siguiente pasa a reproducirse y arranca su sucesor. */
+  void NextHop() {
+    _hop_pos = 0;
+    if (_stage == STAGE_READY) {
+      memcpy(_hop_play, _hop_next, sizeof(_hop_play));
+      _frozen = true;
+      _stage = STAGE_SYNTH_SPECTRUM;
+    } else {
+      // La resíntesis no llegó a tiempo (o aún se captura): silencio en lugar de repetir
+      memset(_hop_play, 0, sizeof(_hop_play));
+    }
+  }
+
+  void RunStage() {
+    switch (_stage) {
+      case STAGE_CAPTURE_FFT: {
+        // Frame en orden cronológico a partir de la historia circular
+        for (size_t i = 0; i < FRAME_SIZE; i++) {
+          size_t idx = (_history_pos + i) & (FRAME_SIZE - 1);
+          _time[i] = _history[idx] * _window[i];
+        }
+        _fft.Forward(_time, _spectrum);
+        _stage = STAGE_CAPTURE_MAG;
+      } break;
+
+      case STAGE_CAPTURE_MAG:
+        RealFFT<FRAME_SIZE>::Magnitudes(_spectrum, _magnitude);
+        memset(_ola, 0, sizeof(_ola));
+        _stage = STAGE_SYNTH_SPECTRUM;
+        break;
+
+      case STAGE_SYNTH_SPECTRUM: {
+        const size_t quarter = PHASE_TABLE_SIZE / 4;
+        _spectrum[0] = _magnitude[0];
+        _spectrum[1] = _magnitude[NUM_BINS - 1];
+        for (size_t k = 1; k < NUM_BINS - 1; k++) {
+          _rng_state = _rng_state * 1664525u + 1013904223u;
+          size_t p = _rng_state >> 24; // 0..255
+          float c = _cos_table[p];
+          float s = _cos_table[(p + PHASE_TABLE_SIZE - quarter) & (PHASE_TABLE_SIZE - 1)];
+          _spectrum[2 * k] = _magnitude[k] * c;
+          _spectrum[2 * k + 1] = _magnitude[k] * s;
+        }
+        _stage = STAGE_SYNTH_IFFT;
+      } break;
+
+      case STAGE_SYNTH_IFFT:
+        _fft.Inverse(_spectrum, _time);
+        _stage = STAGE_SYNTH_OLA;
+        break;
+
+      case STAGE_SYNTH_OLA: {
+        for (size_t i = 0; i < FRAME_SIZE; i++) {
+          _ola[i] += _time[i] * _window[i] * _ola_gain;
+        }
+        memcpy(_hop_next, _ola, sizeof(_hop_next));
+        memmove(_ola, _ola + HOP_SIZE, sizeof(float) * (FRAME_SIZE - HOP_SIZE));
+        memset(_ola + FRAME_SIZE - HOP_SIZE, 0, sizeof(float) * HOP_SIZE);
+        _stage = STAGE_READY;
+      } break;
+
+      default:
+        break;
+    }
+  }
+
+  void Stop() {
+    _stage = STAGE_IDLE;
+    _frozen = false;
+    _recapture = false;
+    _hop_pos = 0;
+    memset(_hop_play, 0, sizeof(_hop_play));
+  }
+
+  RealFFT<FRAME_SIZE> _fft;
+
+  float _window[FRAME_SIZE];
+  float _cos_table[PHASE_TABLE_SIZE];
+  float _history[FRAME_SIZE];
+  float _time[FRAME_SIZE];
+  float _spectrum[FRAME_SIZE];
+  float _magnitude[NUM_BINS];
+  float _ola[FRAME_SIZE];
+  float _hop_play[HOP_SIZE];
+  float _hop_next[HOP_SIZE];
+
+  size_t _history_pos = 0;
+  size_t _hop_pos = 0;
+  Stage _stage = STAGE_IDLE;
+  bool _frozen = false;      // Ya suena al menos un hop resintetizado
+  bool _requested = false;   // El usuario pidió congelar
+  bool _recapture = false;   // Pedido otra vez durante el fade-out: capturar al llegar a 0
+  float _wet = 0.0f;
+  float _mix_step = 0.0f;
+  float _ola_gain = 1.0f;
+  uint32_t _rng_state = 12345u;
+};
+
+} // namespace crearttech
+
+#endif // SAMPLER_SPECTRAL_H
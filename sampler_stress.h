@@ -0,0 +1,436 @@
+/**
+ * =====================================================================
+ * sampler_stress.h - Randomized Engine Stress Test
+ * =====================================================================
+ * Banco de pruebas del OverdubLooper a ritmo de audio:
+ * - Comandos al azar (grabar, sobregrabar, región, reversa, velocidad,
+ *   modo, scrub, undo/redo, intercambio de búfer) aplicados en una muestra
+ *   al azar dentro del bloque, siguiendo las transiciones de la interfaz
+ * - Invariantes tras cada bloque: salida finita, cabezales dentro de la
+ *   región y zonas de guarda intactas alrededor de cada búfer
+ * - Secuencia determinista: la misma semilla repite el mismo fallo
+ * No depende del hardware: SAMPLER.ino lo corre con ENGINE_STRESS_TEST y
+ * le pasa el contador de ciclos para medir el peor bloque.
+ */
+
+#ifndef SAMPLER_STRESS_H
+#define SAMPLER_STRESS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "sampler_engine.h"
+
+namespace crearttech {
+
+/**
+ * @brief Generador xorshift32: rápido, sin estado global y reproducible.
+ */
+class StressRandom {
+public:
+  explicit StressRandom(uint32_t seed = 1) : _state(seed != 0 ? seed : 1) {}
+
+  uint32_t Next() {
+    _state ^= _state << 13;
+    _state ^= _state >> 17;
+    _state ^= _state << 5;
+    return _state;
+  }
+
+  /** @brief Entero en [0, n). */
+  uint32_t Below(uint32_t n) { return (n > 0) ? Next() % n : 0; }
+
+  /** @brief Real en [lo, hi). */
+  float Uniform(float lo, float hi) {
+    return lo + (hi - lo) * static_cast<float>(Next() >> 8) * (1.0f / 16777216.0f);
+  }
+
+  /** @brief true con probabilidad 1 / n. */
+  bool OneIn(uint32_t n) { return Below(n) == 0; }
+
+private:
+  uint32_t _state;
+};
+
+/** @brief Reloj para medir cada bloque (ej. CycleCounter::Now). */
+typedef uint32_t (*StressClock)();
+
+/**
+ * @brief Comandos que dispara la prueba (equivalentes a los de la interfaz).
+ */
+enum class StressCommand : uint8_t {
+  REC,           // STOPPED: armar; PLAYING: empezar overdub
+  RELEASE,       // ARMED: desarmar; RECORDING: cerrar la toma; OVERDUB: terminar
+  RESET,         // Doble PLAY: borra la toma
+  REGION,        // Nueva región dentro de la toma
+  REVERSE,
+  SPEED,         // Varispeed en el rango del encoder de pitch
+  MODE,          // Loop, ping-pong o one-shot
+  RETRIGGER,
+  SCRUB,         // Empieza, mueve o termina un scrub
+  PREPARE_UNDO,  // Una porción del snapshot de undo (como el job de loop())
+  UNDO,
+  REDO,
+  SWAP,          // Activa un render de la toma (como un bounce o un remuestreo)
+  COUNT
+};
+
+/**
+ * @brief Contadores de la prueba.
+ */
+struct StressStats {
+  static const uint32_t NO_FAILURE = 0xFFFFFFFFu;
+
+  uint32_t blocks;
+  uint32_t commands[static_cast<size_t>(StressCommand::COUNT)];
+  uint32_t non_finite_blocks;    // Salida con NaN o Inf
+  uint32_t playhead_errors;      // Cabezal fuera de la región
+  uint32_t record_head_errors;   // Cabezal de grabación más allá del búfer
+  uint32_t guard_errors;         // Zonas de guarda pisadas (escritura fuera del búfer)
+  uint32_t first_failure_block;  // Bloque del primer fallo (NO_FAILURE si no hubo)
+  uint32_t worst_ticks;          // Peor bloque según el reloj (solo ProcessBlock)
+  uint32_t worst_block;
+  uint32_t over_budget_blocks;   // Bloques por encima de SetTickBudget()
+  uint64_t total_ticks;
+
+  uint32_t Failures() const { return non_finite_blocks + playhead_errors + record_head_errors + guard_errors; }
+};
+
+/**
+ * @brief Conduce un OverdubLooper con comandos al azar y verifica invariantes.
+ *
+ * Cada búfer recibido se reduce en GUARD_SAMPLES muestras por lado y esas
+ * zonas se llenan con un NaN de señalización: una escritura fuera del búfer
+ * las pisa (CheckGuards) y una lectura fuera del búfer saca NaN por la salida.
+ */
+class EngineStress {
+public:
+  static const size_t GUARD_SAMPLES = 64;
+  static const size_t MAX_UNDO_LEVELS = 3;
+  static constexpr float ARM_THRESHOLD = 0.05f;
+  static const size_t PREROLL_SAMPLES = 480;
+
+  /**
+   * @brief Prepara la prueba y el looper.
+   * @param buffers Dos búferes de length muestras (toma y arena de render)
+   * @param undo_buffers undo_levels + 1 búferes de length muestras (ver OverdubLooper::Init)
+   * @param stats Estadísticas por tramo para el looper (ver AttachChunkStats)
+   * @param clock Reloj para medir los bloques (nullptr: sin medición)
+   */
+  void Init(OverdubLooper* looper, float* const buffers[2], float* const* undo_buffers, size_t undo_levels,
+            size_t length, ChunkStats* stats, uint32_t* silent_bits, size_t chunk_count,
+            float sample_rate, uint32_t seed, StressClock clock = nullptr) {
+    _looper = looper;
+    _clock = clock;
+    _length = length - 2 * GUARD_SAMPLES;
+    _sample_rate = sample_rate;
+    _random = StressRandom(seed);
+
+    _guarded_count = 0;
+    for (size_t i = 0; i < 2; i++) {
+      AddGuarded(buffers[i]);
+      _buffers[i] = buffers[i] + GUARD_SAMPLES;
+    }
+    _undo_levels = (undo_levels < MAX_UNDO_LEVELS) ? undo_levels : MAX_UNDO_LEVELS;
+    for (size_t i = 0; i < _undo_levels + 1; i++) {
+      AddGuarded(undo_buffers[i]);
+      _undo[i] = undo_buffers[i] + GUARD_SAMPLES;
+    }
+
+    _looper->Init(_buffers[0], _length, _undo, _undo_levels);
+    _looper->AttachChunkStats(stats, silent_bits, chunk_count);
+    _active = 0;
+    _state = State::STOPPED;
+    _scrubbing = false;
+    _take_length = 0;
+    _region_start = 0;
+    _region_length = 0;
+    _input_level = 0.0f;
+
+    memset(&_stats, 0, sizeof(_stats));
+    _stats.first_failure_block = StressStats::NO_FAILURE;
+  }
+
+  /**
+   * @brief Procesa un bloque; con probabilidad 1 / command_one_in aplica un
+   * comando en una muestra al azar (el bloque se parte en dos llamadas).
+   * Se mide solo el procesamiento: los comandos corren en loop() en el equipo.
+   * @param in Destino de la entrada generada (size muestras)
+   * @param out Salida del looper (size muestras)
+   * @return false si el bloque violó algún invariante
+   */
+  bool RunBlock(float* in, float* out, size_t size, uint32_t command_one_in) {
+    GenerateInput(in, size);
+    uint32_t failures = _stats.Failures();
+
+    uint32_t ticks;
+    if (_random.OneIn(command_one_in)) {
+      size_t split = _random.Below(static_cast<uint32_t>(size) + 1);
+      ticks = Process(in, out, split);
+      Apply(PickCommand());
+      ticks += Process(in + split, out + split, size - split);
+    } else {
+      ticks = Process(in, out, size);
+    }
+    if (ticks > _stats.worst_ticks) {
+      _stats.worst_ticks = ticks;
+      _stats.worst_block = _stats.blocks;
+    }
+    if (_tick_budget > 0 && ticks > _tick_budget) _stats.over_budget_blocks++;
+    _stats.total_ticks += ticks;
+    TrackRecording();
+    CheckBlock(out, size);
+
+    _stats.blocks++;
+    return _stats.Failures() == failures;
+  }
+
+  /**
+   * @brief Verifica las zonas de guarda de todos los búferes.
+   * @return false si alguna fue pisada
+   */
+  bool CheckGuards() {
+    bool ok = true;
+    for (size_t b = 0; b < _guarded_count; b++) {
+      const float* guarded = _guarded[b];
+      const float* tail = guarded + GUARD_SAMPLES + _length;
+      for (size_t i = 0; i < GUARD_SAMPLES; i++) {
+        if (!IsCanary(guarded[i]) || !IsCanary(tail[i])) { ok = false; break; }
+      }
+    }
+    if (!ok) Fail(_stats.guard_errors);
+    return ok;
+  }
+
+  /** @brief Presupuesto por bloque en ticks del reloj (0: sin límite). */
+  void SetTickBudget(uint32_t ticks) { _tick_budget = ticks; }
+
+  const StressStats& GetStats() const { return _stats; }
+
+private:
+  enum class State : uint8_t { STOPPED, ARMED, RECORDING, PLAYING, OVERDUB };
+
+  static const uint32_t CANARY_BITS = 0x7FA5A5A5u;  // NaN de señalización
+
+  void AddGuarded(float* buf) {
+    const uint32_t canary = CANARY_BITS;
+    for (size_t i = 0; i < GUARD_SAMPLES; i++) {
+      memcpy(&buf[i], &canary, sizeof(canary));
+      memcpy(&buf[GUARD_SAMPLES + _length + i], &canary, sizeof(canary));
+    }
+    _guarded[_guarded_count++] = buf;
+  }
+
+  uint32_t Process(const float* in, float* out, size_t size) {
+    uint32_t start = (_clock != nullptr) ? _clock() : 0;
+    _looper->ProcessBlock(in, out, size);
+    return (_clock != nullptr) ? _clock() - start : 0;
+  }
+
+  static bool IsCanary(float x) {
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    return bits == CANARY_BITS;
+  }
+
+  /**
+   * @brief Entrada al azar: silencio, ruido bajo el umbral de disparo o ruido a
+   * plena escala, con el nivel cambiando cada tanto (ejercita el disparo por
+   * umbral y las estadísticas de silencio).
+   */
+  void GenerateInput(float* in, size_t size) {
+    if (_random.OneIn(64)) {
+      switch (_random.Below(3)) {
+        case 0: _input_level = 0.0f; break;
+        case 1: _input_level = _random.Uniform(0.0f, ARM_THRESHOLD); break;
+        default: _input_level = _random.Uniform(ARM_THRESHOLD, 1.0f); break;
+      }
+    }
+    for (size_t i = 0; i < size; i++) in[i] = _input_level * _random.Uniform(-1.0f, 1.0f);
+  }
+
+  bool Allowed(StressCommand command) const {
+    switch (command) {
+      case StressCommand::REC: return _state == State::STOPPED || _state == State::PLAYING;
+      case StressCommand::RELEASE: return _state == State::ARMED || _state == State::RECORDING || _state == State::OVERDUB;
+      case StressCommand::RESET: return _state != State::STOPPED;
+      case StressCommand::REGION: return _state == State::PLAYING || _state == State::OVERDUB;
+      case StressCommand::SCRUB:
+      case StressCommand::PREPARE_UNDO:
+      case StressCommand::UNDO:
+      case StressCommand::REDO:
+      case StressCommand::SWAP: return _state == State::PLAYING;
+      default: return true;
+    }
+  }
+
+  /** @brief Comando permitido en el estado actual; RESET es raro para que las tomas vivan. */
+  StressCommand PickCommand() {
+    StressCommand command;
+    do {
+      command = static_cast<StressCommand>(_random.Below(static_cast<uint32_t>(StressCommand::COUNT)));
+    } while (!Allowed(command) || (command == StressCommand::RESET && !_random.OneIn(16)));
+    return command;
+  }
+
+  void Apply(StressCommand command) {
+    _stats.commands[static_cast<size_t>(command)]++;
+    switch (command) {
+      case StressCommand::REC:
+        if (_state == State::STOPPED) {
+          _looper->ArmRecording(ARM_THRESHOLD, PREROLL_SAMPLES);
+          _state = State::ARMED;
+        } else {
+          EndScrub();
+          _looper->StartOverdub();
+          _state = State::OVERDUB;
+        }
+        break;
+
+      case StressCommand::RELEASE:
+        if (_state == State::ARMED) {
+          _looper->Disarm();
+          _state = State::STOPPED;
+        } else if (_state == State::RECORDING) {
+          _looper->StopRecording();
+          CloseTake();
+        } else {
+          _looper->StopOverdub();
+          _state = State::PLAYING;
+        }
+        break;
+
+      case StressCommand::RESET:
+        EndScrub();
+        _looper->Restart();
+        _looper->Disarm();
+        if (_state == State::RECORDING) _looper->StopRecording();
+        _take_length = 0;
+        _state = State::STOPPED;
+        break;
+
+      case StressCommand::REGION: {
+        size_t start = _random.Below(static_cast<uint32_t>(_take_length));
+        size_t end = start + _random.Below(static_cast<uint32_t>(_take_length - start));
+        SetRegion(start, end);
+        break;
+      }
+
+      case StressCommand::REVERSE: _looper->SetReverse(_random.OneIn(2)); break;
+      case StressCommand::SPEED: _looper->SetPlaybackSpeed(powf(2.0f, _random.Uniform(-0.5f, 0.5f))); break;
+      case StressCommand::MODE: _looper->SetPlaybackMode(static_cast<PlaybackMode>(_random.Below(3))); break;
+      case StressCommand::RETRIGGER: _looper->Retrigger(); break;
+
+      case StressCommand::SCRUB:
+        if (!_scrubbing) {
+          _looper->BeginScrub(_random.Uniform(5.0f, 50.0f), _sample_rate);
+          _scrubbing = true;
+        } else if (_random.OneIn(4)) {
+          EndScrub();
+        } else {
+          float span = static_cast<float>(_region_length);
+          _looper->SetScrubTarget(_random.Uniform(-2.0f * span, 2.0f * span), _random.Uniform(-4.0f, 4.0f));
+        }
+        break;
+
+      case StressCommand::PREPARE_UNDO: _looper->PrepareUndoStep(1 + _random.Below(16384)); break;
+      case StressCommand::UNDO: _looper->Undo(); break;
+      case StressCommand::REDO: _looper->Redo(); break;
+
+      case StressCommand::SWAP: {
+        // El render es la región actual con otra ganancia; uno de cada cuatro
+        // simula un remuestreo que cambia la duración (no se puede deshacer)
+        float* rendered = _buffers[1 - _active];
+        float gain = _random.Uniform(0.25f, 1.0f);
+        bool resample = _random.OneIn(4);
+        for (size_t i = 0; i < _take_length; i++) rendered[i] = _buffers[_active][i] * gain;
+        _looper->ReplaceBuffer(rendered, gain, !resample);
+        _active = 1 - _active;
+        if (resample) {
+          _take_length = 1 + _random.Below(static_cast<uint32_t>(_take_length));
+          SetRegion(0, _take_length - 1);
+        }
+        break;
+      }
+
+      default: break;
+    }
+  }
+
+  void EndScrub() {
+    if (_scrubbing) _looper->EndScrub();
+    _scrubbing = false;
+  }
+
+  void SetRegion(size_t start, size_t end) {
+    _looper->SetLoopRegion(start, end);
+    _region_start = start;
+    _region_length = end - start + 1;
+  }
+
+  /** @brief Igual que al soltar REC: recorte, región y limpieza del resto del búfer. */
+  void CloseTake() {
+    size_t recorded = _looper->GetRecordHead();
+    if (recorded == 0) {
+      _looper->Restart();
+      _take_length = 0;
+      _state = State::STOPPED;
+      return;
+    }
+    size_t start, end;
+    float gain;
+    _looper->AnalyzeTake(recorded, 1e-3f, 0.9f, start, end, gain);
+    _take_length = recorded;
+    memset(_buffers[_active] + recorded, 0, sizeof(float) * (_length - recorded));
+    SetRegion(start, end);
+    _state = State::PLAYING;
+  }
+
+  /** @brief Sigue los cambios que hace el propio audio: disparo del umbral y búfer lleno. */
+  void TrackRecording() {
+    if (_state == State::ARMED && _looper->IsRecording()) _state = State::RECORDING;
+    if (_state == State::RECORDING && !_looper->IsRecording()) CloseTake();
+  }
+
+  void CheckBlock(const float* out, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+      if (!isfinite(out[i])) { Fail(_stats.non_finite_blocks); break; }
+    }
+    if (_looper->GetRecordHead() > _length) Fail(_stats.record_head_errors);
+    if ((_state == State::PLAYING || _state == State::OVERDUB) &&
+        _looper->GetLoopPlayheadPosition() >= _region_length) {
+      Fail(_stats.playhead_errors);
+    }
+  }
+
+  void Fail(uint32_t& counter) {
+    counter++;
+    if (_stats.first_failure_block == StressStats::NO_FAILURE) _stats.first_failure_block = _stats.blocks;
+  }
+
+  OverdubLooper* _looper = nullptr;
+  StressClock _clock = nullptr;
+  uint32_t _tick_budget = 0;
+  float* _buffers[2] = {nullptr, nullptr};
+  float* _undo[MAX_UNDO_LEVELS + 1] = {nullptr, nullptr, nullptr, nullptr};
+  float* _guarded[3 + MAX_UNDO_LEVELS];
+  size_t _guarded_count = 0;
+  size_t _undo_levels = 0;
+  size_t _length = 0;
+  size_t _active = 0;
+  float _sample_rate = 48000.0f;
+  StressRandom _random;
+
+  State _state = State::STOPPED;
+  bool _scrubbing = false;
+  size_t _take_length = 0;
+  size_t _region_start = 0;
+  size_t _region_length = 0;
+  float _input_level = 0.0f;
+  StressStats _stats;
+};
+
+} // namespace crearttech
+
+#endif // SAMPLER_STRESS_H
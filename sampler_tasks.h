@@ -0,0 +1,161 @@
+/**
+ * =====================================================================
+ * sampler_tasks.h - Fixed-Rate Main Loop Task Scheduler
+ * =====================================================================
+ * Planificador cooperativo para loop(), con prioridad rate-monotonic:
+ * entre las tareas liberadas corre primero la de periodo más corto.
+ * - Cada tarea tiene periodo y presupuesto en microsegundos
+ * - Se mide el jitter (retraso respecto de su liberación), la duración,
+ *   el intervalo máximo entre ejecuciones y los excesos de presupuesto
+ * - El tiempo libre hasta la próxima liberación queda para trabajos de fondo
+ */
+
+#ifndef SAMPLER_TASKS_H
+#define SAMPLER_TASKS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace crearttech {
+
+/**
+ * @brief Estadísticas de una tarea (en microsegundos).
+ */
+struct TaskStats {
+  uint32_t runs;
+  uint32_t budget_overruns;   // Ejecuciones que superaron su presupuesto
+  uint32_t missed_periods;    // Liberaciones perdidas por completo
+  uint32_t max_jitter_us;     // Mayor retraso entre la liberación y el inicio
+  uint32_t last_duration_us;
+  uint32_t max_duration_us;
+  uint32_t max_interval_us;   // Mayor tiempo entre dos inicios consecutivos
+};
+
+/**
+ * @brief Planificador de tareas periódicas.
+ * @tparam MAX_TASKS Número máximo de tareas
+ */
+template <size_t MAX_TASKS>
+class TaskScheduler {
+public:
+  typedef void (*TaskFunction)();
+  typedef uint32_t (*Clock)();
+
+  /** @param now_us Reloj en microsegundos (ej. micros()) */
+  void Init(Clock now_us) {
+    _now = now_us;
+    _count = 0;
+  }
+
+  /**
+   * @brief Registra una tarea; la primera ejecución se libera de inmediato.
+   * @return Identificador de la tarea, o -1 si no hay espacio
+   */
+  int Add(TaskFunction function, uint32_t period_us, uint32_t budget_us) {
+    if (_count >= MAX_TASKS) return -1;
+    Task& t = _tasks[_count];
+    t.function = function;
+    t.period_us = period_us;
+    t.budget_us = budget_us;
+    t.release_us = _now();
+    t.last_start_us = t.release_us;
+    t.stats = TaskStats();
+    return static_cast<int>(_count++);
+  }
+
+  /** @brief Cambia el periodo (para tareas adaptativas); rige desde la próxima liberación. */
+  void SetPeriod(int id, uint32_t period_us) { _tasks[id].period_us = period_us; }
+  uint32_t GetPeriod(int id) const { return _tasks[id].period_us; }
+  uint32_t GetBudget(int id) const { return _tasks[id].budget_us; }
+
+  /**
+   * @brief Ejecuta las tareas liberadas, de menor a mayor periodo.
+   * Tras cada tarea vuelve a elegir, así una tarea rápida liberada mientras
+   * corría una lenta pasa primero. Cada tarea corre como máximo una vez por llamada.
+   */
+  void RunReady() {
+    bool ran[MAX_TASKS] = {};
+    for (size_t n = 0; n < _count; n++) {
+      uint32_t now = _now();
+      int next = -1;
+      for (size_t i = 0; i < _count; i++) {
+        if (ran[i] || static_cast<int32_t>(now - _tasks[i].release_us) < 0) continue;
+        if (next < 0 || _tasks[i].period_us < _tasks[next].period_us) next = static_cast<int>(i);
+      }
+      if (next < 0) return;
+      ran[next] = true;
+      RunTask(_tasks[next], now);
+    }
+  }
+
+  /** @brief Microsegundos hasta la próxima liberación (0 si alguna ya está lista). */
+  uint32_t TimeUntilNextRelease() const {
+    uint32_t now = _now();
+    uint32_t best = UINT32_MAX;
+    for (size_t i = 0; i < _count; i++) {
+      int32_t remaining = static_cast<int32_t>(_tasks[i].release_us - now);
+      if (remaining <= 0) return 0;
+      if (static_cast<uint32_t>(remaining) < best) best = static_cast<uint32_t>(remaining);
+    }
+    return best;
+  }
+
+  const TaskStats& GetStats(int id) const { return _tasks[id].stats; }
+
+  /**
+   * @brief Latencia de reacción en el peor caso de una tarea de sondeo.
+   * Un evento que llega justo después de un inicio espera el intervalo
+   * máximo hasta el siguiente, más lo que tarda esa ejecución.
+   */
+  uint32_t GetWorstCaseLatency(int id) const {
+    const Task& t = _tasks[id];
+    uint32_t interval = (t.stats.max_interval_us > t.period_us) ? t.stats.max_interval_us : t.period_us;
+    return interval + t.stats.max_duration_us;
+  }
+
+  /** @brief Reinicia las estadísticas de todas las tareas (ej. tras cada reporte). */
+  void ResetStats() {
+    for (size_t i = 0; i < _count; i++) _tasks[i].stats = TaskStats();
+  }
+
+private:
+  struct Task {
+    TaskFunction function;
+    uint32_t period_us;
+    uint32_t budget_us;
+    uint32_t release_us;
+    uint32_t last_start_us;
+    TaskStats stats;
+  };
+
+  void RunTask(Task& t, uint32_t start) {
+    TaskStats& s = t.stats;
+    uint32_t jitter = start - t.release_us;
+    if (jitter > s.max_jitter_us) s.max_jitter_us = jitter;
+    if (s.runs > 0 && start - t.last_start_us > s.max_interval_us) s.max_interval_us = start - t.last_start_us;
+    t.last_start_us = start;
+
+    t.function();
+
+    uint32_t duration = _now() - start;
+    s.runs++;
+    s.last_duration_us = duration;
+    if (duration > s.max_duration_us) s.max_duration_us = duration;
+    if (duration > t.budget_us) s.budget_overruns++;
+
+    // Próxima liberación; si se perdieron periodos completos no se recuperan en ráfaga
+    t.release_us += t.period_us;
+    if (static_cast<int32_t>(start - t.release_us) >= 0) {
+      s.missed_periods += (start - t.release_us) / t.period_us + 1;
+      t.release_us = start + t.period_us;
+    }
+  }
+
+  Task _tasks[MAX_TASKS];
+  size_t _count = 0;
+  Clock _now = nullptr;
+};
+
+} // namespace crearttech
+
+#endif // SAMPLER_TASKS_H
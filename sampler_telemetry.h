@@ -0,0 +1,133 @@
+/**
+ * =====================================================================
+ * sampler_telemetry.h - Binary Telemetry Frames
+ * =====================================================================
+ * Telemetría binaria por USB serial, sin bloquear a loop():
+ * - Tramas con sincronía, tipo, largo y Fletcher-16, así el host se
+ *   resincroniza aunque se mezcle texto de Serial en el mismo puerto
+ * - Las tramas se encolan en una FIFO de bytes y se envían solo lo que
+ *   el puerto acepta sin esperar; si la FIFO se llena la trama se descarta
+ *   (y se cuenta)
+ *
+ * Trama: 0xA5 0x5A | tipo | largo | payload (largo bytes) | Fletcher-16 (LE)
+ * El checksum cubre tipo, largo y payload.
+ */
+
+#ifndef SAMPLER_TELEMETRY_H
+#define SAMPLER_TELEMETRY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "sampler_profiler.h"
+
+namespace crearttech {
+
+static const uint8_t TELEMETRY_SYNC_0 = 0xA5;
+static const uint8_t TELEMETRY_SYNC_1 = 0x5A;
+static const size_t TELEMETRY_FRAME_OVERHEAD = 6;  // Sincronía, tipo, largo y checksum
+
+/**
+ * @brief Tipos de trama.
+ */
+enum class TelemetryFrameType : uint8_t {
+  STATUS = 1,  // TelemetryStatus
+  XRUN = 2     // XrunRecord (sampler_xrun.h), uno por trama
+};
+
+/**
+ * @brief Estado del sampler en un instante. Little-endian, sin relleno.
+ * La carga por etapa va al final: el host deduce cuántas etapas hay del largo.
+ */
+struct TelemetryStatus {
+  uint32_t time_ms;
+  uint32_t sequence;           // Correlativo: un salto indica tramas perdidas
+  uint32_t audio_overruns;     // Bloques de audio que excedieron el presupuesto (desde el arranque)
+  uint32_t dropped_frames;     // Tramas descartadas con la FIFO llena
+  float cpu_load;              // Carga promedio (1.0 = presupuesto completo)
+  float cpu_peak_load;
+  float input_peak, input_rms;
+  float output_peak, output_rms, output_lufs;
+  uint32_t loop_start, loop_end;
+  uint32_t play_position;
+  uint32_t recorded_samples;
+  uint32_t take_bytes;         // SDRAM ocupada por la toma
+  uint8_t looper_state;
+  uint8_t undo_levels;         // Niveles de undo con snapshot en SDRAM
+  uint8_t flags;               // TelemetryFlags
+  uint8_t active_grains;
+  float stage_load[static_cast<size_t>(ProfileStage::COUNT)];  // Carga promedio por etapa
+};
+static_assert(sizeof(TelemetryStatus) <= 255, "TelemetryStatus must fit in one frame");
+
+enum TelemetryFlags : uint8_t {
+  TELEMETRY_FLAG_GRANULAR = 1 << 0,
+  TELEMETRY_FLAG_FREEZE = 1 << 1,
+  TELEMETRY_FLAG_REVERSE = 1 << 2,
+  TELEMETRY_FLAG_LINE_INPUT = 1 << 3
+};
+
+/**
+ * @brief FIFO de tramas listas para enviar (productor y consumidor en loop()).
+ * @tparam CAPACITY Bytes (potencia de 2)
+ */
+template <size_t CAPACITY>
+class TelemetryStream {
+public:
+  static_assert((CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of 2");
+
+  /**
+   * @brief Encola una trama completa o ninguna.
+   * @return false si no había lugar (la trama se cuenta como descartada)
+   */
+  bool PushFrame(TelemetryFrameType type, const void* payload, uint8_t length) {
+    if (CAPACITY - (_head - _tail) < length + TELEMETRY_FRAME_OVERHEAD) {
+      _dropped++;
+      return false;
+    }
+    uint8_t header[4] = {TELEMETRY_SYNC_0, TELEMETRY_SYNC_1, static_cast<uint8_t>(type), length};
+    Put(header, sizeof(header));
+    Put(static_cast<const uint8_t*>(payload), length);
+
+    // Fletcher-16 sobre tipo, largo y payload
+    uint16_t sum1 = 0, sum2 = 0;
+    for (size_t i = 2; i < sizeof(header); i++) { sum1 = (sum1 + header[i]) % 255; sum2 = (sum2 + sum1) % 255; }
+    const uint8_t* bytes = static_cast<const uint8_t*>(payload);
+    for (size_t i = 0; i < length; i++) { sum1 = (sum1 + bytes[i]) % 255; sum2 = (sum2 + sum1) % 255; }
+    uint8_t checksum[2] = {static_cast<uint8_t>(sum1), static_cast<uint8_t>(sum2)};
+    Put(checksum, sizeof(checksum));
+    return true;
+  }
+
+  /**
+   * @brief Bytes contiguos listos para enviar (hasta el borde del anillo).
+   * Enviar con el puerto y confirmar con Consume().
+   */
+  size_t Peek(const uint8_t*& data) const {
+    size_t pending = _head - _tail;
+    size_t offset = _tail & (CAPACITY - 1);
+    size_t contiguous = CAPACITY - offset;
+    data = _buffer + offset;
+    return (pending < contiguous) ? pending : contiguous;
+  }
+
+  void Consume(size_t count) { _tail += count; }
+
+  size_t GetPending() const { return _head - _tail; }
+  uint32_t GetDropped() const { return _dropped; }
+
+private:
+  void Put(const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) _buffer[(_head + i) & (CAPACITY - 1)] = data[i];
+    _head += length;
+  }
+
+  uint8_t _buffer[CAPACITY];
+  size_t _head = 0;
+  size_t _tail = 0;
+  uint32_t _dropped = 0;
+};
+
+} // namespace crearttech
+
+#endif // SAMPLER_TELEMETRY_H
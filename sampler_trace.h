@@ -0,0 +1,113 @@
+/**
+ * =====================================================================
+ * sampler_trace.h - Realtime-Safe Trace Rings
+ * =====================================================================
+ * Registro de trazas apto para el audio callback y las ISR:
+ * - Registros de tamaño fijo (8 bytes): instante, punto de traza, fase y argumento
+ * - Un anillo por contexto de ejecución (un solo escritor cada uno, sin locks);
+ *   al llenarse pisa lo más viejo, así siempre quedan los últimos eventos
+ * - La copia para el volcado se hace sin detener a los escritores
+ * Los macros TRACE_* de SAMPLER.ino desaparecen al compilar sin TRACE.
+ */
+
+#ifndef SAMPLER_TRACE_H
+#define SAMPLER_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+namespace crearttech {
+
+/**
+ * @brief Fase de un registro (mismo sentido que en Chrome trace).
+ */
+enum class TracePhase : uint8_t {
+  BEGIN,    // Empieza un intervalo
+  END,      // Termina el último intervalo abierto del mismo punto
+  INSTANT   // Evento puntual con argumento
+};
+
+/**
+ * @brief Registro de traza.
+ */
+struct TraceRecord {
+  uint32_t time_us;
+  uint8_t point;     // Identificador del punto de traza
+  TracePhase phase;
+  uint16_t arg;
+};
+static_assert(sizeof(TraceRecord) == 8, "TraceRecord must stay 8 bytes");
+
+/**
+ * @brief Cabeceras del volcado binario: TraceDumpHeader, los nombres de los
+ * puntos (TRACE_NAME_LENGTH bytes cada uno) y por cada anillo un
+ * TraceRingHeader seguido de sus registros, del más viejo al más nuevo.
+ */
+struct TraceDumpHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint8_t rings;
+  uint8_t points;
+};
+
+struct TraceRingHeader {
+  char name[12];
+  uint32_t count;
+};
+
+static const uint32_t TRACE_MAGIC = 0x43525453;  // "STRC" en little-endian
+static const uint16_t TRACE_VERSION = 1;
+static const size_t TRACE_NAME_LENGTH = 16;
+
+/**
+ * @brief Anillo de trazas de un solo escritor.
+ * @tparam CAPACITY Registros (potencia de 2)
+ */
+template <size_t CAPACITY>
+class TraceRing {
+public:
+  static_assert((CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of 2");
+
+  /** @brief Solo desde el contexto dueño del anillo. */
+  void Write(uint32_t time_us, uint8_t point, TracePhase phase, uint16_t arg) {
+    uint32_t head = _head;
+    TraceRecord& r = _records[head & (CAPACITY - 1)];
+    r.time_us = time_us;
+    r.point = point;
+    r.phase = phase;
+    r.arg = arg;
+    _head = head + 1;  // Publica el registro ya completo
+  }
+
+  /**
+   * @brief Copia los registros disponibles, del más viejo al más nuevo.
+   * El escritor interrumpe al lector y no al revés, así que cada registro
+   * copiado está completo; los que pisó durante la copia se descartan.
+   * @param out Destino de hasta CAPACITY registros
+   * @return Registros copiados
+   */
+  size_t Snapshot(TraceRecord* out) const {
+    uint32_t end = _head;
+    uint32_t count = (end < CAPACITY) ? end : static_cast<uint32_t>(CAPACITY);
+    uint32_t begin = end - count;
+    for (uint32_t i = 0; i < count; i++) out[i] = _records[(begin + i) & (CAPACITY - 1)];
+
+    uint32_t overwritten = _head - begin;
+    overwritten = (overwritten > CAPACITY) ? overwritten - static_cast<uint32_t>(CAPACITY) : 0;
+    if (overwritten >= count) return 0;
+    if (overwritten > 0) memmove(out, out + overwritten, sizeof(TraceRecord) * (count - overwritten));
+    return count - overwritten;
+  }
+
+  /** @brief Registros escritos desde el arranque (incluidos los pisados). */
+  uint32_t GetWritten() const { return _head; }
+
+private:
+  TraceRecord _records[CAPACITY];
+  volatile uint32_t _head = 0;
+};
+
+} // namespace crearttech
+
+#endif // SAMPLER_TRACE_H
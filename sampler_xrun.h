@@ -0,0 +1,132 @@
+/**
+ * =====================================================================
+ * sampler_xrun.h - Audio Callback Overrun Post-Mortem Log
+ * =====================================================================
+ * Registro de xruns (el audio callback no cumplió su plazo):
+ * - OVERRUN: el callback tardó más que un bloque
+ * - LATE: entre dos callbacks pasó más de un bloque y medio (el callback
+ *   quedó bloqueado o se perdió un bloque)
+ * Cada registro guarda el estado del looper, la configuración de efectos
+ * y los ciclos por etapa del bloque. El anillo vive en memoria que el
+ * arranque no inicializa: sobrevive a un reset por software y se valida
+ * con un número mágico.
+ */
+
+#ifndef SAMPLER_XRUN_H
+#define SAMPLER_XRUN_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sampler_profiler.h"
+
+namespace crearttech {
+
+enum class XrunKind : uint8_t {
+  OVERRUN,  // Duración del callback > presupuesto del bloque
+  LATE      // Intervalo entre callbacks > 1.5 bloques
+};
+
+/**
+ * @brief Contexto de un xrun.
+ */
+struct XrunRecord {
+  uint32_t index;            // Número de xrun; se escribe al final (registro completo)
+  uint32_t boot;             // Arranque en el que ocurrió
+  uint32_t uptime_ms;
+  uint32_t callback_cycles;
+  uint32_t interval_cycles;  // Desde el inicio del callback anterior
+  uint32_t stage_cycles[static_cast<size_t>(ProfileStage::COUNT)];
+  XrunKind kind;
+  uint8_t looper_state;
+  uint8_t flags;             // XrunFlags
+  uint8_t eq_bands;          // Bandas del EQ fuera de 0 dB (un bit por banda)
+  uint8_t delay_mix;         // Porcentaje
+  uint8_t reverb_mix;        // Porcentaje
+  uint8_t active_grains;
+  uint8_t reserved;
+};
+
+enum XrunFlags : uint8_t {
+  XRUN_FLAG_GRANULAR = 1 << 0,
+  XRUN_FLAG_FREEZE = 1 << 1,
+  XRUN_FLAG_REVERSE = 1 << 2,
+  XRUN_FLAG_EFFECTS_PRINTED = 1 << 3,
+  XRUN_FLAG_EFFECTS_IDLE = 1 << 4,
+  XRUN_FLAG_LINE_INPUT = 1 << 5
+};
+
+/**
+ * @brief Anillo persistente de xruns (escritor: audio callback; lectores: loop()).
+ * @tparam CAPACITY Registros guardados (los más nuevos)
+ */
+template <size_t CAPACITY>
+class XrunLog {
+public:
+  static const uint32_t MAGIC = 0x4E555258;  // "XRUN" en little-endian
+  static const uint32_t INVALID_INDEX = 0xFFFFFFFFu;
+
+  /**
+   * @brief Valida el contenido que quedó del arranque anterior y cuenta este arranque.
+   * Tras un corte de energía la memoria trae basura y el registro se limpia.
+   */
+  void Attach() {
+    if (_magic != MAGIC || _size != sizeof(*this) || _total == INVALID_INDEX) Clear();
+    _boots++;
+    _boot_first = _total;
+  }
+
+  void Clear() {
+    _magic = MAGIC;
+    _size = sizeof(*this);
+    _boots = 0;
+    _total = 0;
+    _boot_first = 0;
+    for (size_t i = 0; i < CAPACITY; i++) _records[i].index = INVALID_INDEX;
+  }
+
+  /** @brief Solo desde el audio callback; index y boot los completa el registro. */
+  void Record(const XrunRecord& record) {
+    uint32_t index = _total;
+    XrunRecord& slot = _records[index % CAPACITY];
+    slot = record;
+    slot.boot = _boots;
+    slot.index = index;
+    _total = index + 1;
+  }
+
+  /**
+   * @brief Copia el xrun número index (de 0 a GetTotal() - 1).
+   * El callback interrumpe al lector y termina su escritura antes de devolverle
+   * el control: si pisó la entrada durante la copia, el índice ya no coincide.
+   * @return false si la entrada ya fue pisada
+   */
+  bool Read(uint32_t index, XrunRecord& out) const {
+    if (index >= _total || _total - index > CAPACITY) return false;
+    const XrunRecord& slot = _records[index % CAPACITY];
+    out = slot;
+    return out.index == index && static_cast<const volatile uint32_t&>(slot.index) == index;
+  }
+
+  /** @brief Xruns registrados desde que se limpió el registro. */
+  uint32_t GetTotal() const { return _total; }
+
+  /** @brief Número del xrun más viejo que sigue guardado. */
+  uint32_t GetOldest() const { return (_total > CAPACITY) ? _total - static_cast<uint32_t>(CAPACITY) : 0; }
+
+  /** @brief Xruns de arranques anteriores (los que trae el post-mortem). */
+  uint32_t GetPreviousBootsTotal() const { return _boot_first; }
+
+  uint32_t GetBoots() const { return _boots; }
+
+private:
+  uint32_t _magic;
+  uint32_t _size;
+  uint32_t _boots;
+  volatile uint32_t _total;
+  uint32_t _boot_first;
+  XrunRecord _records[CAPACITY];
+};
+
+} // namespace crearttech
+
+#endif // SAMPLER_XRUN_H
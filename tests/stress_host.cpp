@@ -0,0 +1,57 @@
+/**
+ * stress_host.cpp - EngineStress en la PC con ASan y UBSan
+ * Corre sampler_stress.h contra el OverdubLooper con varias semillas; cualquier
+ * acceso fuera de los búferes o comportamiento indefinido corta la prueba.
+ * Uso: make -C tests stress  (o ./stress_host <semillas> <bloques>)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "../sampler_stress.h"
+
+using namespace crearttech;
+
+static const size_t kBlockSamples = 48;
+static const float kSampleRate = 48000.0f;
+static const size_t kUndoLevels = 3;
+static const size_t kLength = 4 * 48000 + 2 * EngineStress::GUARD_SAMPLES;  // 4 s por búfer
+static const size_t kChunkCount = kLength / OverdubLooper::STATS_CHUNK + 1;
+
+int main(int argc, char** argv) {
+  uint32_t seeds = (argc > 1) ? (uint32_t)atoi(argv[1]) : 8;
+  uint32_t blocks = (argc > 2) ? (uint32_t)atoi(argv[2]) : 300000;
+
+  std::vector<float> storage((2 + kUndoLevels + 1) * kLength);
+  std::vector<ChunkStats> stats(kChunkCount);
+  std::vector<uint32_t> silent_bits((kChunkCount + 31) / 32);
+  float* buffers[2] = {&storage[0], &storage[kLength]};
+  float* undo[kUndoLevels + 1];
+  for (size_t i = 0; i < kUndoLevels + 1; i++) undo[i] = &storage[(2 + i) * kLength];
+
+  int failed = 0;
+  for (uint32_t seed = 1; seed <= seeds; seed++) {
+    static OverdubLooper looper;
+    static EngineStress stress;
+    stress.Init(&looper, buffers, undo, kUndoLevels, kLength, stats.data(), silent_bits.data(), kChunkCount,
+                kSampleRate, seed);
+    float in[kBlockSamples], out[kBlockSamples];
+    bool ok = true;
+    for (uint32_t b = 1; b <= blocks && ok; b++) {
+      ok = stress.RunBlock(in, out, kBlockSamples, 8);
+      if (b % 1000 == 0 && !stress.CheckGuards()) ok = false;
+    }
+    stress.CheckGuards();
+
+    const StressStats& s = stress.GetStats();
+    printf("semilla %u: %u bloques, ", seed, s.blocks);
+    if (s.Failures() > 0) {
+      printf("FALLO en el bloque %u (no finito %u, cabezal %u, grabacion %u, guardas %u)\n",
+             s.first_failure_block, s.non_finite_blocks, s.playhead_errors, s.record_head_errors, s.guard_errors);
+      failed++;
+    } else {
+      printf("OK\n");
+    }
+  }
+  return failed > 0 ? 1 : 0;
+}
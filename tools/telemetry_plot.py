@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+"""
+Decodifica la telemetría binaria del SAMPLER (firmware compilado con TELEMETRY)
+y la grafica en vivo, o la imprime como CSV.
+
+Uso:
+  python3 telemetry_plot.py /dev/ttyACM0          # gráfica en vivo (pyserial + matplotlib)
+  python3 telemetry_plot.py /dev/ttyACM0 --csv    # una línea CSV por trama
+  python3 telemetry_plot.py captura.bin --csv     # archivo grabado del puerto
+
+Trama: 0xA5 0x5A | tipo | largo | payload | Fletcher-16 (tipo, largo y payload).
+El texto de Serial que se mezcle en el puerto se descarta.
+"""
+import collections
+import struct
+import sys
+
+SYNC = b'\xa5\x5a'
+FRAME_STATUS = 1
+FRAME_XRUN = 2
+STATUS_FIXED = struct.Struct('<4I7f5I4B')
+STATUS_FIELDS = ('time_ms', 'sequence', 'audio_overruns', 'dropped_frames', 'cpu_load', 'cpu_peak_load',
+                 'input_peak', 'input_rms', 'output_peak', 'output_rms', 'output_lufs',
+                 'loop_start', 'loop_end', 'play_position', 'recorded_samples', 'take_bytes',
+                 'looper_state', 'undo_levels', 'flags', 'active_grains')
+STAGES = ('callback', 'looper', 'granular', 'effects', 'spectral', 'dynamics')  # Orden de ProfileStage
+STATES = ('STOPPED', 'RECORDING', 'PLAYING', 'OVERDUB', 'PAUSED', 'ARMED')
+XRUN_HEAD = struct.Struct('<5I')
+XRUN_TAIL = struct.Struct('<8B')
+XRUN_KINDS = ('OVERRUN', 'LATE')
+
+
+def fletcher16(data):
+    sum1 = sum2 = 0
+    for byte in data:
+        sum1 = (sum1 + byte) % 255
+        sum2 = (sum2 + sum1) % 255
+    return sum1, sum2
+
+
+class FrameDecoder:
+    """Acumula bytes y devuelve las tramas STATUS válidas como diccionarios.
+    Las tramas XRUN se imprimen por stderr a medida que llegan."""
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.bad_frames = 0
+
+    def feed(self, data):
+        self.buffer.extend(data)
+        frames = []
+        while True:
+            start = self.buffer.find(SYNC)
+            if start < 0:
+                del self.buffer[:-1]
+                return frames
+            del self.buffer[:start]
+            if len(self.buffer) < 4:
+                return frames
+            length = self.buffer[3]
+            end = 4 + length + 2
+            if len(self.buffer) < end:
+                return frames
+            body = bytes(self.buffer[2:4 + length])
+            if tuple(self.buffer[4 + length:end]) != fletcher16(body):
+                self.bad_frames += 1
+                del self.buffer[:1]  # Falsa sincronía: seguir buscando
+                continue
+            del self.buffer[:end]
+            if body[0] == FRAME_STATUS and length >= STATUS_FIXED.size:
+                frames.append(decode_status(body[2:]))
+            elif body[0] == FRAME_XRUN and length >= XRUN_HEAD.size + XRUN_TAIL.size:
+                print(format_xrun(body[2:]), file=sys.stderr)
+
+
+def decode_status(payload):
+    status = dict(zip(STATUS_FIELDS, STATUS_FIXED.unpack_from(payload)))
+    stages = (len(payload) - STATUS_FIXED.size) // 4
+    loads = struct.unpack_from('<%df' % stages, payload, STATUS_FIXED.size)
+    for i, load in enumerate(loads):
+        status['stage_' + (STAGES[i] if i < len(STAGES) else str(i))] = load
+    return status
+
+
+def format_xrun(payload):
+    index, boot, uptime_ms, cycles, interval = XRUN_HEAD.unpack_from(payload)
+    stages = (len(payload) - XRUN_HEAD.size - XRUN_TAIL.size) // 4
+    stage_cycles = struct.unpack_from('<%dI' % stages, payload, XRUN_HEAD.size)
+    kind, state, flags, eq_bands, delay_mix, reverb_mix, grains, _ = XRUN_TAIL.unpack_from(payload, XRUN_HEAD.size + stages * 4)
+    names = [STAGES[i] if i < len(STAGES) else str(i) for i in range(stages)]
+    return 'xrun #%d boot %d t=%.3fs %s %s: %d ciclos, intervalo %d | %s | flags 0x%02x eq 0x%x delay %d%% reverb %d%% granos %d' % (
+        index, boot, uptime_ms / 1000.0, XRUN_KINDS[kind] if kind < len(XRUN_KINDS) else kind,
+        STATES[state] if state < len(STATES) else state, cycles, interval,
+        ' '.join('%s=%d' % pair for pair in zip(names, stage_cycles)), flags, eq_bands, delay_mix, reverb_mix, grains)
+
+
+def open_source(path):
+    if is_port(path):
+        import serial  # pyserial
+        port = serial.Serial(path, 115200, timeout=0.1)
+        return lambda: port.read(4096)
+    f = open(path, 'rb')
+    return lambda: f.read(4096)
+
+
+def is_port(path):
+    return path.startswith('/dev/') or path.upper().startswith('COM')
+
+
+def print_csv(read, live):
+    decoder = FrameDecoder()
+    header = None
+    while True:
+        data = read()
+        if not data and not live:
+            break
+        for status in decoder.feed(data):
+            if header is None:
+                header = list(status)
+                print(','.join(header))
+            print(','.join(str(status.get(k, '')) for k in header))
+
+
+def plot_live(read):
+    import matplotlib.pyplot as plt
+    from matplotlib.animation import FuncAnimation
+
+    history = collections.defaultdict(lambda: collections.deque(maxlen=600))
+    decoder = FrameDecoder()
+    figure, (cpu_axis, meter_axis) = plt.subplots(2, 1, sharex=True)
+
+    def update(_):
+        for status in decoder.feed(read()):
+            history['t'].append(status['time_ms'] / 1000.0)
+            for key, value in status.items():
+                history[key].append(value)
+        if not history['t']:
+            return
+        t = list(history['t'])
+        cpu_axis.clear()
+        cpu_axis.plot(t, list(history['cpu_load']), label='total')
+        for key in history:
+            if key.startswith('stage_') and key != 'stage_callback':
+                cpu_axis.plot(t, list(history[key]), label=key[6:])
+        cpu_axis.set_ylabel('carga')
+        cpu_axis.legend(loc='upper left', fontsize='small')
+        cpu_axis.set_title('%s | overruns %d | tramas perdidas %d' % (
+            STATES[history['looper_state'][-1]] if history['looper_state'][-1] < len(STATES) else '?',
+            history['audio_overruns'][-1], history['dropped_frames'][-1]))
+        meter_axis.clear()
+        for key in ('input_peak', 'output_peak', 'output_rms'):
+            meter_axis.plot(t, list(history[key]), label=key)
+        meter_axis.set_ylabel('nivel')
+        meter_axis.set_xlabel('s')
+        meter_axis.legend(loc='upper left', fontsize='small')
+
+    animation = FuncAnimation(figure, update, interval=100, cache_frame_data=False)
+    plt.show()
+    return animation
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    read = open_source(sys.argv[1])
+    if '--csv' in sys.argv[2:]:
+        print_csv(read, is_port(sys.argv[1]))
+    else:
+        plot_live(read)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+"""
+Convierte un volcado de trazas del SAMPLER (comando 't' por Serial, firmware
+compilado con TRACE) a JSON de Chrome trace, que abren chrome://tracing y
+ui.perfetto.dev. Cada anillo (audio, ui, isr) aparece como un hilo propio.
+
+Uso: python3 trace_to_chrome.py volcado.bin > trazas.json
+El volcado puede contener texto de Serial antes y después: se busca la cabecera.
+"""
+import json
+import struct
+import sys
+
+TRACE_MAGIC = 0x43525453  # "STRC"
+TRACE_VERSION = 1
+NAME_LENGTH = 16
+RECORD = struct.Struct('<IBBH')        # time_us, point, phase, arg
+DUMP_HEADER = struct.Struct('<IHBB')   # magic, version, rings, points
+RING_HEADER = struct.Struct('<12sI')   # name, count
+PHASES = {0: 'B', 1: 'E', 2: 'i'}
+
+
+def c_string(raw):
+    return raw.split(b'\0', 1)[0].decode('ascii', 'replace')
+
+
+def parse(data):
+    offset = data.find(struct.pack('<I', TRACE_MAGIC))
+    if offset < 0:
+        sys.exit('no se encontró un volcado de trazas')
+    _, version, ring_count, point_count = DUMP_HEADER.unpack_from(data, offset)
+    if version != TRACE_VERSION:
+        sys.exit('versión de volcado no soportada: %d' % version)
+    offset += DUMP_HEADER.size
+
+    names = []
+    for _ in range(point_count):
+        names.append(c_string(data[offset:offset + NAME_LENGTH]))
+        offset += NAME_LENGTH
+
+    rings = []
+    for _ in range(ring_count):
+        raw_name, count = RING_HEADER.unpack_from(data, offset)
+        offset += RING_HEADER.size
+        records = [RECORD.unpack_from(data, offset + i * RECORD.size) for i in range(count)]
+        offset += count * RECORD.size
+        rings.append((c_string(raw_name), records))
+    return names, rings
+
+
+def to_chrome(names, rings):
+    starts = [records[0][0] for _, records in rings if records]
+    origin = min(starts) if starts else 0
+    events = []
+    for tid, (ring_name, records) in enumerate(rings):
+        events.append({'name': 'thread_name', 'ph': 'M', 'pid': 0, 'tid': tid, 'args': {'name': ring_name}})
+        open_spans = {}
+        for time_us, point, phase, arg in records:
+            name = names[point] if point < len(names) else 'point_%d' % point
+            ph = PHASES.get(phase)
+            if ph is None:
+                continue
+            if ph == 'E':
+                # El BEGIN pudo quedar pisado por el anillo: se descarta el END suelto
+                if open_spans.get(point, 0) == 0:
+                    continue
+                open_spans[point] -= 1
+            elif ph == 'B':
+                open_spans[point] = open_spans.get(point, 0) + 1
+            event = {'name': name, 'ph': ph, 'pid': 0, 'tid': tid, 'ts': (time_us - origin) & 0xFFFFFFFF}
+            if ph == 'i':
+                event['s'] = 't'
+                event['args'] = {'arg': arg}
+            events.append(event)
+    return {'traceEvents': events, 'displayTimeUnit': 'ms'}
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__)
+    with open(sys.argv[1], 'rb') as f:
+        names, rings = parse(f.read())
+    json.dump(to_chrome(names, rings), sys.stdout)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+"""
+Compara tablas de peor caso del SAMPLER (firmware compilado con WCET_PROFILE).
+Cada log es la salida de Serial guardada en un archivo; se leen solo las
+líneas "wcet,". Con un log imprime la tabla ordenada por ciclos; con dos,
+el cambio por camino, y con --limit falla si algún camino empeora más que
+ese porcentaje (para usarlo antes de publicar una versión).
+
+Uso: python3 wcet_compare.py base.log [nuevo.log] [--limit 5]
+"""
+import sys
+
+KEY_FIELDS = ('state', 'engine', 'fx', 'freeze', 'input')
+
+
+def parse(path):
+    rows = {}
+    header = None
+    with open(path, errors='replace') as f:
+        for line in f:
+            fields = line.strip().split(',')
+            if fields[0] != 'wcet':
+                continue
+            if fields[1] == 'state':
+                header = fields[1:]
+                continue
+            if header is None or len(fields) - 1 != len(header):
+                continue
+            row = dict(zip(header, fields[1:]))
+            rows[tuple(row[k] for k in KEY_FIELDS)] = row
+    if not rows:
+        sys.exit('%s: no hay líneas wcet' % path)
+    return rows
+
+
+def label(key):
+    return ' '.join(key)
+
+
+def show(rows):
+    ordered = sorted(rows.items(), key=lambda item: -int(item[1]['callback']))
+    print('%-40s %10s %7s' % ('camino', 'ciclos', 'carga'))
+    for key, row in ordered:
+        print('%-40s %10s %6s%%' % (label(key), row['callback'], row['load_pct']))
+
+
+def compare(base, new, limit):
+    worse = 0
+    print('%-40s %10s %10s %8s' % ('camino', 'base', 'nuevo', 'cambio'))
+    for key in sorted(set(base) | set(new)):
+        if key not in base or key not in new:
+            print('%-40s %s' % (label(key), 'solo en base' if key in base else 'solo en nuevo'))
+            continue
+        old, cur = int(base[key]['callback']), int(new[key]['callback'])
+        change = 100.0 * (cur - old) / old if old else 0.0
+        mark = ''
+        if limit is not None and change > limit:
+            mark = '  <--'
+            worse += 1
+        print('%-40s %10d %10d %+7.1f%%%s' % (label(key), old, cur, change, mark))
+    return worse
+
+
+def main():
+    args = sys.argv[1:]
+    limit = None
+    if '--limit' in args:
+        i = args.index('--limit')
+        limit = float(args[i + 1])
+        del args[i:i + 2]
+    if not 1 <= len(args) <= 2:
+        sys.exit(__doc__)
+    if len(args) == 1:
+        show(parse(args[0]))
+        return
+    worse = compare(parse(args[0]), parse(args[1]), limit)
+    if worse:
+        sys.exit('%d caminos empeoraron más de %.1f%%' % (worse, limit))
+
+
+if __name__ == '__main__':
+    main()